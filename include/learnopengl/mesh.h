@@ -7,8 +7,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/LinearAllocator.h>
+#include <rg/MemoryTracker.h>
 
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -25,7 +28,22 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// everything in Vertex except the position; on the GPU positions live in their own buffer
+// so passes that only need depth (DrawDepth) fetch 12 bytes per vertex instead of the whole Vertex
+struct VertexAttributes {
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
 
+// what a mesh keeps in RAM after its GL buffers are created
+enum MeshResidency {
+    MESH_KEEP,      // vertices and indices, for CPU culling and picking
+    MESH_POSITIONS, // a compact position copy and the indices
+    MESH_DISCARD    // nothing, the GPU copy is all there is
+};
 
 struct Texture {
     unsigned int id;
@@ -39,45 +57,145 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // filled instead of vertices when the residency is MESH_POSITIONS
+    vector<glm::vec3>    positions;
 
     unsigned int VAO;
+    // position-only vertex array (attribute 0) for depth-only passes
+    unsigned int depthVAO;
+    // what the draws use, still valid after ReleaseCpuData()
+    unsigned int indexCount;
+    unsigned int vertexCount;
+    MeshResidency residency;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor; with upload = false no GL call is made until Upload(), so meshes can be built on any thread
+    // the buffers are moved in, pass them with std::move to avoid a copy
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+          VAO(0), depthVAO(0), indexCount(this->indices.size()), vertexCount(this->vertices.size()),
+          residency(MESH_KEEP)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (upload)
+            Upload();
+    }
+
+    // owns GL objects and possibly millions of vertices: moved, never copied
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+
+    // creates the GL buffers of a mesh constructed with upload = false
+    void Upload()
+    {
+        LinearAllocator scratch(vertices.size() * sizeof(Vertex) + 64);
+        Upload(scratch);
+    }
+
+    // same, with the temporary upload buffers taken from a load-time arena; the caller resets it afterwards.
+    // label names the GL objects in the memory tracker
+    void Upload(LinearAllocator &scratch, const std::string &label = "mesh")
+    {
+        if (VAO == 0)
+            setupMesh(scratch, label);
+    }
+
+    // sets the prefix of the sampler uniforms (e.g. "material.") and rebuilds their names
+    void SetTextureNamePrefix(const std::string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        BuildSamplerNames();
+    }
+
+    // deletes the GL objects (textures belong to the Model); the mesh can be uploaded again afterwards
+    void Destroy()
+    {
+        if (VAO == 0)
+            return;
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &positionVBO);
+        glDeleteBuffers(1, &attributeVBO);
+        glDeleteBuffers(1, &EBO);
+        MemoryTracker::untrack(MemoryTracker::VERTEX_ARRAY, VAO);
+        MemoryTracker::untrack(MemoryTracker::VERTEX_ARRAY, depthVAO);
+        MemoryTracker::untrack(MemoryTracker::BUFFER, positionVBO);
+        MemoryTracker::untrack(MemoryTracker::BUFFER, attributeVBO);
+        MemoryTracker::untrack(MemoryTracker::BUFFER, EBO);
+        VAO = depthVAO = 0;
+    }
+
+    // trims the CPU copy of the geometry once it is on the GPU; drawing works the same in every mode.
+    // Residency only goes down (keep -> positions -> discard), what was freed can't come back.
+    void SetResidency(MeshResidency target)
+    {
+        if (VAO == 0 || target <= residency)
+            return;
+        if (target == MESH_POSITIONS)
+        {
+            positions.resize(vertices.size());
+            for (unsigned int i = 0; i < vertices.size(); i++)
+                positions[i] = vertices[i].Position;
+        }
+        else
+        {
+            vector<glm::vec3>().swap(positions);
+            vector<unsigned int>().swap(indices);
+        }
+        vector<Vertex>().swap(vertices);
+        residency = target;
+    }
+
+    // frees the CPU copy of the vertices and indices; anything that reads them (bounds, occluders) has to run before
+    void ReleaseCpuData()
+    {
+        SetResidency(MESH_DISCARD);
+    }
+
+    // positions for CPU-side users, from whichever copy the residency kept; none after MESH_DISCARD
+    bool HasCpuPositions() const
+    {
+        return residency != MESH_DISCARD;
+    }
+
+    const glm::vec3 &VertexPosition(unsigned int i) const
+    {
+        return residency == MESH_POSITIONS ? positions[i] : vertices[i].Position;
+    }
+
+    // bytes held by the CPU copy of the geometry
+    size_t CpuBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + positions.capacity() * sizeof(glm::vec3)
+               + indices.capacity() * sizeof(unsigned int);
+    }
+
+    // what MESH_KEEP holds, the baseline the other modes are compared against
+    size_t FullCpuBytes() const
+    {
+        return vertexCount * sizeof(Vertex) + indexCount * sizeof(unsigned int);
+    }
+
+    // vertex and index buffers on the GPU
+    size_t GpuBytes() const
+    {
+        return vertexCount * (sizeof(glm::vec3) + sizeof(VertexAttributes)) + indexCount * sizeof(unsigned int);
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
+        // names are built once, Draw itself doesn't allocate
+        if (samplerNames.size() != textures.size())
+            BuildSamplerNames();
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
+            glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
@@ -86,54 +204,121 @@ public:
 
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render only the positions, no textures (depth pre-pass)
+    void DrawDepth()
+    {
+        glBindVertexArray(depthVAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int positionVBO, attributeVBO, EBO;
+    // sampler uniform of every texture, same order as textures
+    vector<string> samplerNames;
+
+    // prefix + type + N, where N counts the textures of that type (texture_diffuse1, texture_diffuse2, ...)
+    void BuildSamplerNames()
+    {
+        unsigned int diffuseNr  = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr   = 1;
+        unsigned int heightNr   = 1;
+        samplerNames.clear();
+        samplerNames.reserve(textures.size());
+        for(const Texture &texture : textures)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            string number;
+            const string &name = texture.type;
+            if(name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if(name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to stream
+            else if(name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to stream
+            else if(name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to stream
+            samplerNames.push_back(glslIdentifierPrefix + name + number);
+        }
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(LinearAllocator &scratch, const std::string &label)
     {
+        // split the vertex stream: positions in one buffer, the rest in another
+        ArenaVector<glm::vec3> positions(vertices.size(), glm::vec3(0.0f), ArenaAllocator<glm::vec3>(scratch));
+        ArenaVector<VertexAttributes> attributes(vertices.size(), VertexAttributes(), ArenaAllocator<VertexAttributes>(scratch));
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].Position;
+            attributes[i].Normal = vertices[i].Normal;
+            attributes[i].TexCoords = vertices[i].TexCoords;
+            attributes[i].Tangent = vertices[i].Tangent;
+            attributes[i].Bitangent = vertices[i].Bitangent;
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &positionVBO);
+        glGenBuffers(1, &attributeVBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
+        glBufferData(GL_ARRAY_BUFFER, attributes.size() * sizeof(VertexAttributes), &attributes[0], GL_STATIC_DRAW);
 
+        glBindVertexArray(VAO);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
         // vertex Positions
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
         // vertex normals
         glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, Normal));
         // vertex texture coords
         glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, TexCoords));
         // vertex tangent
         glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, Tangent));
         // vertex bitangent
         glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, Bitangent));
+
+        // same positions and indices, nothing else
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
 
         glBindVertexArray(0);
+
+        MemoryTracker::track(MemoryTracker::BUFFER, positionVBO, positions.size() * sizeof(glm::vec3), MEMORY_MESHES, label + " positions");
+        MemoryTracker::track(MemoryTracker::BUFFER, attributeVBO, attributes.size() * sizeof(VertexAttributes), MEMORY_MESHES, label + " attributes");
+        MemoryTracker::track(MemoryTracker::BUFFER, EBO, indices.size() * sizeof(unsigned int), MEMORY_MESHES, label + " indices");
+        MemoryTracker::track(MemoryTracker::VERTEX_ARRAY, VAO, 0, MEMORY_MESHES, label);
+        MemoryTracker::track(MemoryTracker::VERTEX_ARRAY, depthVAO, 0, MEMORY_MESHES, label + " depth");
     }
 };
 #endif
\ No newline at end of file
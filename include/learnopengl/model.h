@@ -21,8 +21,39 @@
 #include <vector>
 using namespace std;
 
+// decoded image waiting for its GL texture; decoding needs no GL context, so it can run on any thread
+struct TextureImage {
+    unsigned char *data = nullptr;
+    int width = 0, height = 0, components = 0;
+    string path;
+};
+
+TextureImage LoadTextureImage(const char *path, const string &directory);
+// creates the texture and frees the image data
+unsigned int TextureFromImage(TextureImage &image);
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// assimp matrices are row-major, glm's are column-major
+inline glm::mat4 ConvertMatrix(const aiMatrix4x4 &from)
+{
+    glm::mat4 to;
+    to[0][0] = from.a1; to[1][0] = from.a2; to[2][0] = from.a3; to[3][0] = from.a4;
+    to[0][1] = from.b1; to[1][1] = from.b2; to[2][1] = from.b3; to[3][1] = from.b4;
+    to[0][2] = from.c1; to[1][2] = from.c2; to[2][2] = from.c3; to[3][2] = from.c4;
+    to[0][3] = from.d1; to[1][3] = from.d2; to[2][3] = from.d3; to[3][3] = from.d4;
+    return to;
+}
+
+// one aiNode of the imported file
+struct ModelNode {
+    string name;
+    // relative to the parent node
+    glm::mat4 transform;
+    // index into Model::nodes, -1 for the root; parents always come before their children
+    int parent;
+    // indices into Model::meshes
+    vector<unsigned int> meshes;
+};
 
 
 class Model
@@ -31,13 +62,68 @@ public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    vector<ModelNode> nodes;
     string directory;
     bool gammaCorrection;
 
+    // empty model, filled by Import() and Upload()
+    Model() : gammaCorrection(false)
+    {
+    }
+
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        Import(path);
+        Upload();
+    }
+
+    // first half of loading: reads the file and decodes the textures without touching GL, so several models
+    // can be imported in parallel. Until Upload() a Texture id is an index into textures_loaded.
+    bool Import(string const &path)
+    {
+        return loadModel(path);
+    }
+
+    // second half of loading, on the thread that owns the GL context: creates buffers and textures.
+    // The split vertex streams of each mesh are built in one load-time arena that is reused mesh after mesh.
+    void Upload()
+    {
+        LinearAllocator scratch(1 << 20);
+        vector<unsigned int> ids(pendingImages.size());
+        for(unsigned int i = 0; i < pendingImages.size(); i++)
+        {
+            ids[i] = TextureFromImage(pendingImages[i]);
+            textures_loaded[i].id = ids[i];
+        }
+        for(Mesh &mesh : meshes)
+        {
+            for(Texture &texture : mesh.textures)
+                if(texture.id < ids.size())
+                    texture.id = ids[texture.id];
+            mesh.Upload(scratch, directory);
+            scratch.reset();
+        }
+        pendingImages.clear();
+    }
+
+    // deletes the GL buffers of every mesh and the model's textures, before the context goes away
+    void Destroy()
+    {
+        for(Mesh &mesh : meshes)
+            mesh.Destroy();
+        // before Upload() the ids are still indices, not GL names, and the decoded images are still in RAM
+        if(!pendingImages.empty())
+        {
+            FreePendingImages();
+            return;
+        }
+        for(Texture &texture : textures_loaded)
+        {
+            glDeleteTextures(1, &texture.id);
+            MemoryTracker::untrack(MemoryTracker::TEXTURE, texture.id);
+        }
+        textures_loaded.clear();
     }
 
     // draws the model, and thus all its meshes
@@ -47,14 +133,89 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // draws only the positions of all meshes, for depth-only passes
+    void DrawDepth()
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawDepth();
+    }
+
+    // transform of every mesh relative to the model root, from the imported node hierarchy
+    vector<glm::mat4> MeshTransforms() const
+    {
+        vector<glm::mat4> nodeTransforms(nodes.size());
+        vector<glm::mat4> meshTransforms(meshes.size(), glm::mat4(1.0f));
+        for(unsigned int i = 0; i < nodes.size(); i++)
+        {
+            nodeTransforms[i] = nodes[i].parent < 0 ? nodes[i].transform : nodeTransforms[nodes[i].parent] * nodes[i].transform;
+            for(unsigned int mesh : nodes[i].meshes)
+                meshTransforms[mesh] = nodeTransforms[i];
+        }
+        return meshTransforms;
+    }
+
+    // trims the CPU copy of every mesh's geometry after Upload(), see Mesh::SetResidency
+    void SetResidency(MeshResidency residency)
+    {
+        for(Mesh &mesh : meshes)
+            mesh.SetResidency(residency);
+    }
+
+    void ReleaseCpuData()
+    {
+        SetResidency(MESH_DISCARD);
+    }
+
+    size_t CpuBytes() const
+    {
+        size_t bytes = 0;
+        for(const Mesh &mesh : meshes)
+            bytes += mesh.CpuBytes();
+        return bytes;
+    }
+
+    size_t FullCpuBytes() const
+    {
+        size_t bytes = 0;
+        for(const Mesh &mesh : meshes)
+            bytes += mesh.FullCpuBytes();
+        return bytes;
+    }
+
+    size_t GpuBytes() const
+    {
+        size_t bytes = 0;
+        for(const Mesh &mesh : meshes)
+            bytes += mesh.GpuBytes();
+        return bytes;
+    }
+
+    // images decoded by Import() that have no GL texture yet, same order as textures_loaded
+    const vector<TextureImage> &PendingImages() const
+    {
+        return pendingImages;
+    }
+
+    // frees the decoded images of a model that is never uploaded (CPU-only use); the textures go with them
+    void FreePendingImages()
+    {
+        for(TextureImage &image : pendingImages)
+            stbi_image_free(image.data);
+        pendingImages.clear();
+        textures_loaded.clear();
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetTextureNamePrefix(prefix);
         }
     }
 private:
+    // textures decoded by Import(), same order as textures_loaded
+    vector<TextureImage> pendingImages;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    bool loadModel(string const &path)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
@@ -63,93 +224,91 @@ private:
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
+        // usually one mesh per reference, so the Mesh objects are never moved while the model is built
+        meshes.reserve(scene->mNumMeshes);
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, -1);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // the node and its transform are kept in nodes, so the hierarchy can be instanced into a SceneGraph
+    void processNode(aiNode *node, const aiScene *scene, int parent)
     {
+        int index = nodes.size();
+        nodes.push_back(ModelNode{node->mName.C_Str(), ConvertMatrix(node->mTransformation), parent, {}});
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            nodes[index].meshes.push_back(meshes.size());
             meshes.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index);
         }
 
     }
 
+    // every buffer is sized once from the aiMesh counts, filled in place and moved into the Mesh
     Mesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
+        vector<Vertex> vertices(mesh->mNumVertices);
         vector<unsigned int> indices;
         vector<Texture> textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+            Vertex &vertex = vertices[i];
             // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
+            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
             // normals
             if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
+                vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            else
+                vertex.Normal = glm::vec3(0.0f);
             // texture coordinates
             if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
             {
-                glm::vec2 vec;
                 // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
                 // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
                 // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
+                vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
                 // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
-
-
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
         }
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        // faces are read by reference, copying an aiFace allocates its index array
+        unsigned int indexCount = 0;
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+            indexCount += mesh->mFaces[i].mNumIndices;
+        indices.resize(indexCount);
+        unsigned int *index = indices.data();
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+                *index++ = face.mIndices[j];
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
@@ -159,34 +318,24 @@ private:
         // diffuse: texture_diffuseN
         // specular: texture_specularN
         // normal: texture_normalN
-        aiColor3D color(0.0f, 0.0f, 0.0f);
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(textures, material, aiTextureType_DIFFUSE, "texture_diffuse");
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(textures, material, aiTextureType_SPECULAR, "texture_specular");
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(textures, material, aiTextureType_HEIGHT, "texture_normal");
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
+        loadMaterialTextures(textures, material, aiTextureType_AMBIENT, "texture_height");
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(std::move(vertices), std::move(indices), std::move(textures), false);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // the required info is appended to textures as a Texture struct.
+    void loadMaterialTextures(vector<Texture> &textures, aiMaterial *mat, aiTextureType type, const char *typeName)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
@@ -205,55 +354,69 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = textures_loaded.size();
+                pendingImages.push_back(LoadTextureImage(str.C_Str(), this->directory));
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
             }
         }
-        return textures;
     }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+TextureImage LoadTextureImage(const char *path, const string &directory)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    TextureImage image;
+    image.path = path;
+    string filename = directory + '/' + image.path;
+    image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    return image;
+}
 
+unsigned int TextureFromImage(TextureImage &image)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    if (image.data)
     {
-        GLenum format;
-        if (nrComponents == 1)
+        GLenum format = GL_RGB;
+        if (image.components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.components == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        MemoryTracker::track(MemoryTracker::TEXTURE, textureID, MemoryTracker::textureBytes(format, image.width, image.height, true),
+                             MEMORY_TEXTURES, image.path);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        stbi_image_free(data);
+        stbi_image_free(image.data);
+        image.data = nullptr;
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+        // no storage, but the name still has to be deleted
+        MemoryTracker::track(MemoryTracker::TEXTURE, textureID, 0, MEMORY_TEXTURES, image.path);
     }
 
     return textureID;
 }
+
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+    TextureImage image = LoadTextureImage(path, directory);
+    return TextureFromImage(image);
+}
 #endif
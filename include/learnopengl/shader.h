@@ -16,6 +16,134 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    {
+        compile(vertexPath, fragmentPath, geometryPath, "");
+    }
+    // same as above, but every stage gets the given #define lines right after its #version line,
+    // e.g. Shader(vs, fs, nullptr, "#define BLOOM\n") builds the bloom variant of a shader
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const std::string &defines)
+    {
+        compile(vertexPath, fragmentPath, geometryPath, defines);
+    }
+    // wraps an already linked program (used by ShaderLibrary)
+    // ------------------------------------------------------------------------
+    explicit Shader(unsigned int programId) : ID(programId)
+    {
+    }
+    // compiles one stage and prints the info log if it fails (also appended to log if given)
+    // ------------------------------------------------------------------------
+    static unsigned int compileStage(GLenum type, const std::string &code, const std::string &typeName, bool *success = nullptr, std::string *log = nullptr)
+    {
+        const char *source = code.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        bool ok = checkCompileErrors(shader, typeName, log);
+        if (success)
+            *success = ok;
+        return shader;
+    }
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    static bool checkCompileErrors(GLuint shader, std::string type, std::string *log = nullptr)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if(type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if(!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                if (log)
+                    *log += type + ":\n" + infoLog;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if(!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                if (log)
+                    *log += type + ":\n" + infoLog;
+            }
+        }
+        return success;
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() 
+    { 
+        glUseProgram(ID); 
+    }
+    // utility uniform functions
+    // names are plain C strings, a std::string parameter would heap-allocate for every long literal
+    // ------------------------------------------------------------------------
+    void setBool(const char *name, bool value) const
+    {         
+        glUniform1i(glGetUniformLocation(ID, name), (int)value); 
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const char *name, int value) const
+    { 
+        glUniform1i(glGetUniformLocation(ID, name), value); 
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(const char *name, float value) const
+    { 
+        glUniform1f(glGetUniformLocation(ID, name), value); 
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const char *name, const glm::vec2 &value) const
+    { 
+        glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]); 
+    }
+    void setVec2(const char *name, float x, float y) const
+    { 
+        glUniform2f(glGetUniformLocation(ID, name), x, y); 
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(const char *name, const glm::vec3 &value) const
+    { 
+        glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]); 
+    }
+    void setVec3(const char *name, float x, float y, float z) const
+    { 
+        glUniform3f(glGetUniformLocation(ID, name), x, y, z); 
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(const char *name, const glm::vec4 &value) const
+    { 
+        glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]); 
+    }
+    void setVec4(const char *name, float x, float y, float z, float w) 
+    { 
+        glUniform4f(glGetUniformLocation(ID, name), x, y, z, w); 
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(const char *name, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const char *name, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const char *name, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+private:
+    // reads, compiles and links the program from the given files
+    // ------------------------------------------------------------------------
+    void compile(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const std::string &defines)
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
@@ -64,30 +192,20 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
+        vertexCode = addDefines(vertexCode, defines);
+        fragmentCode = addDefines(fragmentCode, defines);
+        if (geometryPath != nullptr)
+            geometryCode = addDefines(geometryCode, defines);
         // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        vertex = compileStage(GL_VERTEX_SHADER, vertexCode, "VERTEX");
         // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        fragment = compileStage(GL_FRAGMENT_SHADER, fragmentCode, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
         unsigned int geometry;
         if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
+            geometry = compileStage(GL_GEOMETRY_SHADER, geometryCode, "GEOMETRY");
         // shader Program
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
@@ -103,96 +221,16 @@ public:
             glDeleteShader(geometry);
 
     }
-    // activate the shader
-    // ------------------------------------------------------------------------
-    void use() 
-    { 
-        glUseProgram(ID); 
-    }
-    // utility uniform functions
-    // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
-    }
+    // inserts the define lines after the #version line (which has to stay first)
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
-    }
-    // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
-    {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-    // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
-    {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-    // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    static std::string addDefines(const std::string &code, const std::string &defines)
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-
-private:
-    // utility function for checking shader compilation/linking errors.
-    // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
-    {
-        GLint success;
-        GLchar infoLog[1024];
-        if(type != "PROGRAM")
-        {
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-            if(!success)
-            {
-                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-            }
-        }
-        else
-        {
-            glGetProgramiv(shader, GL_LINK_STATUS, &success);
-            if(!success)
-            {
-                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-            }
-        }
+        if (defines.empty())
+            return code;
+        size_t lineEnd = code.find('\n');
+        if (code.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos)
+            return defines + code;
+        return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
     }
 };
 #endif
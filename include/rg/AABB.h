@@ -0,0 +1,44 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_AABB_H
+#define PROJECT_BASE_AABB_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+// Axis aligned bounding box; an empty box has min > max.
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool empty() const { return min.x > max.x; }
+
+    void expand(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const AABB &box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    glm::vec3 corner(int i) const {
+        return glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    }
+
+    // box around the transformed corners
+    AABB transformed(const glm::mat4 &transform) const {
+        AABB result;
+        if (empty())
+            return result;
+        for (int i = 0; i < 8; i++)
+            result.expand(glm::vec3(transform * glm::vec4(corner(i), 1.0f)));
+        return result;
+    }
+};
+
+#endif //PROJECT_BASE_AABB_H
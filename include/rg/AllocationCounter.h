@@ -0,0 +1,210 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_ALLOCATIONCOUNTER_H
+#define PROJECT_BASE_ALLOCATIONCOUNTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// What a piece of memory belongs to, for the memory panel: CPU allocations are tagged by the AllocationScope
+// active on the allocating thread, GL objects when they are registered with MemoryTracker.
+enum MemorySubsystem : unsigned int {
+    MEMORY_GENERAL,
+    MEMORY_MESHES,
+    MEMORY_TEXTURES,
+    MEMORY_SKYBOX,
+    MEMORY_RENDER_TARGETS,
+    MEMORY_OCCLUSION,
+    MEMORY_SCENE,
+    MEMORY_BVH,
+    MEMORY_SHADOWS,
+    MEMORY_SUBSYSTEM_COUNT
+};
+
+inline const char *MemorySubsystemName(unsigned int subsystem) {
+    static const char *names[MEMORY_SUBSYSTEM_COUNT] = {"general", "meshes", "textures", "skybox",
+                                                        "renderTargets", "occlusion", "scene", "bvh",
+                                                        "shadows"};
+    return subsystem < MEMORY_SUBSYSTEM_COUNT ? names[subsystem] : "unknown";
+}
+
+// Counts every allocation that goes through operator new, so the render loop can check that a steady-state
+// frame allocates nothing: take a snapshot() at the start of the frame and compare at the end. The counts are
+// process-wide, since what the frame hands to the job system or the simulation thread is frame work too.
+// Threads that run on their own schedule (the autosave writer, the shader reloader) call
+// markBackgroundThread() and stay out of them; their blocks still count towards the live and peak bytes.
+// Live bytes are also kept per MemorySubsystem; a block is charged to the subsystem that allocated it,
+// whichever thread frees it.
+// The counters live here; the replacement operators are compiled into the one translation unit that defines
+// RG_ALLOCATION_COUNTER_IMPLEMENTATION before including this header. Plain malloc (ImGui, stb_image, the
+// arena blocks themselves) is not seen, which is why arenas get their blocks from malloc.
+class AllocationCounter {
+public:
+    struct Snapshot {
+        std::uint64_t allocations;
+        std::uint64_t bytes;
+    };
+
+    static Snapshot snapshot() {
+        return Snapshot{state().allocations.load(std::memory_order_relaxed), state().bytes.load(std::memory_order_relaxed)};
+    }
+
+    // allocations and bytes since an earlier snapshot
+    static Snapshot since(const Snapshot &earlier) {
+        Snapshot now = snapshot();
+        return Snapshot{now.allocations - earlier.allocations, now.bytes - earlier.bytes};
+    }
+
+    static std::uint64_t liveBytes() { return state().live.load(std::memory_order_relaxed); }
+
+    // highest liveBytes() so far, or since the last resetPeak()
+    static std::uint64_t peakBytes() { return state().peak.load(std::memory_order_relaxed); }
+
+    static void resetPeak() { state().peak.store(liveBytes(), std::memory_order_relaxed); }
+
+    // allocations the calling thread makes from now on are not frame work and don't show in snapshot()
+    static void markBackgroundThread() { backgroundThread() = true; }
+
+    static std::uint64_t liveBytes(unsigned int subsystem) {
+        return state().subsystemLive[subsystem].load(std::memory_order_relaxed);
+    }
+
+    // subsystem new allocations on this thread are charged to, see AllocationScope
+    static unsigned int &currentSubsystem() {
+        static thread_local unsigned int subsystem = MEMORY_GENERAL;
+        return subsystem;
+    }
+
+    // called by the replacement operators only
+    static void recordAllocation(std::size_t size, unsigned int subsystem) {
+        State &s = state();
+        s.subsystemLive[subsystem].fetch_add(size, std::memory_order_relaxed);
+        if (!backgroundThread()) {
+            s.allocations.fetch_add(1, std::memory_order_relaxed);
+            s.bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+        std::uint64_t live = s.live.fetch_add(size, std::memory_order_relaxed) + size;
+        std::uint64_t peak = s.peak.load(std::memory_order_relaxed);
+        while (live > peak && !s.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+
+    static void recordFree(std::size_t size, unsigned int subsystem) {
+        state().live.fetch_sub(size, std::memory_order_relaxed);
+        state().subsystemLive[subsystem].fetch_sub(size, std::memory_order_relaxed);
+    }
+
+private:
+    struct State {
+        std::atomic<std::uint64_t> allocations{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::uint64_t> live{0};
+        std::atomic<std::uint64_t> peak{0};
+        std::atomic<std::uint64_t> subsystemLive[MEMORY_SUBSYSTEM_COUNT] = {};
+    };
+
+    // plain data, so operator new can read it on a thread before anything else is constructed there
+    static bool &backgroundThread() {
+        static thread_local bool background = false;
+        return background;
+    }
+
+    // function static, so allocations made while other statics are constructed are counted too
+    static State &state() {
+        static State s;
+        return s;
+    }
+};
+
+// charges the allocations this thread makes while it exists to one subsystem
+class AllocationScope {
+public:
+    explicit AllocationScope(MemorySubsystem subsystem) : m_Previous(AllocationCounter::currentSubsystem()) {
+        AllocationCounter::currentSubsystem() = subsystem;
+    }
+
+    AllocationScope(const AllocationScope &) = delete;
+    AllocationScope &operator=(const AllocationScope &) = delete;
+
+    ~AllocationScope() { AllocationCounter::currentSubsystem() = m_Previous; }
+
+private:
+    unsigned int m_Previous;
+};
+
+#ifdef RG_ALLOCATION_COUNTER_IMPLEMENTATION
+
+#include <cstdlib>
+#include <new>
+
+namespace allocation_counter_detail {
+    // every block carries its size and subsystem in front, so operator delete knows what to take off
+    struct Header {
+        std::size_t size;
+        unsigned int subsystem;
+    };
+    constexpr std::size_t HEADER = alignof(std::max_align_t);
+    static_assert(sizeof(Header) <= HEADER, "allocation header must fit in front of the block");
+
+    inline void *allocate(std::size_t size) {
+        void *block = std::malloc(size + HEADER);
+        if (block == nullptr)
+            return nullptr;
+        Header *header = static_cast<Header *>(block);
+        header->size = size;
+        header->subsystem = AllocationCounter::currentSubsystem();
+        AllocationCounter::recordAllocation(size, header->subsystem);
+        return static_cast<unsigned char *>(block) + HEADER;
+    }
+
+    inline void release(void *pointer) {
+        if (pointer == nullptr)
+            return;
+        void *block = static_cast<unsigned char *>(pointer) - HEADER;
+        const Header *header = static_cast<const Header *>(block);
+        AllocationCounter::recordFree(header->size, header->subsystem);
+        std::free(block);
+    }
+
+    inline void *allocateOrThrow(std::size_t size) {
+        while (true) {
+            if (void *pointer = allocate(size))
+                return pointer;
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr)
+                throw std::bad_alloc();
+            handler();
+        }
+    }
+}
+
+void *operator new(std::size_t size) { return allocation_counter_detail::allocateOrThrow(size); }
+
+void *operator new[](std::size_t size) { return allocation_counter_detail::allocateOrThrow(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return allocation_counter_detail::allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return allocation_counter_detail::allocate(size);
+}
+
+void operator delete(void *pointer) noexcept { allocation_counter_detail::release(pointer); }
+
+void operator delete[](void *pointer) noexcept { allocation_counter_detail::release(pointer); }
+
+void operator delete(void *pointer, std::size_t) noexcept { allocation_counter_detail::release(pointer); }
+
+void operator delete[](void *pointer, std::size_t) noexcept { allocation_counter_detail::release(pointer); }
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { allocation_counter_detail::release(pointer); }
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { allocation_counter_detail::release(pointer); }
+
+#endif
+
+#endif //PROJECT_BASE_ALLOCATIONCOUNTER_H
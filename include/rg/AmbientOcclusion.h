@@ -0,0 +1,189 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_AMBIENTOCCLUSION_H
+#define PROJECT_BASE_AMBIENTOCCLUSION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/MemoryTracker.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Half resolution targets and settings of the SSAO pass (ssao.fs), outside the render graph because the
+// result of a frame is the history of the next one: two RG16F textures (occlusion, linear depth) swap roles
+// every frame, the shader reprojects the previous one and blends it in, so the noise that rotates the
+// sample kernel per pixel and per frame averages out over a few frames.
+// The kernel is a fixed hemisphere; sample i's distance follows a base-2 radical inverse, so the first
+// sampleCount() samples of it are spread over the whole radius whatever the count. updateBudget() scales
+// the count so the measured GPU time of the passes stays under a budget, like DynamicResolution does
+// with the render scale.
+class AmbientOcclusion {
+public:
+    static const int MAX_SAMPLES = 32;
+    static const int MIN_SAMPLES = 4;
+
+    AmbientOcclusion() {
+        std::mt19937 random(1234u);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (int i = 0; i < MAX_SAMPLES; i++) {
+            glm::vec3 direction;
+            do {
+                direction = glm::vec3(unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f, unit(random));
+            } while (glm::dot(direction, direction) > 1.0f || glm::dot(direction, direction) < 0.01f);
+            float t = radicalInverse(i + 1);
+            // more samples close to the point, they matter more
+            m_Kernel[i] = glm::normalize(direction) * (0.1f + 0.9f * t * t);
+        }
+    }
+
+    AmbientOcclusion(const AmbientOcclusion &) = delete;
+    AmbientOcclusion &operator=(const AmbientOcclusion &) = delete;
+
+    ~AmbientOcclusion() {
+        destroy();
+    }
+
+    // half of the window size; recreates the targets when it changes and drops the history
+    void resize(int width, int height) {
+        int halfWidth = std::max(1, (width + 1) / 2);
+        int halfHeight = std::max(1, (height + 1) / 2);
+        if (m_Textures[0] != 0 && halfWidth == m_TextureWidth && halfHeight == m_TextureHeight)
+            return;
+        destroy();
+        m_TextureWidth = halfWidth;
+        m_TextureHeight = halfHeight;
+        glGenTextures(2, m_Textures);
+        glGenFramebuffers(2, m_Framebuffers);
+        for (int i = 0; i < 2; i++) {
+            glBindTexture(GL_TEXTURE_2D, m_Textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, halfWidth, halfHeight, 0, GL_RG, GL_FLOAT, NULL);
+            // the history is read between texels after reprojection
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            MemoryTracker::track(MemoryTracker::TEXTURE, m_Textures[i],
+                                 MemoryTracker::textureBytes(GL_RG16F, halfWidth, halfHeight, false, 1),
+                                 MEMORY_RENDER_TARGETS, "ssao");
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Textures[i], 0);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        invalidateHistory();
+    }
+
+    // starts the frame: the last result becomes the history and the other target is bound, with a viewport
+    // over half of the render region; viewProjection is this frame's, for reprojection in the next one
+    void bind(int renderWidth, int renderHeight, const glm::mat4 &viewProjection) {
+        m_Current ^= 1;
+        m_HasHistory = m_Rendered;
+        m_Rendered = true;
+        m_HistoryWidth = m_Width;
+        m_HistoryHeight = m_Height;
+        m_Width = std::min(std::max(1, (renderWidth + 1) / 2), m_TextureWidth);
+        m_Height = std::min(std::max(1, (renderHeight + 1) / 2), m_TextureHeight);
+        m_PreviousViewProjection = m_ViewProjection;
+        m_ViewProjection = viewProjection;
+        m_Frame++;
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[m_Current]);
+        glViewport(0, 0, m_Width, m_Height);
+    }
+
+    // whether the history holds a usable previous frame; false after a resize or invalidateHistory()
+    bool hasHistory() const { return m_HasHistory; }
+
+    // the next frame starts from scratch (e.g. the pass was off for a while)
+    void invalidateHistory() {
+        m_HasHistory = false;
+        m_Rendered = false;
+    }
+
+    // moves the sample count towards what fits in budgetMs, given the measured time of the passes
+    void updateBudget(float gpuMs, float budgetMs, int maxSamples) {
+        maxSamples = std::min(std::max(maxSamples, MIN_SAMPLES), MAX_SAMPLES);
+        if (gpuMs <= 0.0f || budgetMs <= 0.0f) {
+            m_Samples = std::min(m_Samples, (float) maxSamples);
+            return;
+        }
+        m_AverageMs = m_HasAverage ? m_AverageMs * 0.8f + gpuMs * 0.2f : gpuMs;
+        m_HasAverage = true;
+        // cost is roughly linear in the sample count; 10% headroom for measurement noise
+        float ideal = m_Samples * budgetMs * 0.9f / m_AverageMs;
+        m_Samples += (std::min(std::max(ideal, (float) MIN_SAMPLES), (float) maxSamples) - m_Samples) * 0.2f;
+        m_Samples = std::min(std::max(m_Samples, (float) MIN_SAMPLES), (float) maxSamples);
+    }
+
+    int sampleCount() const { return (int) (m_Samples + 0.5f); }
+
+    float averageMs() const { return m_AverageMs; }
+
+    const glm::vec3 *kernel() const { return m_Kernel; }
+
+    // texture written this frame (after bind()) and the one from the previous frame
+    unsigned int texture() const { return m_Textures[m_Current]; }
+
+    unsigned int history() const { return m_Textures[m_Current ^ 1]; }
+
+    // texels of this frame's result, the rest of the texture is unused when the render scale is below 1
+    int width() const { return m_Width; }
+
+    int height() const { return m_Height; }
+
+    // uv of the history texture that covers the previous frame's whole render region
+    glm::vec2 historyScale() const {
+        return glm::vec2((float) m_HistoryWidth / m_TextureWidth, (float) m_HistoryHeight / m_TextureHeight);
+    }
+
+    const glm::mat4 &previousViewProjection() const { return m_PreviousViewProjection; }
+
+    unsigned int frame() const { return m_Frame; }
+
+    void destroy() {
+        if (m_Textures[0] == 0)
+            return;
+        glDeleteFramebuffers(2, m_Framebuffers);
+        glDeleteTextures(2, m_Textures);
+        for (unsigned int texture: m_Textures)
+            MemoryTracker::untrack(MemoryTracker::TEXTURE, texture);
+        m_Textures[0] = m_Textures[1] = 0;
+        m_Framebuffers[0] = m_Framebuffers[1] = 0;
+        invalidateHistory();
+    }
+
+private:
+    // 0.5, 0.25, 0.75, 0.125, ...: every prefix covers 0..1 evenly
+    static float radicalInverse(unsigned int i) {
+        float result = 0.0f;
+        float digit = 0.5f;
+        for (; i != 0; i >>= 1, digit *= 0.5f)
+            result += (i & 1u) ? digit : 0.0f;
+        return result;
+    }
+
+    glm::vec3 m_Kernel[MAX_SAMPLES];
+    unsigned int m_Textures[2] = {0, 0};
+    unsigned int m_Framebuffers[2] = {0, 0};
+    int m_Current = 0;
+    int m_TextureWidth = 0;
+    int m_TextureHeight = 0;
+    int m_Width = 0;
+    int m_Height = 0;
+    int m_HistoryWidth = 0;
+    int m_HistoryHeight = 0;
+    glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+    glm::mat4 m_PreviousViewProjection = glm::mat4(1.0f);
+    bool m_HasHistory = false;
+    // the target that becomes the history at the next bind() holds a frame
+    bool m_Rendered = false;
+    unsigned int m_Frame = 0;
+    float m_Samples = 16.0f;
+    float m_AverageMs = 0.0f;
+    bool m_HasAverage = false;
+};
+
+#endif //PROJECT_BASE_AMBIENTOCCLUSION_H
@@ -0,0 +1,703 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_BVH_H
+#define PROJECT_BASE_BVH_H
+
+#include <glm/glm.hpp>
+#include <rg/AABB.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RG_BVH_SSE2
+#endif
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Ray for BVH queries; t is measured in units of direction, which doesn't have to be normalized.
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float tMax;
+
+    Ray(const glm::vec3 &origin, const glm::vec3 &direction, float tMax = FLT_MAX)
+            : origin(origin), direction(direction), tMax(tMax) {}
+};
+
+struct RayHit {
+    float t = FLT_MAX;
+    // barycentric weights of the triangle's second and third vertex
+    float u = 0.0f;
+    float v = 0.0f;
+    // triangle in the mesh's own index order (vertices indices[3 * triangle] ...), ~0u when nothing was hit
+    unsigned int triangle = ~0u;
+    // id given to SceneBVH::add()
+    unsigned int instance = ~0u;
+
+    bool hit() const { return triangle != ~0u; }
+};
+
+// 32 bytes, so two siblings fit one cache line. An inner node's children are nodes leftFirst and
+// leftFirst + 1; a leaf (count > 0) holds count primitives starting at leftFirst.
+struct BVHNode {
+    float min[3];
+    unsigned int leftFirst;
+    float max[3];
+    unsigned int count;
+
+    bool leaf() const { return count > 0; }
+};
+
+// Binned SAH build (Wald 2007) shared by MeshBVH and SceneBVH, which only hand it primitive boxes.
+// Fills nodes (root at 0, node 1 unused so siblings start at even indices) and order, the primitive indices in
+// leaf order. Scratch arrays are kept, so rebuilding with the same number of primitives doesn't allocate.
+class BVHBuilder {
+public:
+    static const unsigned int BINS = 16;
+    // deeper than this splits go to the middle, which bounds the depth and so the traversal stack
+    static const unsigned int MAX_SAH_DEPTH = 64;
+    static const unsigned int MAX_DEPTH = MAX_SAH_DEPTH + 32;
+
+    void build(const AABB *boxes, unsigned int count, unsigned int maxLeafSize, std::vector<BVHNode> &nodes,
+               std::vector<unsigned int> &order) {
+        nodes.clear();
+        order.resize(count);
+        if (count == 0)
+            return;
+        m_Boxes = boxes;
+        m_Centroids.resize(count);
+        for (unsigned int i = 0; i < count; i++) {
+            m_Centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+            order[i] = i;
+        }
+        // a binary tree with count leaves has at most 2 * count - 1 nodes, plus the unused one
+        nodes.resize(2 * count);
+        unsigned int used = 2;
+        setRange(nodes[0], order, 0, count);
+        m_Stack.clear();
+        m_Stack.push_back(Task{0, 0});
+        while (!m_Stack.empty()) {
+            Task task = m_Stack.back();
+            m_Stack.pop_back();
+            BVHNode &node = nodes[task.node];
+            unsigned int first = node.leftFirst;
+            unsigned int size = node.count;
+            if (size <= 1)
+                continue;
+            unsigned int leftSize = task.depth < MAX_SAH_DEPTH ? partitionSah(node, order, maxLeafSize) : 0;
+            if (leftSize == LEAF)
+                continue;
+            if (leftSize == 0) {
+                // centroids too close together to bin, or too deep: any even split will do
+                if (size <= maxLeafSize)
+                    continue;
+                leftSize = size / 2;
+                std::nth_element(order.begin() + first, order.begin() + first + leftSize, order.begin() + first + size,
+                                 [this](unsigned int a, unsigned int b) { return m_Centroids[a].x < m_Centroids[b].x; });
+            }
+            unsigned int left = used;
+            used += 2;
+            setRange(nodes[left], order, first, leftSize);
+            setRange(nodes[left + 1], order, first + leftSize, size - leftSize);
+            node.leftFirst = left;
+            node.count = 0;
+            m_Stack.push_back(Task{left, task.depth + 1});
+            m_Stack.push_back(Task{left + 1, task.depth + 1});
+        }
+        nodes.resize(used);
+        m_Boxes = nullptr;
+    }
+
+    // half the surface area, 0 for an empty box
+    static float area(const AABB &box) {
+        if (box.empty())
+            return 0.0f;
+        glm::vec3 e = box.max - box.min;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    static AABB bounds(const BVHNode &node) {
+        AABB box;
+        box.min = glm::vec3(node.min[0], node.min[1], node.min[2]);
+        box.max = glm::vec3(node.max[0], node.max[1], node.max[2]);
+        return box;
+    }
+
+private:
+    static const unsigned int LEAF = ~0u;
+
+    struct Task {
+        unsigned int node;
+        unsigned int depth;
+    };
+
+    struct Bin {
+        AABB box;
+        unsigned int count = 0;
+    };
+
+    void setRange(BVHNode &node, const std::vector<unsigned int> &order, unsigned int first, unsigned int count) const {
+        AABB box;
+        for (unsigned int i = first; i < first + count; i++)
+            box.expand(m_Boxes[order[i]]);
+        for (int axis = 0; axis < 3; axis++) {
+            node.min[axis] = box.min[axis];
+            node.max[axis] = box.max[axis];
+        }
+        node.leftFirst = first;
+        node.count = count;
+    }
+
+    // partitions the node's primitives at the cheapest bin boundary and returns how many went left;
+    // LEAF when not splitting is cheaper, 0 when the centroids can't be binned
+    unsigned int partitionSah(const BVHNode &node, std::vector<unsigned int> &order, unsigned int maxLeafSize) {
+        unsigned int first = node.leftFirst;
+        unsigned int size = node.count;
+        AABB centroidBounds;
+        for (unsigned int i = first; i < first + size; i++)
+            centroidBounds.expand(m_Centroids[order[i]]);
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        unsigned int bestPlane = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+            if (extent <= 0.0f)
+                continue;
+            float scale = BINS / extent;
+            Bin bins[BINS];
+            for (unsigned int i = first; i < first + size; i++) {
+                Bin &bin = bins[binIndex(m_Centroids[order[i]][axis], centroidBounds.min[axis], scale)];
+                bin.count++;
+                bin.box.expand(m_Boxes[order[i]]);
+            }
+            // plane p puts bins [0, p] left and (p, BINS) right; sweep from the left, then from the right
+            float leftCost[BINS - 1];
+            unsigned int leftCount[BINS - 1];
+            AABB box;
+            unsigned int count = 0;
+            for (unsigned int p = 0; p < BINS - 1; p++) {
+                box.expand(bins[p].box);
+                count += bins[p].count;
+                leftCost[p] = count * area(box);
+                leftCount[p] = count;
+            }
+            box = AABB();
+            count = 0;
+            for (unsigned int p = BINS - 1; p > 0; p--) {
+                box.expand(bins[p].box);
+                count += bins[p].count;
+                float cost = leftCost[p - 1] + count * area(box);
+                if (count > 0 && leftCount[p - 1] > 0 && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestPlane = p - 1;
+                }
+            }
+        }
+        if (bestAxis < 0)
+            return 0;
+        // in primitive tests, one traversal step counted as one test
+        float nodeArea = area(bounds(node));
+        float splitCost = 1.0f + (nodeArea > 0.0f ? bestCost / nodeArea : 0.0f);
+        if (size <= maxLeafSize && splitCost >= (float) size)
+            return LEAF;
+        float min = centroidBounds.min[bestAxis];
+        float scale = BINS / (centroidBounds.max[bestAxis] - min);
+        unsigned int *begin = order.data() + first;
+        unsigned int *middle = std::partition(begin, begin + size, [&](unsigned int primitive) {
+            return binIndex(m_Centroids[primitive][bestAxis], min, scale) <= bestPlane;
+        });
+        unsigned int leftSize = middle - begin;
+        return leftSize < size ? leftSize : 0;
+    }
+
+    static unsigned int binIndex(float centroid, float min, float scale) {
+        return std::min(BINS - 1, (unsigned int) std::max(0.0f, (centroid - min) * scale));
+    }
+
+    const AABB *m_Boxes = nullptr;
+    std::vector<glm::vec3> m_Centroids;
+    std::vector<Task> m_Stack;
+};
+
+namespace bvh_detail {
+    // a ray prepared for the kernels: reciprocal direction for the slab test, components splatted for the
+    // four triangle packet test
+    struct RayData {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        glm::vec3 inverseDirection;
+#ifdef RG_BVH_SSE2
+        __m128 origin4;
+        __m128 inverseDirection4;
+        __m128 ox, oy, oz;
+        __m128 dx, dy, dz;
+#endif
+
+        explicit RayData(const Ray &ray)
+                : origin(ray.origin), direction(ray.direction), inverseDirection(1.0f / ray.direction) {
+#ifdef RG_BVH_SSE2
+            // w = 0 keeps the fourth lane (the node's leftFirst or count) finite
+            origin4 = _mm_set_ps(0.0f, origin.z, origin.y, origin.x);
+            inverseDirection4 = _mm_set_ps(0.0f, inverseDirection.z, inverseDirection.y, inverseDirection.x);
+            ox = _mm_set1_ps(origin.x);
+            oy = _mm_set1_ps(origin.y);
+            oz = _mm_set1_ps(origin.z);
+            dx = _mm_set1_ps(direction.x);
+            dy = _mm_set1_ps(direction.y);
+            dz = _mm_set1_ps(direction.z);
+#endif
+        }
+    };
+
+    // distance at which the ray enters the node's box, FLT_MAX if it misses it or only enters beyond tMax
+    inline float slab(const BVHNode &node, const RayData &ray, float tMax) {
+#ifdef RG_BVH_SSE2
+        // min and max are loaded with the integer after them, lane 3 is ignored
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min), ray.origin4), ray.inverseDirection4);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max), ray.origin4), ray.inverseDirection4);
+        __m128 near4 = _mm_min_ps(t1, t2);
+        __m128 far4 = _mm_max_ps(t1, t2);
+        __m128 tNear4 = _mm_max_ss(_mm_max_ss(near4, _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(1, 1, 1, 1))),
+                                   _mm_shuffle_ps(near4, near4, _MM_SHUFFLE(2, 2, 2, 2)));
+        __m128 tFar4 = _mm_min_ss(_mm_min_ss(far4, _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(1, 1, 1, 1))),
+                                  _mm_shuffle_ps(far4, far4, _MM_SHUFFLE(2, 2, 2, 2)));
+        float tNear = _mm_cvtss_f32(tNear4);
+        float tFar = _mm_cvtss_f32(tFar4);
+#else
+        glm::vec3 t1 = (glm::vec3(node.min[0], node.min[1], node.min[2]) - ray.origin) * ray.inverseDirection;
+        glm::vec3 t2 = (glm::vec3(node.max[0], node.max[1], node.max[2]) - ray.origin) * ray.inverseDirection;
+        glm::vec3 near3 = glm::min(t1, t2);
+        glm::vec3 far3 = glm::max(t1, t2);
+        float tNear = std::max(std::max(near3.x, near3.y), near3.z);
+        float tFar = std::min(std::min(far3.x, far3.y), far3.z);
+#endif
+        return tFar >= tNear && tFar >= 0.0f && tNear < tMax ? tNear : FLT_MAX;
+    }
+
+    // front to back walk over the nodes, nearer child first; leaf(node, tMax) tests the node's primitives,
+    // lowers tMax to the nearest hit and returns whether there was one. With anyHit the first hit ends the walk.
+    template<class Leaf>
+    bool traverse(const std::vector<BVHNode> &nodes, const RayData &ray, float tMax, bool anyHit, Leaf &&leaf) {
+        if (nodes.empty() || slab(nodes[0], ray, tMax) == FLT_MAX)
+            return false;
+        struct Entry {
+            const BVHNode *node;
+            float t;
+        };
+        Entry stack[BVHBuilder::MAX_DEPTH];
+        unsigned int depth = 0;
+        const BVHNode *node = &nodes[0];
+        bool found = false;
+        while (true) {
+            if (node->leaf()) {
+                if (leaf(*node, tMax)) {
+                    found = true;
+                    if (anyHit)
+                        return true;
+                }
+            } else {
+                const BVHNode *near = &nodes[node->leftFirst];
+                const BVHNode *far = near + 1;
+                float tNear = slab(*near, ray, tMax);
+                float tFar = slab(*far, ray, tMax);
+                if (tFar < tNear) {
+                    std::swap(near, far);
+                    std::swap(tNear, tFar);
+                }
+                if (tNear != FLT_MAX) {
+                    if (tFar != FLT_MAX)
+                        stack[depth++] = Entry{far, tFar};
+                    node = near;
+                    continue;
+                }
+            }
+            // boxes entered beyond the nearest hit found since they were pushed are skipped
+            do {
+                if (depth == 0)
+                    return found;
+                Entry entry = stack[--depth];
+                node = entry.node;
+                if (entry.t < tMax)
+                    break;
+            } while (true);
+        }
+    }
+}
+
+// Bounding volume hierarchy over the triangles of one mesh, for picking and other CPU ray queries.
+// Built with binned SAH; leaves hold up to four triangles, stored as one packet (first vertex and two
+// edges, structure of arrays) that the SSE2 kernel tests against a ray at once, and packets follow the
+// node order, so a walk down the tree reads memory mostly forward. The tree depends only on the geometry:
+// buildCached() keys a file in the cache directory with a hash of it and skips the build next time.
+// Positions are in the mesh's own space; place instances with SceneBVH.
+class MeshBVH {
+public:
+    static const unsigned int LEAF_TRIANGLES = 4;
+
+    struct TrianglePacket {
+        float v0[3][4];
+        float e1[3][4];
+        float e2[3][4];
+        // mesh triangle of each lane, ~0u in unused lanes (their edges are zero, so they are never hit)
+        unsigned int triangle[4];
+    };
+
+    void build(const glm::vec3 *positions, const unsigned int *indices, unsigned int indexCount) {
+        unsigned int triangleCount = indexCount / 3;
+        std::vector<AABB> boxes(triangleCount);
+        for (unsigned int i = 0; i < triangleCount; i++) {
+            for (int corner = 0; corner < 3; corner++)
+                boxes[i].expand(positions[indices[3 * i + corner]]);
+        }
+        std::vector<unsigned int> order;
+        BVHBuilder builder;
+        builder.build(boxes.data(), triangleCount, LEAF_TRIANGLES, m_Nodes, order);
+        m_Triangles = triangleCount;
+        m_Packets.clear();
+        for (BVHNode &node: m_Nodes) {
+            if (!node.leaf())
+                continue;
+            TrianglePacket packet = {};
+            for (unsigned int lane = 0; lane < 4; lane++) {
+                if (lane >= node.count) {
+                    packet.triangle[lane] = ~0u;
+                    continue;
+                }
+                unsigned int triangle = order[node.leftFirst + lane];
+                glm::vec3 v0 = positions[indices[3 * triangle]];
+                glm::vec3 e1 = positions[indices[3 * triangle + 1]] - v0;
+                glm::vec3 e2 = positions[indices[3 * triangle + 2]] - v0;
+                for (int axis = 0; axis < 3; axis++) {
+                    packet.v0[axis][lane] = v0[axis];
+                    packet.e1[axis][lane] = e1[axis];
+                    packet.e2[axis][lane] = e2[axis];
+                }
+                packet.triangle[lane] = triangle;
+            }
+            node.leftFirst = m_Packets.size();
+            m_Packets.push_back(packet);
+        }
+    }
+
+    // loads the tree an earlier run built for the same geometry from cacheDirectory, or builds it and
+    // stores it there; returns true when it came from the cache
+    bool buildCached(const glm::vec3 *positions, unsigned int vertexCount, const unsigned int *indices,
+                     unsigned int indexCount, const std::string &cacheDirectory) {
+        std::uint64_t key = hash(positions, vertexCount, indices, indexCount);
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.bvh", (unsigned long long) key);
+        std::string path = cacheDirectory + name;
+        if (load(path, key) && m_Triangles == indexCount / 3)
+            return true;
+        build(positions, indices, indexCount);
+        mkdir(cacheDirectory.c_str(), 0755);
+        save(path, key);
+        return false;
+    }
+
+    bool save(const std::string &path, std::uint64_t key) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        FileHeader header = {FILE_MAGIC, FILE_VERSION, (std::uint32_t) m_Nodes.size(), (std::uint32_t) m_Packets.size(),
+                             m_Triangles, 0, key};
+        out.write((const char *) &header, sizeof(header));
+        out.write((const char *) m_Nodes.data(), m_Nodes.size() * sizeof(BVHNode));
+        out.write((const char *) m_Packets.data(), m_Packets.size() * sizeof(TrianglePacket));
+        return (bool) out;
+    }
+
+    // a file from another version or other geometry (key mismatch) is rejected, and so is one whose tree
+    // doesn't hold together (truncated or damaged), the walk would read past the arrays
+    bool load(const std::string &path, std::uint64_t key) {
+        std::ifstream in(path, std::ios::binary);
+        FileHeader header;
+        if (!in || !in.read((char *) &header, sizeof(header)))
+            return false;
+        if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.key != key)
+            return false;
+        std::vector<BVHNode> nodes(header.nodeCount);
+        std::vector<TrianglePacket> packets(header.packetCount);
+        if (!in.read((char *) nodes.data(), nodes.size() * sizeof(BVHNode))
+            || !in.read((char *) packets.data(), packets.size() * sizeof(TrianglePacket)))
+            return false;
+        if (!valid(nodes, packets, header.triangleCount))
+            return false;
+        m_Nodes.swap(nodes);
+        m_Packets.swap(packets);
+        m_Triangles = header.triangleCount;
+        return true;
+    }
+
+    // FNV-1a over the positions and indices, 32 bits at a time
+    static std::uint64_t hash(const glm::vec3 *positions, unsigned int vertexCount, const unsigned int *indices,
+                              unsigned int indexCount) {
+        std::uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void *data, std::size_t bytes) {
+            const unsigned char *cursor = static_cast<const unsigned char *>(data);
+            for (std::size_t i = 0; i + 4 <= bytes; i += 4) {
+                std::uint32_t word;
+                memcpy(&word, cursor + i, 4);
+                h ^= word;
+                h *= 1099511628211ull;
+            }
+        };
+        mix(&vertexCount, sizeof(vertexCount));
+        mix(&indexCount, sizeof(indexCount));
+        mix(positions, vertexCount * sizeof(glm::vec3));
+        mix(indices, indexCount * sizeof(unsigned int));
+        return h;
+    }
+
+    // nearest hit closer than hit.t and ray.tMax; fills hit and returns true if there is one
+    bool intersect(const Ray &ray, RayHit &hit) const {
+        bvh_detail::RayData data(ray);
+        return bvh_detail::traverse(m_Nodes, data, std::min(ray.tMax, hit.t), false,
+                                    [&](const BVHNode &node, float &tMax) {
+                                        return intersectPacket(m_Packets[node.leftFirst], data, tMax, hit);
+                                    });
+    }
+
+    // whether anything is hit closer than ray.tMax, for shadow and visibility rays
+    bool occluded(const Ray &ray) const {
+        bvh_detail::RayData data(ray);
+        RayHit hit;
+        return bvh_detail::traverse(m_Nodes, data, ray.tMax, true, [&](const BVHNode &node, float &tMax) {
+            return intersectPacket(m_Packets[node.leftFirst], data, tMax, hit);
+        });
+    }
+
+    AABB bounds() const { return m_Nodes.empty() ? AABB() : BVHBuilder::bounds(m_Nodes[0]); }
+
+    unsigned int triangleCount() const { return m_Triangles; }
+
+    unsigned int nodeCount() const { return m_Nodes.size(); }
+
+    std::size_t bytes() const { return m_Nodes.size() * sizeof(BVHNode) + m_Packets.size() * sizeof(TrianglePacket); }
+
+    static const char *instructionSet() {
+#ifdef RG_BVH_SSE2
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    struct FileHeader {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t nodeCount;
+        std::uint32_t packetCount;
+        std::uint32_t triangleCount;
+        std::uint32_t padding;
+        std::uint64_t key;
+    };
+    static const std::uint32_t FILE_MAGIC = 0x56424752; // "RGBV"
+    static const std::uint32_t FILE_VERSION = 1;
+
+    // every node reachable from the root: children inside the array, after their parent and with no other
+    // parent (so the walk ends), no deeper than the traversal stack, leaves of at most LEAF_TRIANGLES triangles with an existing packet
+    // whose lanes name existing triangles; node 1 and other unreachable nodes are not looked at
+    static bool valid(const std::vector<BVHNode> &nodes, const std::vector<TrianglePacket> &packets,
+                      unsigned int triangleCount) {
+        if (nodes.empty())
+            return packets.empty();
+        std::vector<unsigned int> depths(nodes.size(), 0);
+        std::vector<unsigned int> pending(1, 0);
+        while (!pending.empty()) {
+            unsigned int index = pending.back();
+            pending.pop_back();
+            const BVHNode &node = nodes[index];
+            if (node.leaf()) {
+                if (node.count > LEAF_TRIANGLES || node.leftFirst >= packets.size())
+                    return false;
+                for (unsigned int triangle: packets[node.leftFirst].triangle) {
+                    if (triangle != ~0u && triangle >= triangleCount)
+                        return false;
+                }
+                continue;
+            }
+            unsigned int left = node.leftFirst;
+            if (left <= index || left >= nodes.size() - 1 || depths[index] + 1 >= BVHBuilder::MAX_DEPTH)
+                return false;
+            // a node with two parents would be walked twice, in a damaged file possibly exponentially often
+            if (depths[left] != 0 || depths[left + 1] != 0)
+                return false;
+            depths[left] = depths[left + 1] = depths[index] + 1;
+            pending.push_back(left);
+            pending.push_back(left + 1);
+        }
+        return true;
+    }
+
+    // Moller-Trumbore against the four triangles of a packet, both faces
+    static bool intersectPacket(const TrianglePacket &packet, const bvh_detail::RayData &ray, float &tMax, RayHit &hit) {
+        float t[4], u[4], v[4];
+        int mask;
+#ifdef RG_BVH_SSE2
+        __m128 e1x = _mm_loadu_ps(packet.e1[0]), e1y = _mm_loadu_ps(packet.e1[1]), e1z = _mm_loadu_ps(packet.e1[2]);
+        __m128 e2x = _mm_loadu_ps(packet.e2[0]), e2y = _mm_loadu_ps(packet.e2[1]), e2z = _mm_loadu_ps(packet.e2[2]);
+        // p = direction x e2
+        __m128 px = _mm_sub_ps(_mm_mul_ps(ray.dy, e2z), _mm_mul_ps(ray.dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(ray.dz, e2x), _mm_mul_ps(ray.dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(ray.dx, e2y), _mm_mul_ps(ray.dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+        __m128 sx = _mm_sub_ps(ray.ox, _mm_loadu_ps(packet.v0[0]));
+        __m128 sy = _mm_sub_ps(ray.oy, _mm_loadu_ps(packet.v0[1]));
+        __m128 sz = _mm_sub_ps(ray.oz, _mm_loadu_ps(packet.v0[2]));
+        __m128 u4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+        // q = s x e1
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 v4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ray.dx, qx), _mm_mul_ps(ray.dy, qy)), _mm_mul_ps(ray.dz, qz)), inverseDet);
+        __m128 t4 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+        __m128 zero = _mm_setzero_ps();
+        // comparisons with NaN (from a zero determinant) are false
+        __m128 inside = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_and_ps(_mm_cmpge_ps(u4, zero), _mm_cmpge_ps(v4, zero)));
+        inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(u4, v4), _mm_set1_ps(1.0f)));
+        inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(t4, zero), _mm_cmplt_ps(t4, _mm_set1_ps(tMax))));
+        mask = _mm_movemask_ps(inside);
+        if (mask == 0)
+            return false;
+        _mm_storeu_ps(t, t4);
+        _mm_storeu_ps(u, u4);
+        _mm_storeu_ps(v, v4);
+#else
+        mask = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            glm::vec3 e1(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]);
+            glm::vec3 e2(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]);
+            glm::vec3 p = glm::cross(ray.direction, e2);
+            float det = glm::dot(e1, p);
+            if (det == 0.0f)
+                continue;
+            float inverseDet = 1.0f / det;
+            glm::vec3 s = ray.origin - glm::vec3(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+            glm::vec3 q = glm::cross(s, e1);
+            u[lane] = glm::dot(s, p) * inverseDet;
+            v[lane] = glm::dot(ray.direction, q) * inverseDet;
+            t[lane] = glm::dot(e2, q) * inverseDet;
+            if (u[lane] >= 0.0f && v[lane] >= 0.0f && u[lane] + v[lane] <= 1.0f && t[lane] > 0.0f && t[lane] < tMax)
+                mask |= 1 << lane;
+        }
+        if (mask == 0)
+            return false;
+#endif
+        for (int lane = 0; lane < 4; lane++) {
+            if (!(mask & (1 << lane)) || t[lane] >= tMax)
+                continue;
+            tMax = t[lane];
+            hit.t = t[lane];
+            hit.u = u[lane];
+            hit.v = v[lane];
+            hit.triangle = packet.triangle[lane];
+        }
+        return true;
+    }
+
+    std::vector<BVHNode> m_Nodes;
+    std::vector<TrianglePacket> m_Packets;
+    unsigned int m_Triangles = 0;
+};
+
+// Top level hierarchy over placed MeshBVHs. A ray is taken into each instance's space, so instances share
+// their mesh trees, and moving an instance only takes setTransform() and a build() of this small tree.
+// Hits report the instance id given to add().
+class SceneBVH {
+public:
+    // the mesh must outlive this; returns the instance index for setTransform()
+    unsigned int add(const MeshBVH &mesh, const glm::mat4 &transform, unsigned int id) {
+        Instance instance;
+        instance.mesh = &mesh;
+        instance.id = id;
+        m_Instances.push_back(instance);
+        m_Bounds.emplace_back();
+        setTransform(m_Instances.size() - 1, transform);
+        return m_Instances.size() - 1;
+    }
+
+    // takes effect with the next build()
+    void setTransform(unsigned int index, const glm::mat4 &transform) {
+        Instance &instance = m_Instances[index];
+        instance.transform = transform;
+        instance.inverse = glm::inverse(transform);
+        m_Bounds[index] = instance.mesh->bounds().transformed(transform);
+    }
+
+    void clear() {
+        m_Instances.clear();
+        m_Bounds.clear();
+        m_Nodes.clear();
+    }
+
+    void build() {
+        m_Builder.build(m_Bounds.data(), m_Bounds.size(), 1, m_Nodes, m_Order);
+    }
+
+    // hit.t stays in world units: the local ray's direction is the transformed world direction, not normalized
+    bool intersect(const Ray &ray, RayHit &hit) const {
+        bvh_detail::RayData data(ray);
+        return bvh_detail::traverse(m_Nodes, data, std::min(ray.tMax, hit.t), false,
+                                    [&](const BVHNode &node, float &tMax) {
+                                        bool found = false;
+                                        for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                                            const Instance &instance = m_Instances[m_Order[i]];
+                                            if (instance.mesh->intersect(localRay(instance, ray, tMax), hit)) {
+                                                hit.instance = instance.id;
+                                                tMax = hit.t;
+                                                found = true;
+                                            }
+                                        }
+                                        return found;
+                                    });
+    }
+
+    bool occluded(const Ray &ray) const {
+        bvh_detail::RayData data(ray);
+        return bvh_detail::traverse(m_Nodes, data, ray.tMax, true, [&](const BVHNode &node, float &tMax) {
+            for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                const Instance &instance = m_Instances[m_Order[i]];
+                if (instance.mesh->occluded(localRay(instance, ray, tMax)))
+                    return true;
+            }
+            return false;
+        });
+    }
+
+    unsigned int instanceCount() const { return m_Instances.size(); }
+
+    const glm::mat4 &transform(unsigned int index) const { return m_Instances[index].transform; }
+
+private:
+    struct Instance {
+        const MeshBVH *mesh = nullptr;
+        glm::mat4 transform;
+        glm::mat4 inverse;
+        unsigned int id = 0;
+    };
+
+    static Ray localRay(const Instance &instance, const Ray &ray, float tMax) {
+        return Ray(glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f)),
+                   glm::vec3(instance.inverse * glm::vec4(ray.direction, 0.0f)), tMax);
+    }
+
+    std::vector<Instance> m_Instances;
+    // world bounds of every instance, what the tree is built over
+    std::vector<AABB> m_Bounds;
+    std::vector<BVHNode> m_Nodes;
+    std::vector<unsigned int> m_Order;
+    BVHBuilder m_Builder;
+};
+
+#endif //PROJECT_BASE_BVH_H
@@ -0,0 +1,170 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_CASCADEDSHADOWMAP_H
+#define PROJECT_BASE_CASCADEDSHADOWMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/AABB.h>
+#include <rg/Frustum.h>
+#include <rg/MemoryTracker.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Shadow map of the directional light, split into cascades along the view so texels near the camera are small.
+// fit() is all CPU: the view range up to maxDistance is split between a logarithmic and a uniform split (lambda),
+// every slice of the camera frustum gets a bounding sphere and an orthographic light projection around it.
+// The sphere's radius depends only on the slice, not on where the camera looks, and its center is moved in
+// whole texels in light space, so a still light gives the same texel grid every frame and edges don't shimmer.
+// The projection reaches back to the scene bounds, so casters between the slice and the light are kept.
+// The depth is a GL_TEXTURE_2D_ARRAY with one layer (and framebuffer) per cascade, sampled with depth compare.
+class CascadedShadowMap {
+public:
+    static const int MAX_CASCADES = 4;
+
+    CascadedShadowMap() = default;
+    CascadedShadowMap(const CascadedShadowMap &) = delete;
+    CascadedShadowMap &operator=(const CascadedShadowMap &) = delete;
+
+    ~CascadedShadowMap() {
+        destroy();
+    }
+
+    // (re)creates the texture array if the size or the cascade count changed
+    void resize(int resolution, int cascadeCount) {
+        cascadeCount = std::min(std::max(cascadeCount, 1), MAX_CASCADES);
+        if (m_Texture != 0 && resolution == m_Resolution && cascadeCount == m_CascadeCount)
+            return;
+        destroy();
+        m_Resolution = resolution;
+        m_CascadeCount = cascadeCount;
+        glGenTextures(1, &m_Texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_Texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        // linear filtering with depth compare gives 2x2 PCF per tap
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        // outside the map is lit
+        float border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        MemoryTracker::track(MemoryTracker::TEXTURE, m_Texture,
+                             MemoryTracker::textureBytes(GL_DEPTH_COMPONENT24, resolution, resolution, false, cascadeCount),
+                             MEMORY_SHADOWS, "cascaded shadow map");
+        glGenFramebuffers(cascadeCount, m_Framebuffers);
+        for (int i = 0; i < cascadeCount; i++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[i]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Texture, 0, i);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // cascades for a perspective camera (fovY in radians) and a light shining along lightDirection;
+    // sceneBounds holds every caster
+    void fit(const glm::mat4 &view, float fovY, float aspect, float nearPlane, float maxDistance, float lambda,
+             const glm::vec3 &lightDirection, const AABB &sceneBounds) {
+        glm::mat4 inverseView = glm::inverse(view);
+        glm::vec3 direction = glm::normalize(lightDirection);
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        // fixed for a given light, so the snapping grid is too
+        glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+        // nearest the light any caster gets, along light space z (the light looks down -z)
+        float casterZ = -FLT_MAX;
+        for (int corner = 0; corner < 8 && !sceneBounds.empty(); corner++)
+            casterZ = std::max(casterZ, (lightRotation * glm::vec4(sceneBounds.corner(corner), 1.0f)).z);
+        float tanHalfFov = std::tan(fovY * 0.5f);
+        float previousSplit = nearPlane;
+        for (int c = 0; c < m_CascadeCount; c++) {
+            float t = (float) (c + 1) / m_CascadeCount;
+            float logarithmic = nearPlane * std::pow(maxDistance / nearPlane, t);
+            float uniform = nearPlane + (maxDistance - nearPlane) * t;
+            float split = lambda * logarithmic + (1.0f - lambda) * uniform;
+            // the slice's corners in view space, so center and radius come out the same however the camera turns
+            glm::vec3 corners[8];
+            glm::vec3 center(0.0f);
+            for (int corner = 0; corner < 8; corner++) {
+                float z = (corner & 4) ? split : previousSplit;
+                corners[corner] = glm::vec3(((corner & 1) ? 1.0f : -1.0f) * z * tanHalfFov * aspect,
+                                            ((corner & 2) ? 1.0f : -1.0f) * z * tanHalfFov, -z);
+                center += corners[corner] / 8.0f;
+            }
+            float radius = 0.0f;
+            for (const glm::vec3 &corner: corners)
+                radius = std::max(radius, glm::length(corner - center));
+            // rounded up, float noise in the radius would change the texel size
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+            glm::vec3 lightCenter = glm::vec3(lightRotation * inverseView * glm::vec4(center, 1.0f));
+            float texel = 2.0f * radius / m_Resolution;
+            lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+            lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+            float zNear = -std::max(casterZ, lightCenter.z + radius);
+            float zFar = -(lightCenter.z - radius);
+            glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius,
+                                              lightCenter.y + radius, zNear, zFar);
+            m_Cascades[c].matrix = projection * lightRotation;
+            m_Cascades[c].splitDistance = split;
+            m_Cascades[c].texelSize = texel;
+            previousSplit = split;
+        }
+    }
+
+    // binds the cascade's layer as the depth target, with a full viewport and cleared depth
+    void bindCascade(int cascade) const {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[cascade]);
+        glViewport(0, 0, m_Resolution, m_Resolution);
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // world to clip space of the cascade's light projection
+    const glm::mat4 &matrix(int cascade) const { return m_Cascades[cascade].matrix; }
+
+    // view depth (distance along the camera's forward axis) where the cascade ends
+    float splitDistance(int cascade) const { return m_Cascades[cascade].splitDistance; }
+
+    // world size of one texel of the cascade, for the normal offset in the shader
+    float texelSize(int cascade) const { return m_Cascades[cascade].texelSize; }
+
+    Frustum frustum(int cascade) const { return Frustum(m_Cascades[cascade].matrix); }
+
+    unsigned int texture() const { return m_Texture; }
+
+    int resolution() const { return m_Resolution; }
+
+    int cascadeCount() const { return m_CascadeCount; }
+
+    void destroy() {
+        if (m_Texture == 0)
+            return;
+        glDeleteFramebuffers(m_CascadeCount, m_Framebuffers);
+        glDeleteTextures(1, &m_Texture);
+        MemoryTracker::untrack(MemoryTracker::TEXTURE, m_Texture);
+        m_Texture = 0;
+    }
+
+private:
+    struct Cascade {
+        glm::mat4 matrix = glm::mat4(1.0f);
+        float splitDistance = 0.0f;
+        float texelSize = 0.0f;
+    };
+
+    Cascade m_Cascades[MAX_CASCADES];
+    unsigned int m_Framebuffers[MAX_CASCADES] = {0};
+    unsigned int m_Texture = 0;
+    int m_Resolution = 0;
+    int m_CascadeCount = 0;
+};
+
+#endif //PROJECT_BASE_CASCADEDSHADOWMAP_H
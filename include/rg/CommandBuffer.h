@@ -0,0 +1,305 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_COMMANDBUFFER_H
+#define PROJECT_BASE_COMMANDBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/JobSystem.h>
+#include <rg/LinearAllocator.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Compact list of GL commands, recorded on any thread and replayed with execute() on the GL thread.
+// Commands are a small header plus plain data, stored in segments taken from a LinearAllocator, so
+// recording never calls GL or the heap. Uniforms are set by location; look locations up once on the GL
+// thread before recording instead of by name per draw. Binds that repeat the state this buffer already
+// set are dropped while recording; every buffer starts from unknown state, so replaying buffers in any
+// order stays correct. The buffer is valid until its allocator is reset.
+class CommandBuffer {
+public:
+    void begin(LinearAllocator &allocator) {
+        m_Allocator = &allocator;
+        m_First = m_Last = nullptr;
+        m_Commands = 0;
+        m_Draws = 0;
+        m_Program = m_VertexArray = ~0u;
+        std::fill(m_Textures, m_Textures + MAX_TEXTURE_UNITS, ~0u);
+    }
+
+    void useProgram(unsigned int program) {
+        if (program == m_Program)
+            return;
+        m_Program = program;
+        push(USE_PROGRAM, &program, sizeof(program));
+    }
+
+    void bindVertexArray(unsigned int vertexArray) {
+        if (vertexArray == m_VertexArray)
+            return;
+        m_VertexArray = vertexArray;
+        push(BIND_VERTEX_ARRAY, &vertexArray, sizeof(vertexArray));
+    }
+
+    void bindTexture(unsigned int unit, unsigned int target, unsigned int texture) {
+        if (unit < MAX_TEXTURE_UNITS) {
+            if (m_Textures[unit] == texture)
+                return;
+            m_Textures[unit] = texture;
+        }
+        unsigned int data[3] = {unit, target, texture};
+        push(BIND_TEXTURE, data, sizeof(data));
+    }
+
+    void uniform(int location, int value) {
+        if (location >= 0)
+            pushUniform(UNIFORM_INT, location, &value, sizeof(value));
+    }
+
+    void uniform(int location, float value) {
+        if (location >= 0)
+            pushUniform(UNIFORM_FLOAT, location, &value, sizeof(value));
+    }
+
+    void uniform(int location, const glm::vec3 &value) {
+        if (location >= 0)
+            pushUniform(UNIFORM_VEC3, location, &value[0], sizeof(glm::vec3));
+    }
+
+    void uniform(int location, const glm::mat4 &value) {
+        if (location >= 0)
+            pushUniform(UNIFORM_MAT4, location, &value[0][0], sizeof(glm::mat4));
+    }
+
+    void drawElements(unsigned int mode, unsigned int count, unsigned int type, std::size_t offset = 0) {
+        DrawElements draw = {mode, count, type, (std::uint64_t) offset};
+        push(DRAW_ELEMENTS, &draw, sizeof(draw));
+        m_Draws++;
+    }
+
+    void drawArrays(unsigned int mode, int first, unsigned int count) {
+        unsigned int data[3] = {mode, (unsigned int) first, count};
+        push(DRAW_ARRAYS, data, sizeof(data));
+        m_Draws++;
+    }
+
+    // replays the commands on the thread that owns the GL context; leaves no vertex array bound
+    void execute() const {
+        for (const Segment *segment = m_First; segment; segment = segment->next) {
+            const unsigned char *cursor = segment->data();
+            const unsigned char *end = cursor + segment->used;
+            while (cursor < end) {
+                Header header;
+                memcpy(&header, cursor, sizeof(header));
+                const unsigned char *payload = cursor + sizeof(Header);
+                run(static_cast<Type>(header.type), payload);
+                cursor += header.size;
+            }
+        }
+        if (m_Commands > 0)
+            glBindVertexArray(0);
+    }
+
+    unsigned int commandCount() const { return m_Commands; }
+
+    unsigned int drawCount() const { return m_Draws; }
+
+private:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    // payloads are copied into segments of at least this many bytes
+    static const std::size_t SEGMENT_BYTES = 4096;
+
+    enum Type : std::uint16_t {
+        USE_PROGRAM,
+        BIND_VERTEX_ARRAY,
+        BIND_TEXTURE,
+        UNIFORM_INT,
+        UNIFORM_FLOAT,
+        UNIFORM_VEC3,
+        UNIFORM_MAT4,
+        DRAW_ELEMENTS,
+        DRAW_ARRAYS,
+    };
+
+    struct Header {
+        std::uint16_t type;
+        // header and payload, rounded up to keep the next header aligned
+        std::uint16_t size;
+    };
+
+    struct DrawElements {
+        unsigned int mode;
+        unsigned int count;
+        unsigned int type;
+        std::uint64_t offset;
+    };
+
+    struct Segment {
+        Segment *next;
+        std::size_t used;
+        std::size_t capacity;
+
+        unsigned char *data() { return reinterpret_cast<unsigned char *>(this + 1); }
+
+        const unsigned char *data() const { return reinterpret_cast<const unsigned char *>(this + 1); }
+    };
+
+    void pushUniform(Type type, int location, const void *value, std::size_t size) {
+        unsigned char data[sizeof(int) + sizeof(glm::mat4)];
+        memcpy(data, &location, sizeof(int));
+        memcpy(data + sizeof(int), value, size);
+        push(type, data, sizeof(int) + size);
+    }
+
+    void push(Type type, const void *payload, std::size_t payloadSize) {
+        std::size_t size = (sizeof(Header) + payloadSize + 3) & ~std::size_t(3);
+        if (!m_Last || m_Last->used + size > m_Last->capacity) {
+            std::size_t capacity = std::max(SEGMENT_BYTES, size);
+            Segment *segment = static_cast<Segment *>(m_Allocator->allocate(sizeof(Segment) + capacity));
+            segment->next = nullptr;
+            segment->used = 0;
+            segment->capacity = capacity;
+            if (m_Last)
+                m_Last->next = segment;
+            else
+                m_First = segment;
+            m_Last = segment;
+        }
+        unsigned char *cursor = m_Last->data() + m_Last->used;
+        Header header = {type, (std::uint16_t) size};
+        memcpy(cursor, &header, sizeof(header));
+        memcpy(cursor + sizeof(Header), payload, payloadSize);
+        m_Last->used += size;
+        m_Commands++;
+    }
+
+    static void run(Type type, const unsigned char *payload) {
+        unsigned int u[3];
+        int location;
+        float f[16];
+        switch (type) {
+            case USE_PROGRAM:
+                memcpy(u, payload, sizeof(unsigned int));
+                glUseProgram(u[0]);
+                break;
+            case BIND_VERTEX_ARRAY:
+                memcpy(u, payload, sizeof(unsigned int));
+                glBindVertexArray(u[0]);
+                break;
+            case BIND_TEXTURE:
+                memcpy(u, payload, 3 * sizeof(unsigned int));
+                glActiveTexture(GL_TEXTURE0 + u[0]);
+                glBindTexture(u[1], u[2]);
+                break;
+            case UNIFORM_INT:
+                memcpy(&location, payload, sizeof(int));
+                memcpy(u, payload + sizeof(int), sizeof(int));
+                glUniform1i(location, (int) u[0]);
+                break;
+            case UNIFORM_FLOAT:
+                memcpy(&location, payload, sizeof(int));
+                memcpy(f, payload + sizeof(int), sizeof(float));
+                glUniform1f(location, f[0]);
+                break;
+            case UNIFORM_VEC3:
+                memcpy(&location, payload, sizeof(int));
+                memcpy(f, payload + sizeof(int), 3 * sizeof(float));
+                glUniform3fv(location, 1, f);
+                break;
+            case UNIFORM_MAT4:
+                memcpy(&location, payload, sizeof(int));
+                memcpy(f, payload + sizeof(int), 16 * sizeof(float));
+                glUniformMatrix4fv(location, 1, GL_FALSE, f);
+                break;
+            case DRAW_ELEMENTS: {
+                DrawElements draw;
+                memcpy(&draw, payload, sizeof(draw));
+                glDrawElements(draw.mode, draw.count, draw.type, (const void *) (std::uintptr_t) draw.offset);
+                break;
+            }
+            case DRAW_ARRAYS:
+                memcpy(u, payload, 3 * sizeof(unsigned int));
+                glDrawArrays(u[0], (int) u[1], u[2]);
+                break;
+        }
+    }
+
+    LinearAllocator *m_Allocator = nullptr;
+    Segment *m_First = nullptr;
+    Segment *m_Last = nullptr;
+    unsigned int m_Commands = 0;
+    unsigned int m_Draws = 0;
+    // last state set by this buffer, ~0u = unknown
+    unsigned int m_Program = ~0u;
+    unsigned int m_VertexArray = ~0u;
+    unsigned int m_Textures[MAX_TEXTURE_UNITS];
+};
+
+// Command buffers recorded in parallel over a JobSystem and replayed in order on the GL thread.
+// record(jobs, count, f) calls f(buffer, index) for every index; each index gets its own buffer, backed by
+// the allocator of the thread that happens to run it, and execute() replays them by index, so the GL
+// command stream is the same however the work was spread over threads. reset() once per frame.
+class CommandQueue {
+public:
+    template<class F>
+    void record(JobSystem &jobs, unsigned int count, F &&f) {
+        while (m_Allocators.size() < jobs.threadCount())
+            m_Allocators.emplace_back();
+        unsigned int first = m_Used;
+        m_Used += count;
+        if (m_Buffers.size() < m_Used)
+            m_Buffers.resize(m_Used);
+        jobs.parallelFor(count, [&](unsigned int index, unsigned int thread) {
+            CommandBuffer &buffer = m_Buffers[first + index];
+            buffer.begin(m_Allocators[thread]);
+            f(buffer, index);
+        });
+    }
+
+    void execute() const {
+        for (unsigned int i = 0; i < m_Used; i++)
+            m_Buffers[i].execute();
+    }
+
+    void reset() {
+        for (LinearAllocator &allocator: m_Allocators)
+            allocator.reset();
+        m_Used = 0;
+    }
+
+    unsigned int drawCount() const {
+        unsigned int draws = 0;
+        for (unsigned int i = 0; i < m_Used; i++)
+            draws += m_Buffers[i].drawCount();
+        return draws;
+    }
+
+    unsigned int commandCount() const {
+        unsigned int commands = 0;
+        for (unsigned int i = 0; i < m_Used; i++)
+            commands += m_Buffers[i].commandCount();
+        return commands;
+    }
+
+    std::size_t bytesUsed() const {
+        std::size_t bytes = 0;
+        for (const LinearAllocator &allocator: m_Allocators)
+            bytes += allocator.bytesUsed();
+        return bytes;
+    }
+
+private:
+    // one per job system thread, indexed by the thread number parallelFor passes
+    std::vector<LinearAllocator> m_Allocators;
+    // kept between frames, only the first m_Used are recorded
+    std::vector<CommandBuffer> m_Buffers;
+    unsigned int m_Used = 0;
+};
+
+#endif //PROJECT_BASE_COMMANDBUFFER_H
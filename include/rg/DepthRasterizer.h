@@ -0,0 +1,331 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_DEPTHRASTERIZER_H
+#define PROJECT_BASE_DEPTHRASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <rg/JobSystem.h>
+#include <rg/OccluderMesh.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RG_RASTER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RG_RASTER_SSE2
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Depth-only software rasterizer for occlusion culling without the GPU (HiZBuffer source, visibility baking).
+// Writes the nearest window-space depth ([0, 1], cleared to 1) at pixel centers of a small buffer.
+// render() runs in two parallel phases over a JobSystem: batches of triangles are transformed, clipped
+// against the near plane, set up and binned to screen tiles; then every tile rasterizes its bins in
+// submission order, 8 (AVX2) or 4 (SSE2) pixels at a time. Tiles never share pixels, so no locking.
+// Rows are padded to whole tiles: depth() has stride() floats per row, the padding is never meaningful.
+class DepthRasterizer {
+public:
+    static const int TILE_WIDTH = 32;
+    static const int TILE_HEIGHT = 16;
+    // triangles per setup job; bins store 16 bit indices and clipping makes at most two triangles of one
+    static const unsigned int SETUP_BATCH = 4096;
+
+    void resize(int width, int height) {
+        m_Width = width;
+        m_Height = height;
+        m_Stride = (width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH;
+        m_TilesX = m_Stride / TILE_WIDTH;
+        m_TilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        m_Depth.assign(m_Stride * height, 1.0f);
+        for (Batch &batch: m_Batches)
+            batch.bins.assign(m_TilesX * m_TilesY, std::vector<unsigned short>());
+    }
+
+    void clear() {
+        std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+        m_Draws.clear();
+        m_Triangles = 0;
+        m_Submitted = 0;
+    }
+
+    // the mesh must stay alive until render() returns
+    void addOccluder(const OccluderMesh &mesh, const glm::mat4 &viewProjection) {
+        if (mesh.triangleCount() > 0)
+            m_Draws.push_back(Draw{&mesh, viewProjection});
+    }
+
+    // rasterizes everything added since clear(); without jobs everything runs on the calling thread
+    void render(JobSystem *jobs = nullptr) {
+        unsigned int batchCount = 0;
+        for (unsigned int d = 0; d < m_Draws.size(); d++) {
+            unsigned int triangles = m_Draws[d].mesh->triangleCount();
+            m_Submitted += triangles;
+            for (unsigned int first = 0; first < triangles; first += SETUP_BATCH) {
+                if (batchCount == m_Batches.size()) {
+                    m_Batches.emplace_back();
+                    m_Batches.back().bins.assign(m_TilesX * m_TilesY, std::vector<unsigned short>());
+                }
+                Batch &batch = m_Batches[batchCount++];
+                batch.draw = d;
+                batch.first = first;
+                batch.count = std::min(SETUP_BATCH, triangles - first);
+            }
+        }
+        if (batchCount == 0)
+            return;
+        unsigned int tileCount = m_TilesX * m_TilesY;
+        if (jobs) {
+            jobs->parallelFor(batchCount, [this](unsigned int index, unsigned int) { setupBatch(m_Batches[index]); });
+            jobs->parallelFor(tileCount, [this, batchCount](unsigned int tile, unsigned int) { rasterizeTile(tile, batchCount); });
+        } else {
+            for (unsigned int i = 0; i < batchCount; i++)
+                setupBatch(m_Batches[i]);
+            for (unsigned int tile = 0; tile < tileCount; tile++)
+                rasterizeTile(tile, batchCount);
+        }
+        for (unsigned int i = 0; i < batchCount; i++)
+            m_Triangles += m_Batches[i].triangles.size();
+    }
+
+    const float *depth() const { return m_Depth.data(); }
+
+    int width() const { return m_Width; }
+
+    int height() const { return m_Height; }
+
+    int stride() const { return m_Stride; }
+
+    // triangles given to render() since clear()
+    unsigned int submittedTriangles() const { return m_Submitted; }
+
+    // triangles left after frustum rejection and near clipping, i.e. actually rasterized
+    unsigned int triangleCount() const { return m_Triangles; }
+
+    static const char *instructionSet() {
+#if defined(RG_RASTER_AVX2)
+        return "AVX2";
+#elif defined(RG_RASTER_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    struct Draw {
+        const OccluderMesh *mesh;
+        glm::mat4 viewProjection;
+    };
+
+    // edge functions e = A * x + B * y + C (inside when all three are >= 0) and the depth plane, in pixels
+    struct Triangle {
+        float edge[3][3];
+        float z[3];
+        int minX, minY, maxX, maxY;
+    };
+
+    struct Batch {
+        unsigned int draw = 0;
+        unsigned int first = 0;
+        unsigned int count = 0;
+        std::vector<Triangle> triangles;
+        // per tile, indices into triangles
+        std::vector<std::vector<unsigned short>> bins;
+    };
+
+    void setupBatch(Batch &batch) {
+        batch.triangles.clear();
+        for (std::vector<unsigned short> &bin: batch.bins)
+            bin.clear();
+        const Draw &draw = m_Draws[batch.draw];
+        const std::vector<glm::vec3> &positions = draw.mesh->positions;
+        const std::vector<unsigned int> &indices = draw.mesh->indices;
+        for (unsigned int t = batch.first; t < batch.first + batch.count; t++) {
+            glm::vec4 clip[3];
+            for (int k = 0; k < 3; k++)
+                clip[k] = draw.viewProjection * glm::vec4(positions[indices[3 * t + k]], 1.0f);
+            clipTriangle(batch, clip);
+        }
+    }
+
+    // trivial frustum rejection, then Sutherland-Hodgman against the near plane (z >= -w)
+    void clipTriangle(Batch &batch, const glm::vec4 *clip) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w)
+                return;
+            if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)
+                return;
+        }
+        float distance[3];
+        int inside = 0;
+        for (int k = 0; k < 3; k++) {
+            distance[k] = clip[k].z + clip[k].w;
+            inside += distance[k] >= 0.0f;
+        }
+        if (inside == 3) {
+            emitTriangle(batch, project(clip[0]), project(clip[1]), project(clip[2]));
+            return;
+        }
+        glm::vec3 polygon[4];
+        int count = 0;
+        for (int k = 0; k < 3; k++) {
+            int next = (k + 1) % 3;
+            if (distance[k] >= 0.0f)
+                polygon[count++] = project(clip[k]);
+            if ((distance[k] >= 0.0f) != (distance[next] >= 0.0f)) {
+                float t = distance[k] / (distance[k] - distance[next]);
+                polygon[count++] = project(clip[k] + (clip[next] - clip[k]) * t);
+            }
+        }
+        for (int k = 1; k + 1 < count; k++)
+            emitTriangle(batch, polygon[0], polygon[k], polygon[k + 1]);
+    }
+
+    glm::vec3 project(const glm::vec4 &clip) const {
+        float w = std::max(clip.w, 1e-6f);
+        return glm::vec3((clip.x / w * 0.5f + 0.5f) * m_Width, (clip.y / w * 0.5f + 0.5f) * m_Height,
+                         clip.z / w * 0.5f + 0.5f);
+    }
+
+    void emitTriangle(Batch &batch, glm::vec3 a, glm::vec3 b, const glm::vec3 &c) {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::fabs(area) < 1e-8f)
+            return;
+        if (area < 0.0f) {
+            // both windings are occluders, make it counter-clockwise
+            std::swap(a, b);
+            area = -area;
+        }
+        Triangle triangle;
+        triangle.minX = std::max(0, (int) std::floor(std::min(a.x, std::min(b.x, c.x))));
+        triangle.maxX = std::min(m_Width - 1, (int) std::ceil(std::max(a.x, std::max(b.x, c.x))));
+        triangle.minY = std::max(0, (int) std::floor(std::min(a.y, std::min(b.y, c.y))));
+        triangle.maxY = std::min(m_Height - 1, (int) std::ceil(std::max(a.y, std::max(b.y, c.y))));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+        const glm::vec3 *vertices[3] = {&a, &b, &c};
+        for (int k = 0; k < 3; k++) {
+            // edge k is opposite vertex k; its function is the barycentric weight of vertex k times area
+            const glm::vec3 &p = *vertices[(k + 1) % 3];
+            const glm::vec3 &q = *vertices[(k + 2) % 3];
+            triangle.edge[k][0] = p.y - q.y;
+            triangle.edge[k][1] = q.x - p.x;
+            triangle.edge[k][2] = p.x * q.y - q.x * p.y;
+        }
+        // window depth is linear in screen space
+        for (int i = 0; i < 3; i++)
+            triangle.z[i] = (triangle.edge[0][i] * a.z + triangle.edge[1][i] * b.z + triangle.edge[2][i] * c.z) / area;
+        unsigned short index = batch.triangles.size();
+        batch.triangles.push_back(triangle);
+        for (int ty = triangle.minY / TILE_HEIGHT; ty <= triangle.maxY / TILE_HEIGHT; ty++) {
+            for (int tx = triangle.minX / TILE_WIDTH; tx <= triangle.maxX / TILE_WIDTH; tx++)
+                batch.bins[ty * m_TilesX + tx].push_back(index);
+        }
+    }
+
+    void rasterizeTile(unsigned int tile, unsigned int batchCount) {
+        int tileX0 = (tile % m_TilesX) * TILE_WIDTH;
+        int tileY0 = (tile / m_TilesX) * TILE_HEIGHT;
+        int tileX1 = tileX0 + TILE_WIDTH - 1;
+        int tileY1 = std::min(tileY0 + TILE_HEIGHT, m_Height) - 1;
+        for (unsigned int b = 0; b < batchCount; b++) {
+            const Batch &batch = m_Batches[b];
+            for (unsigned short index: batch.bins[tile]) {
+                const Triangle &triangle = batch.triangles[index];
+                rasterizeTriangle(triangle, std::max(triangle.minX, tileX0), std::min(triangle.maxX, tileX1),
+                                  std::max(triangle.minY, tileY0), std::min(triangle.maxY, tileY1));
+            }
+        }
+    }
+
+    // pixels outside the triangle's box are outside the triangle too, so whole SIMD groups can be tested;
+    // groups never leave the tile because TILE_WIDTH is a multiple of the lane count
+    void rasterizeTriangle(const Triangle &t, int x0, int x1, int y0, int y1) {
+#if defined(RG_RASTER_AVX2)
+        const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 a0 = _mm256_set1_ps(t.edge[0][0]), a1 = _mm256_set1_ps(t.edge[1][0]), a2 = _mm256_set1_ps(t.edge[2][0]);
+        __m256 az = _mm256_set1_ps(t.z[0]);
+        x0 &= ~7;
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            __m256 row0 = _mm256_set1_ps(t.edge[0][1] * py + t.edge[0][2]);
+            __m256 row1 = _mm256_set1_ps(t.edge[1][1] * py + t.edge[1][2]);
+            __m256 row2 = _mm256_set1_ps(t.edge[2][1] * py + t.edge[2][2]);
+            __m256 rowZ = _mm256_set1_ps(t.z[1] * py + t.z[2]);
+            float *line = &m_Depth[y * m_Stride];
+            for (int x = x0; x <= x1; x += 8) {
+                __m256 px = _mm256_add_ps(_mm256_set1_ps((float) x), offsets);
+                __m256 w0 = _mm256_add_ps(_mm256_mul_ps(a0, px), row0);
+                __m256 w1 = _mm256_add_ps(_mm256_mul_ps(a1, px), row1);
+                __m256 w2 = _mm256_add_ps(_mm256_mul_ps(a2, px), row2);
+                __m256 inside = _mm256_cmp_ps(_mm256_min_ps(w0, _mm256_min_ps(w1, w2)), zero, _CMP_GE_OQ);
+                if (_mm256_movemask_ps(inside) == 0)
+                    continue;
+                __m256 z = _mm256_add_ps(_mm256_mul_ps(az, px), rowZ);
+                __m256 stored = _mm256_loadu_ps(line + x);
+                _mm256_storeu_ps(line + x, _mm256_blendv_ps(stored, _mm256_min_ps(stored, z), inside));
+            }
+        }
+#elif defined(RG_RASTER_SSE2)
+        const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 a0 = _mm_set1_ps(t.edge[0][0]), a1 = _mm_set1_ps(t.edge[1][0]), a2 = _mm_set1_ps(t.edge[2][0]);
+        __m128 az = _mm_set1_ps(t.z[0]);
+        x0 &= ~3;
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            __m128 row0 = _mm_set1_ps(t.edge[0][1] * py + t.edge[0][2]);
+            __m128 row1 = _mm_set1_ps(t.edge[1][1] * py + t.edge[1][2]);
+            __m128 row2 = _mm_set1_ps(t.edge[2][1] * py + t.edge[2][2]);
+            __m128 rowZ = _mm_set1_ps(t.z[1] * py + t.z[2]);
+            float *line = &m_Depth[y * m_Stride];
+            for (int x = x0; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+                __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+                __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+                __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+                __m128 inside = _mm_cmpge_ps(_mm_min_ps(w0, _mm_min_ps(w1, w2)), zero);
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(az, px), rowZ);
+                __m128 stored = _mm_loadu_ps(line + x);
+                __m128 nearer = _mm_min_ps(stored, z);
+                _mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+            }
+        }
+#else
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            float *line = &m_Depth[y * m_Stride];
+            for (int x = x0; x <= x1; x++) {
+                float px = x + 0.5f;
+                float w0 = t.edge[0][0] * px + t.edge[0][1] * py + t.edge[0][2];
+                float w1 = t.edge[1][0] * px + t.edge[1][1] * py + t.edge[1][2];
+                float w2 = t.edge[2][0] * px + t.edge[2][1] * py + t.edge[2][2];
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                    continue;
+                line[x] = std::min(line[x], t.z[0] * px + t.z[1] * py + t.z[2]);
+            }
+        }
+#endif
+    }
+
+    int m_Width = 0;
+    int m_Height = 0;
+    int m_Stride = 0;
+    int m_TilesX = 0;
+    int m_TilesY = 0;
+    std::vector<float> m_Depth;
+    std::vector<Draw> m_Draws;
+    // reused between frames so a steady scene doesn't allocate
+    std::vector<Batch> m_Batches;
+    unsigned int m_Triangles = 0;
+    unsigned int m_Submitted = 0;
+};
+
+#endif //PROJECT_BASE_DEPTHRASTERIZER_H
@@ -0,0 +1,132 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_DEPTHREADBACK_H
+#define PROJECT_BASE_DEPTHREADBACK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/MemoryTracker.h>
+
+#include <cstring>
+#include <vector>
+
+// Asynchronous read of a small single channel float image (the max-reduced scene depth) back to the CPU.
+// read() queues glReadPixels into a pixel pack buffer and a fence; collect() copies out the newest buffer
+// whose fence has signaled, a frame or two later, so the render loop never waits for the GPU.
+// Each read carries the view-projection the depth was rendered with, the occlusion test needs it.
+class DepthReadback {
+public:
+    static const int BUFFER_COUNT = 3;
+
+    DepthReadback() = default;
+    DepthReadback(const DepthReadback &) = delete;
+    DepthReadback &operator=(const DepthReadback &) = delete;
+
+    ~DepthReadback() {
+        destroy();
+    }
+
+    // reads width x height GL_RED floats from the lower-left corner of the bound read framebuffer
+    void read(int width, int height, const glm::mat4 &viewProjection) {
+        if (width != m_Width || height != m_Height)
+            destroy();
+        if (!m_Created) {
+            glGenBuffers(BUFFER_COUNT, m_Buffers);
+            for (int i = 0; i < BUFFER_COUNT; i++) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, m_Buffers[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, width * height * sizeof(float), NULL, GL_STREAM_READ);
+                MemoryTracker::track(MemoryTracker::BUFFER, m_Buffers[i], width * height * sizeof(float), MEMORY_OCCLUSION,
+                                     "depth readback");
+            }
+            m_Width = width;
+            m_Height = height;
+            m_Created = true;
+        }
+        Slot &slot = m_Slots[m_Current];
+        if (slot.fence != 0) {
+            // the oldest read was never collected, drop it
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_Buffers[m_Current]);
+        glReadPixels(0, 0, width, height, GL_RED, GL_FLOAT, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.viewProjection = viewProjection;
+        slot.sequence = ++m_Sequence;
+        m_Current = (m_Current + 1) % BUFFER_COUNT;
+    }
+
+    // true if a newer image arrived; depth then holds width() x height() values
+    bool collect(std::vector<float> &depth, glm::mat4 &viewProjection) {
+        int newest = -1;
+        for (int i = 0; i < BUFFER_COUNT; i++) {
+            Slot &slot = m_Slots[i];
+            if (slot.fence == 0)
+                continue;
+            if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                continue;
+            if (newest < 0 || slot.sequence > m_Slots[newest].sequence)
+                newest = i;
+        }
+        if (newest < 0)
+            return false;
+        // older finished reads are superseded
+        for (int i = 0; i < BUFFER_COUNT; i++) {
+            Slot &slot = m_Slots[i];
+            if (slot.fence != 0 && slot.sequence <= m_Slots[newest].sequence && i != newest) {
+                glDeleteSync(slot.fence);
+                slot.fence = 0;
+            }
+        }
+        Slot &slot = m_Slots[newest];
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+        depth.resize(m_Width * m_Height);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_Buffers[newest]);
+        void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, depth.size() * sizeof(float), GL_MAP_READ_BIT);
+        if (data)
+            memcpy(depth.data(), data, depth.size() * sizeof(float));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        viewProjection = slot.viewProjection;
+        return data != NULL;
+    }
+
+    int width() const { return m_Width; }
+
+    int height() const { return m_Height; }
+
+    void destroy() {
+        for (Slot &slot: m_Slots) {
+            if (slot.fence != 0)
+                glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+        if (m_Created) {
+            glDeleteBuffers(BUFFER_COUNT, m_Buffers);
+            MemoryTracker::untrack(MemoryTracker::BUFFER, BUFFER_COUNT, m_Buffers);
+        }
+        m_Created = false;
+        m_Width = m_Height = 0;
+    }
+
+private:
+    struct Slot {
+        GLsync fence = 0;
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        unsigned int sequence = 0;
+    };
+
+    unsigned int m_Buffers[BUFFER_COUNT] = {0};
+    Slot m_Slots[BUFFER_COUNT];
+    int m_Current = 0;
+    unsigned int m_Sequence = 0;
+    int m_Width = 0;
+    int m_Height = 0;
+    bool m_Created = false;
+};
+
+#endif //PROJECT_BASE_DEPTHREADBACK_H
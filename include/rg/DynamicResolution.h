@@ -0,0 +1,51 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+
+// Picks a render scale that keeps the measured GPU frame time under a budget.
+// Shading cost is roughly proportional to the pixel count, i.e. to scale^2, so the controller
+// moves the scale towards scale * sqrt(budget / frameTime) and damps the step to avoid oscillation.
+class DynamicResolution {
+public:
+    bool enabled = false;
+    float budgetMs = 16.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // fraction of the budget we aim for, leaves room for the CPU side and measurement noise
+    float headroom = 0.9f;
+    // how far towards the ideal scale a single update moves
+    float gain = 0.15f;
+    // ignore corrections smaller than this so the targets do not shimmer
+    float deadZone = 0.02f;
+
+    // feeds one GPU frame time measurement and returns the scale to render the next frame with
+    float update(float gpuMs, float currentScale) {
+        if (!enabled)
+            return maxScale;
+        if (gpuMs <= 0.0f)
+            return currentScale;
+        m_AverageMs = m_HasAverage ? m_AverageMs * 0.8f + gpuMs * 0.2f : gpuMs;
+        m_HasAverage = true;
+
+        float ideal = currentScale * std::sqrt(budgetMs * headroom / m_AverageMs);
+        ideal = std::min(std::max(ideal, minScale), maxScale);
+        float next = currentScale + (ideal - currentScale) * gain;
+        if (std::fabs(next - currentScale) < deadZone && ideal != maxScale && ideal != minScale)
+            return currentScale;
+        return std::min(std::max(next, minScale), maxScale);
+    }
+
+    float averageMs() const { return m_AverageMs; }
+
+private:
+    float m_AverageMs = 0.0f;
+    bool m_HasAverage = false;
+};
+
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
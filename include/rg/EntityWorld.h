@@ -0,0 +1,294 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_ENTITYWORLD_H
+#define PROJECT_BASE_ENTITYWORLD_H
+
+#include <rg/JobSystem.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Archetype based entity-component storage.
+// Entities with the same set of component types share an archetype, which keeps one tightly packed array
+// per component type; removing an entity moves the last row into the hole. Systems iterate every archetype
+// that has the requested components with each<A, B>(f) or split the rows into chunks over a JobSystem with
+// parallelEach<A, B>(jobs, f). An entity's component set is fixed at create(); creating or destroying
+// entities while iterating is not allowed. Entity handles carry a generation, so stale ones are detected.
+class EntityWorld {
+public:
+    struct Entity {
+        unsigned int index = ~0u;
+        unsigned int generation = 0;
+    };
+
+    static const unsigned int MAX_COMPONENTS = 64;
+
+    EntityWorld() = default;
+    EntityWorld(const EntityWorld &) = delete;
+    EntityWorld &operator=(const EntityWorld &) = delete;
+
+    ~EntityWorld() {
+        for (Archetype &archetype: m_Archetypes) {
+            for (Column &column: archetype.columns) {
+                for (unsigned int row = 0; row < archetype.count; row++)
+                    column.destroy(column.at(row));
+                ::operator delete(column.data);
+            }
+        }
+    }
+
+    template<class... Ts>
+    Entity create(Ts &&... components) {
+        Archetype &archetype = m_Archetypes[findArchetype<typename std::decay<Ts>::type...>()];
+        reserveRows(archetype, archetype.count + 1);
+        unsigned int row = archetype.count++;
+        int constructed[] = {0, (new(archetype.template column<typename std::decay<Ts>::type>().at(row))
+                typename std::decay<Ts>::type(std::forward<Ts>(components)), 0)...};
+        (void) constructed;
+
+        Entity entity;
+        if (!m_Free.empty()) {
+            entity.index = m_Free.back();
+            m_Free.pop_back();
+        } else {
+            entity.index = m_Records.size();
+            m_Records.emplace_back();
+        }
+        Record &record = m_Records[entity.index];
+        record.archetype = &archetype - m_Archetypes.data();
+        record.row = row;
+        entity.generation = record.generation;
+        archetype.entities.push_back(entity.index);
+        m_Alive++;
+        return entity;
+    }
+
+    void destroy(Entity entity) {
+        if (!alive(entity))
+            return;
+        Record &record = m_Records[entity.index];
+        Archetype &archetype = m_Archetypes[record.archetype];
+        unsigned int last = archetype.count - 1;
+        for (Column &column: archetype.columns) {
+            column.destroy(column.at(record.row));
+            if (record.row != last) {
+                column.move(column.at(record.row), column.at(last));
+                column.destroy(column.at(last));
+            }
+        }
+        if (record.row != last) {
+            archetype.entities[record.row] = archetype.entities[last];
+            m_Records[archetype.entities[record.row]].row = record.row;
+        }
+        archetype.entities.pop_back();
+        archetype.count--;
+        record.generation++;
+        record.archetype = ~0u;
+        m_Free.push_back(entity.index);
+        m_Alive--;
+    }
+
+    bool alive(Entity entity) const {
+        return entity.index < m_Records.size() && m_Records[entity.index].generation == entity.generation
+               && m_Records[entity.index].archetype != ~0u;
+    }
+
+    // nullptr if the entity is gone or has no T
+    template<class T>
+    T *get(Entity entity) {
+        if (!alive(entity))
+            return nullptr;
+        const Record &record = m_Records[entity.index];
+        Archetype &archetype = m_Archetypes[record.archetype];
+        if (!(archetype.mask & bit<T>()))
+            return nullptr;
+        return static_cast<T *>(archetype.template column<T>().at(record.row));
+    }
+
+    // f(Ts &...) for every entity that has all of Ts
+    template<class... Ts, class F>
+    void each(F &&f) {
+        std::uint64_t mask = maskOf<Ts...>();
+        for (Archetype &archetype: m_Archetypes) {
+            if ((archetype.mask & mask) == mask && archetype.count > 0)
+                eachRow(f, 0, archetype.count, archetype.template rows<Ts>()...);
+        }
+    }
+
+    // like each(), rows are split into chunks that run on the job system; f must only touch its own entity
+    template<class... Ts, class F>
+    void parallelEach(JobSystem &jobs, F &&f, unsigned int chunkSize = 4096) {
+        std::uint64_t mask = maskOf<Ts...>();
+        m_Chunks.clear();
+        for (unsigned int a = 0; a < m_Archetypes.size(); a++) {
+            const Archetype &archetype = m_Archetypes[a];
+            if ((archetype.mask & mask) != mask)
+                continue;
+            for (unsigned int begin = 0; begin < archetype.count; begin += chunkSize)
+                m_Chunks.push_back(Chunk{a, begin, std::min(archetype.count, begin + chunkSize)});
+        }
+        jobs.parallelFor(m_Chunks.size(), [&](unsigned int index, unsigned int) {
+            const Chunk &chunk = m_Chunks[index];
+            Archetype &archetype = m_Archetypes[chunk.archetype];
+            eachRow(f, chunk.begin, chunk.end, archetype.template rows<Ts>()...);
+        });
+    }
+
+    // entities that have all of Ts
+    template<class... Ts>
+    unsigned int count() const {
+        std::uint64_t mask = maskOf<Ts...>();
+        unsigned int result = 0;
+        for (const Archetype &archetype: m_Archetypes) {
+            if ((archetype.mask & mask) == mask)
+                result += archetype.count;
+        }
+        return result;
+    }
+
+    unsigned int size() const { return m_Alive; }
+
+    unsigned int archetypeCount() const { return m_Archetypes.size(); }
+
+private:
+    // type erased array of one component type
+    struct Column {
+        unsigned int id;
+        std::size_t size;
+        unsigned char *data = nullptr;
+        void (*move)(void *to, void *from);
+        void (*destroy)(void *object);
+
+        void *at(unsigned int row) const { return data + row * size; }
+    };
+
+    struct Archetype {
+        std::uint64_t mask = 0;
+        // sorted by component id
+        std::vector<Column> columns;
+        // entity index of every row
+        std::vector<unsigned int> entities;
+        unsigned int count = 0;
+        unsigned int capacity = 0;
+
+        template<class T>
+        Column &column() {
+            unsigned int id = componentId<T>();
+            for (Column &column: columns) {
+                if (column.id == id)
+                    return column;
+            }
+            assert(false && "component not in archetype");
+            return columns.front();
+        }
+
+        template<class T>
+        T *rows() {
+            return static_cast<T *>(static_cast<void *>(column<T>().data));
+        }
+    };
+
+    struct Record {
+        unsigned int archetype = ~0u;
+        unsigned int row = 0;
+        unsigned int generation = 0;
+    };
+
+    struct Chunk {
+        unsigned int archetype;
+        unsigned int begin;
+        unsigned int end;
+    };
+
+    static unsigned int &componentCounter() {
+        static unsigned int counter = 0;
+        return counter;
+    }
+
+    template<class T>
+    static unsigned int componentId() {
+        static const unsigned int id = componentCounter()++;
+        assert(id < MAX_COMPONENTS);
+        return id;
+    }
+
+    template<class T>
+    static std::uint64_t bit() {
+        return std::uint64_t(1) << componentId<T>();
+    }
+
+    template<class... Ts>
+    static std::uint64_t maskOf() {
+        std::uint64_t mask = 0;
+        std::uint64_t bits[] = {0, bit<Ts>()...};
+        for (std::uint64_t b: bits)
+            mask |= b;
+        return mask;
+    }
+
+    template<class T>
+    static Column makeColumn() {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned components are not supported");
+        Column column;
+        column.id = componentId<T>();
+        column.size = sizeof(T);
+        column.move = [](void *to, void *from) { new(to) T(std::move(*static_cast<T *>(from))); };
+        column.destroy = [](void *object) { static_cast<T *>(object)->~T(); };
+        return column;
+    }
+
+    template<class... Ts>
+    unsigned int findArchetype() {
+        std::uint64_t mask = maskOf<Ts...>();
+        for (unsigned int i = 0; i < m_Archetypes.size(); i++) {
+            if (m_Archetypes[i].mask == mask)
+                return i;
+        }
+        Archetype archetype;
+        archetype.mask = mask;
+        archetype.columns = {makeColumn<Ts>()...};
+        std::sort(archetype.columns.begin(), archetype.columns.end(),
+                  [](const Column &a, const Column &b) { return a.id < b.id; });
+        m_Archetypes.push_back(std::move(archetype));
+        return m_Archetypes.size() - 1;
+    }
+
+    static void reserveRows(Archetype &archetype, unsigned int rows) {
+        if (rows <= archetype.capacity)
+            return;
+        unsigned int capacity = std::max(rows, std::max(64u, archetype.capacity * 2));
+        for (Column &column: archetype.columns) {
+            unsigned char *data = static_cast<unsigned char *>(::operator new(capacity * column.size));
+            for (unsigned int row = 0; row < archetype.count; row++) {
+                column.move(data + row * column.size, column.at(row));
+                column.destroy(column.at(row));
+            }
+            ::operator delete(column.data);
+            column.data = data;
+        }
+        archetype.entities.reserve(capacity);
+        archetype.capacity = capacity;
+    }
+
+    template<class F, class... Ts>
+    static void eachRow(F &f, unsigned int begin, unsigned int end, Ts *... columns) {
+        for (unsigned int row = begin; row < end; row++)
+            f(columns[row]...);
+    }
+
+    std::vector<Archetype> m_Archetypes;
+    std::vector<Record> m_Records;
+    std::vector<unsigned int> m_Free;
+    std::vector<Chunk> m_Chunks;
+    unsigned int m_Alive = 0;
+};
+
+#endif //PROJECT_BASE_ENTITYWORLD_H
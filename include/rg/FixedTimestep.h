@@ -0,0 +1,117 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_FIXEDTIMESTEP_H
+#define PROJECT_BASE_FIXEDTIMESTEP_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Turns variable frame times into a whole number of fixed simulation steps.
+// advance() accumulates real time and returns how many steps to run; the leftover fraction of a step is
+// alpha(), used to interpolate between the last two simulated states when rendering. The simulation only
+// ever sees step(), and its time is tick() * step(), so the same inputs per tick give the same results
+// whatever the frame rate. After a long stall at most maxSteps are run and the rest of the backlog dropped,
+// so a slow frame can't snowball into ever more simulation work.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double step = 1.0 / 60.0, unsigned int maxSteps = 8)
+            : m_Step(step), m_MaxSteps(maxSteps) {}
+
+    unsigned int advance(double frameSeconds) {
+        m_Accumulator += std::max(frameSeconds, 0.0);
+        unsigned int steps = (unsigned int) (m_Accumulator / m_Step);
+        if (steps > m_MaxSteps) {
+            steps = m_MaxSteps;
+            m_Accumulator = 0.0;
+        } else {
+            m_Accumulator -= steps * m_Step;
+        }
+        m_Tick += steps;
+        return steps;
+    }
+
+    // 0..1, how far real time is past the last simulated step
+    float alpha() const { return (float) (m_Accumulator / m_Step); }
+
+    double step() const { return m_Step; }
+
+    // simulated steps so far, including the ones returned by the last advance()
+    std::uint64_t tick() const { return m_Tick; }
+
+    double time() const { return m_Tick * m_Step; }
+
+private:
+    double m_Step;
+    unsigned int m_MaxSteps;
+    double m_Accumulator = 0.0;
+    std::uint64_t m_Tick = 0;
+};
+
+// One persistent thread that runs a single task at a time: run() hands it work and returns immediately,
+// wait() blocks until that work is done. Used to simulate the next frame while this one is being rendered.
+class SimulationThread {
+public:
+    SimulationThread() : m_Thread([this]() { loop(); }) {}
+
+    SimulationThread(const SimulationThread &) = delete;
+    SimulationThread &operator=(const SimulationThread &) = delete;
+
+    ~SimulationThread() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_one();
+        m_Thread.join();
+    }
+
+    // the previous task must have been waited for; capture a single reference, a bigger task no longer fits
+    // into std::function's own storage and costs a heap allocation every frame
+    void run(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Task = std::move(task);
+            m_Busy = true;
+        }
+        m_Wake.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Done.wait(lock, [this]() { return !m_Busy; });
+    }
+
+private:
+    void loop() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true) {
+            m_Wake.wait(lock, [this]() { return m_Stop || m_Busy; });
+            if (m_Stop)
+                return;
+            std::function<void()> task = std::move(m_Task);
+            lock.unlock();
+            task();
+            lock.lock();
+            m_Busy = false;
+            m_Done.notify_all();
+        }
+    }
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::condition_variable m_Done;
+    std::function<void()> m_Task;
+    bool m_Busy = false;
+    bool m_Stop = false;
+    // last, so the other members exist when the thread starts
+    std::thread m_Thread;
+};
+
+#endif //PROJECT_BASE_FIXEDTIMESTEP_H
@@ -0,0 +1,43 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <rg/AABB.h>
+
+// The six clip planes of a view-projection matrix (Gribb/Hartmann), normals pointing inwards.
+// intersects() is conservative: a box that straddles two planes outside a corner still counts as visible.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4 &viewProjection) {
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        planes[0] = row[3] + row[0];
+        planes[1] = row[3] - row[0];
+        planes[2] = row[3] + row[1];
+        planes[3] = row[3] - row[1];
+        planes[4] = row[3] + row[2];
+        planes[5] = row[3] - row[2];
+    }
+
+    bool intersects(const AABB &box) const {
+        for (const glm::vec4 &plane: planes) {
+            // the corner furthest along the plane normal
+            glm::vec3 positive(plane.x >= 0.0f ? box.max.x : box.min.x,
+                               plane.y >= 0.0f ? box.max.y : box.min.y,
+                               plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif //PROJECT_BASE_FRUSTUM_H
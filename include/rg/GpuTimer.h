@@ -0,0 +1,82 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+
+// Measures GPU time between begin() and end() with a pair of GL_TIMESTAMP queries (core since 3.3).
+// Unlike GL_TIME_ELAPSED, timestamps can nest, so per-pass timers may run inside the frame timer.
+// Queries rotate through a small ring so reading a result never stalls on the GPU.
+class GpuTimer {
+public:
+    static const int QUERY_COUNT = 4;
+
+    GpuTimer() = default;
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    ~GpuTimer() {
+        destroy();
+    }
+
+    void destroy() {
+        if (m_Created) {
+            glDeleteQueries(QUERY_COUNT, m_Start);
+            glDeleteQueries(QUERY_COUNT, m_End);
+        }
+        m_Created = false;
+    }
+
+    void begin() {
+        if (!m_Created) {
+            glGenQueries(QUERY_COUNT, m_Start);
+            glGenQueries(QUERY_COUNT, m_End);
+            m_Created = true;
+        }
+        collect();
+        glQueryCounter(m_Start[m_Current], GL_TIMESTAMP);
+    }
+
+    void end() {
+        glQueryCounter(m_End[m_Current], GL_TIMESTAMP);
+        m_Pending[m_Current] = true;
+        m_Current = (m_Current + 1) % QUERY_COUNT;
+    }
+
+    // last resolved time in milliseconds (lags the current frame by a few frames)
+    float lastMs() const { return m_LastMs; }
+
+    bool hasResult() const { return m_HasResult; }
+
+private:
+    void collect() {
+        for (int i = 0; i < QUERY_COUNT; i++) {
+            int index = (m_Current + i) % QUERY_COUNT;
+            if (!m_Pending[index])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(m_End[index], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(m_Start[index], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(m_End[index], GL_QUERY_RESULT, &end);
+            m_LastMs = (end - start) / 1.0e6f;
+            m_Pending[index] = false;
+            m_HasResult = true;
+        }
+    }
+
+    unsigned int m_Start[QUERY_COUNT] = {0};
+    unsigned int m_End[QUERY_COUNT] = {0};
+    bool m_Pending[QUERY_COUNT] = {false};
+    int m_Current = 0;
+    bool m_Created = false;
+    bool m_HasResult = false;
+    float m_LastMs = 0.0f;
+};
+
+#endif //PROJECT_BASE_GPUTIMER_H
@@ -0,0 +1,124 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_HIZBUFFER_H
+#define PROJECT_BASE_HIZBUFFER_H
+
+#include <glm/glm.hpp>
+#include <rg/AABB.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Hierarchical depth buffer on the CPU for occlusion tests.
+// build() takes a low resolution window-space depth image ([0, 1], 1 = far) and builds a pyramid in which
+// every texel holds the farthest depth of the 2x2 texels below it. visible() projects a box with the
+// view-projection the depth was rendered with and compares its nearest depth against the farthest depth
+// of the few texels its screen rectangle covers on the level where it spans at most 2x2 texels.
+// The source can be the GPU depth of an earlier frame (DepthReadback) or a CPU raster of occluders (DepthRasterizer).
+class HiZBuffer {
+public:
+    // stride = floats per source row, 0 when rows are packed
+    void build(const float *depth, int width, int height, const glm::mat4 &viewProjection, int stride = 0) {
+        m_ViewProjection = viewProjection;
+        // the levels of the previous build are reused, at the same size this allocates nothing
+        unsigned int levelCount = 1;
+        for (int w = width, h = height; w > 1 || h > 1; levelCount++) {
+            w = std::max(1, (w + 1) / 2);
+            h = std::max(1, (h + 1) / 2);
+        }
+        m_Levels.resize(levelCount);
+        m_Levels[0].width = width;
+        m_Levels[0].height = height;
+        m_Levels[0].depth.resize(width * height);
+        for (int y = 0; y < height; y++) {
+            const float *row = depth + y * (stride > 0 ? stride : width);
+            std::copy(row, row + width, m_Levels[0].depth.begin() + y * width);
+        }
+        for (unsigned int l = 1; l < levelCount; l++) {
+            const Level &below = m_Levels[l - 1];
+            Level &level = m_Levels[l];
+            level.width = std::max(1, (below.width + 1) / 2);
+            level.height = std::max(1, (below.height + 1) / 2);
+            level.depth.resize(level.width * level.height);
+            for (int y = 0; y < level.height; y++) {
+                int y0 = std::min(2 * y, below.height - 1), y1 = std::min(2 * y + 1, below.height - 1);
+                for (int x = 0; x < level.width; x++) {
+                    int x0 = std::min(2 * x, below.width - 1), x1 = std::min(2 * x + 1, below.width - 1);
+                    level.depth[y * level.width + x] = std::max(std::max(below.at(x0, y0), below.at(x1, y0)),
+                                                                std::max(below.at(x0, y1), below.at(x1, y1)));
+                }
+            }
+        }
+    }
+
+    bool valid() const { return !m_Levels.empty(); }
+
+    void invalidate() { m_Levels.clear(); }
+
+    int width() const { return m_Levels.empty() ? 0 : m_Levels[0].width; }
+
+    int height() const { return m_Levels.empty() ? 0 : m_Levels[0].height; }
+
+    unsigned int levelCount() const { return m_Levels.size(); }
+
+    // conservative: anything the pyramid can't decide (crosses the near plane, off screen, no data) is visible
+    bool visible(const AABB &box) const {
+        if (m_Levels.empty() || box.empty())
+            return true;
+        glm::vec2 ndcMin(1e30f), ndcMax(-1e30f);
+        float nearest = 1.0f;
+        for (int i = 0; i < 8; i++) {
+            glm::vec4 clip = m_ViewProjection * glm::vec4(box.corner(i), 1.0f);
+            if (clip.w <= 1e-5f)
+                return true;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+            ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+            nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+            return true; // outside the view the depth was taken from, nothing to compare against
+        const Level &base = m_Levels[0];
+        int x0 = clampi((int) std::floor((ndcMin.x * 0.5f + 0.5f) * base.width), 0, base.width - 1);
+        int x1 = clampi((int) std::floor((ndcMax.x * 0.5f + 0.5f) * base.width), 0, base.width - 1);
+        int y0 = clampi((int) std::floor((ndcMin.y * 0.5f + 0.5f) * base.height), 0, base.height - 1);
+        int y1 = clampi((int) std::floor((ndcMax.y * 0.5f + 0.5f) * base.height), 0, base.height - 1);
+
+        // the level on which the rectangle covers at most 2x2 texels
+        int extent = std::max(x1 - x0, y1 - y0) + 1;
+        int levelIndex = std::min((int) m_Levels.size() - 1, (int) std::ceil(std::log2((float) extent)) - 1);
+        levelIndex = std::max(levelIndex, 0);
+        const Level &level = m_Levels[levelIndex];
+        x0 >>= levelIndex;
+        x1 >>= levelIndex;
+        y0 >>= levelIndex;
+        y1 >>= levelIndex;
+        float farthest = 0.0f;
+        for (int y = y0; y <= std::min(y1, level.height - 1); y++) {
+            for (int x = x0; x <= std::min(x1, level.width - 1); x++)
+                farthest = std::max(farthest, level.at(x, y));
+        }
+        return nearest <= farthest;
+    }
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        std::vector<float> depth;
+
+        float at(int x, int y) const { return depth[y * width + x]; }
+    };
+
+    static int clampi(int value, int low, int high) {
+        return std::max(low, std::min(value, high));
+    }
+
+    std::vector<Level> m_Levels;
+    glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+};
+
+#endif //PROJECT_BASE_HIZBUFFER_H
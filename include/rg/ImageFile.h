@@ -0,0 +1,105 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_IMAGEFILE_H
+#define PROJECT_BASE_IMAGEFILE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 8-bit RGB image, rows top to bottom, stored as binary PPM (P6): reference renders, GL frame captures and
+// the difference between the two. PPM needs no library and every image viewer opens it.
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        pixels.assign((std::size_t) w * h * 3, 0);
+    }
+
+    unsigned char *pixel(int x, int y) { return &pixels[((std::size_t) y * width + x) * 3]; }
+
+    const unsigned char *pixel(int x, int y) const { return &pixels[((std::size_t) y * width + x) * 3]; }
+
+    bool savePpm(const std::string &path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "P6\n" << width << ' ' << height << "\n255\n";
+        out.write((const char *) pixels.data(), pixels.size());
+        return (bool) out;
+    }
+
+    bool loadPpm(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        std::string magic;
+        int maxValue = 0;
+        if (!(in >> magic) || magic != "P6" || !readNumber(in, width) || !readNumber(in, height)
+            || !readNumber(in, maxValue) || maxValue != 255 || width <= 0 || height <= 0)
+            return false;
+        // exactly one whitespace character separates the header from the data
+        in.get();
+        pixels.resize((std::size_t) width * height * 3);
+        return (bool) in.read((char *) pixels.data(), pixels.size());
+    }
+
+    struct Difference {
+        // over all channels, in 0..255 units
+        double rmse = 0.0;
+        double psnr = 0.0;
+        int maxError = 0;
+        // pixels where some channel differs by more than the threshold
+        unsigned int differingPixels = 0;
+    };
+
+    // per-pixel comparison of two images of the same size; diff (if given) gets the largest channel error of
+    // every pixel, scaled by 4, red where it is over the threshold
+    static bool compare(const Image &a, const Image &b, Difference &result, Image *diff = nullptr, int threshold = 8) {
+        if (a.width != b.width || a.height != b.height || a.pixels.size() != b.pixels.size())
+            return false;
+        if (diff)
+            diff->resize(a.width, a.height);
+        double squared = 0.0;
+        result = Difference();
+        for (std::size_t i = 0; i < a.pixels.size(); i += 3) {
+            int largest = 0;
+            for (int c = 0; c < 3; c++) {
+                int error = std::abs((int) a.pixels[i + c] - (int) b.pixels[i + c]);
+                squared += (double) error * error;
+                largest = std::max(largest, error);
+            }
+            result.maxError = std::max(result.maxError, largest);
+            bool differs = largest > threshold;
+            result.differingPixels += differs;
+            if (diff) {
+                unsigned char shade = (unsigned char) std::min(255, largest * 4);
+                diff->pixels[i] = differs ? 255 : shade;
+                diff->pixels[i + 1] = differs ? 0 : shade;
+                diff->pixels[i + 2] = differs ? 0 : shade;
+            }
+        }
+        result.rmse = a.pixels.empty() ? 0.0 : std::sqrt(squared / a.pixels.size());
+        result.psnr = result.rmse > 0.0 ? 20.0 * std::log10(255.0 / result.rmse) : INFINITY;
+        return true;
+    }
+
+private:
+    // a header number, skipping # comments
+    static bool readNumber(std::ifstream &in, int &value) {
+        in >> std::ws;
+        while (in.peek() == '#') {
+            std::string comment;
+            std::getline(in, comment);
+            in >> std::ws;
+        }
+        return (bool) (in >> value);
+    }
+};
+
+#endif //PROJECT_BASE_IMAGEFILE_H
@@ -0,0 +1,134 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_JOBSYSTEM_H
+#define PROJECT_BASE_JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for data-parallel CPU work (occluder raster, ...).
+// parallelFor() hands out indices through an atomic counter, so uneven items balance themselves, and the
+// calling thread takes items too. It returns when every item is done and every worker is idle again.
+// Jobs are thread index aware (0 = caller, 1.. = workers) for per-thread scratch data. Calls don't nest.
+// The job is referenced, not copied (no std::function), so a parallelFor() never touches the heap.
+class JobSystem {
+public:
+    explicit JobSystem(unsigned int workerCount = defaultWorkerCount()) {
+        for (unsigned int i = 0; i < workerCount; i++)
+            m_Workers.emplace_back(&JobSystem::work, this, i + 1);
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_all();
+        for (std::thread &worker: m_Workers)
+            worker.join();
+    }
+
+    // one thread less than the hardware has, the caller is the last one
+    static unsigned int defaultWorkerCount() {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        return hardware > 1 ? hardware - 1 : 0;
+    }
+
+    unsigned int threadCount() const { return m_Workers.size() + 1; }
+
+    template<typename Job>
+    void parallelFor(unsigned int count, const Job &job) {
+        if (count == 0)
+            return;
+        if (m_Workers.empty() || count == 1) {
+            for (unsigned int i = 0; i < count; i++)
+                job(i, 0u);
+            return;
+        }
+        JobRef ref{&job, &invoke<Job>};
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Job = ref;
+            m_Count = count;
+            m_Next = 0;
+            m_Finished = 0;
+            m_Generation++;
+        }
+        m_Wake.notify_all();
+        runItems(ref, count, 0);
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Done.wait(lock, [this]() { return m_Finished == m_Count && m_Active == 0; });
+        m_Job = JobRef();
+    }
+
+private:
+    // non-owning callable: the job lives on the caller's stack for the whole parallelFor()
+    struct JobRef {
+        const void *object = nullptr;
+        void (*call)(const void *object, unsigned int index, unsigned int thread) = nullptr;
+
+        void operator()(unsigned int index, unsigned int thread) const { call(object, index, thread); }
+    };
+
+    template<typename Job>
+    static void invoke(const void *object, unsigned int index, unsigned int thread) {
+        (*static_cast<const Job *>(object))(index, thread);
+    }
+
+    void work(unsigned int thread) {
+        unsigned int seen = 0;
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true) {
+            m_Wake.wait(lock, [&]() { return m_Stop || (m_Generation != seen && m_Job.object != nullptr); });
+            if (m_Stop)
+                return;
+            seen = m_Generation;
+            JobRef job = m_Job;
+            unsigned int count = m_Count;
+            m_Active++;
+            lock.unlock();
+            runItems(job, count, thread);
+            lock.lock();
+            m_Active--;
+            if (m_Finished == m_Count && m_Active == 0)
+                m_Done.notify_all();
+        }
+    }
+
+    void runItems(JobRef job, unsigned int count, unsigned int thread) {
+        unsigned int done = 0;
+        for (unsigned int i = m_Next++; i < count; i = m_Next++) {
+            job(i, thread);
+            done++;
+        }
+        if (done == 0)
+            return;
+        if (m_Finished.fetch_add(done) + done == count) {
+            // the waiting caller checks under the mutex
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::condition_variable m_Done;
+    JobRef m_Job;
+    unsigned int m_Count = 0;
+    std::atomic<unsigned int> m_Next{0};
+    std::atomic<unsigned int> m_Finished{0};
+    unsigned int m_Active = 0;
+    unsigned int m_Generation = 0;
+    bool m_Stop = false;
+};
+
+#endif //PROJECT_BASE_JOBSYSTEM_H
@@ -0,0 +1,117 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_LINEARALLOCATOR_H
+#define PROJECT_BASE_LINEARALLOCATOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+
+// Bump allocator over a list of blocks. allocate() only moves an offset; reset() makes all of it free
+// again without returning memory to the system, so after the first frames recording allocates nothing.
+class LinearAllocator {
+public:
+    explicit LinearAllocator(std::size_t blockSize = 64 * 1024) : m_BlockSize(blockSize) {}
+
+    LinearAllocator(const LinearAllocator &) = delete;
+    LinearAllocator &operator=(const LinearAllocator &) = delete;
+    LinearAllocator(LinearAllocator &&) = default;
+
+    ~LinearAllocator() {
+        for (Block &block: m_Blocks)
+            std::free(block.data);
+    }
+
+    void *allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+        while (m_Current < m_Blocks.size()) {
+            Block &block = m_Blocks[m_Current];
+            std::size_t offset = (m_Offset + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= block.size) {
+                m_Offset = offset + size;
+                m_Used += size;
+                return block.data + offset;
+            }
+            m_Current++;
+            m_Offset = 0;
+        }
+        Block block;
+        block.size = std::max(m_BlockSize, size);
+        block.data = static_cast<unsigned char *>(std::malloc(block.size));
+        m_Blocks.push_back(block);
+        m_Current = m_Blocks.size() - 1;
+        m_Offset = size;
+        m_Used += size;
+        return block.data;
+    }
+
+    void reset() {
+        m_HighWater = std::max(m_HighWater, m_Used);
+        m_Current = 0;
+        m_Offset = 0;
+        m_Used = 0;
+    }
+
+    std::size_t bytesUsed() const { return m_Used; }
+
+    // most bytes ever in use between two resets
+    std::size_t highWater() const { return std::max(m_HighWater, m_Used); }
+
+    std::size_t bytesReserved() const {
+        std::size_t total = 0;
+        for (const Block &block: m_Blocks)
+            total += block.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        unsigned char *data;
+        std::size_t size;
+    };
+
+    std::vector<Block> m_Blocks;
+    std::size_t m_BlockSize;
+    std::size_t m_Current = 0;
+    std::size_t m_Offset = 0;
+    std::size_t m_Used = 0;
+    std::size_t m_HighWater = 0;
+};
+
+// STL allocator on top of a LinearAllocator. deallocate() does nothing, the memory comes back with the
+// arena's reset(), so containers using it must not outlive that reset. Reserve up front: a growing vector
+// leaves its old buffers behind in the arena until then.
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(LinearAllocator &arena) : m_Arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_Arena(other.arena()) {}
+
+    T *allocate(std::size_t count) {
+        return static_cast<T *>(m_Arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) {}
+
+    LinearAllocator *arena() const { return m_Arena; }
+
+private:
+    LinearAllocator *m_Arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() == b.arena(); }
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() != b.arena(); }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif //PROJECT_BASE_LINEARALLOCATOR_H
@@ -0,0 +1,182 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_MEMORYTRACKER_H
+#define PROJECT_BASE_MEMORYTRACKER_H
+
+#include <glad/glad.h>
+#include <rg/AllocationCounter.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+
+// Registry of the GL objects the program owns, with an estimate of their VRAM and the subsystem they belong to.
+// Whoever creates a buffer, texture, renderbuffer or vertex array reports it with track() right after
+// glGen*/gl*Data and with untrack() next to the glDelete*; tracking an object again replaces its entry, so
+// re-specifying storage just updates the size. Everything still registered at shutdown is a missing glDelete*,
+// reportLeaks() lists those. Registering happens at load and resize time, never per frame.
+class MemoryTracker {
+public:
+    enum Kind : unsigned int {
+        BUFFER,
+        TEXTURE,
+        RENDERBUFFER,
+        VERTEX_ARRAY,
+        KIND_COUNT
+    };
+
+    static const char *kindName(unsigned int kind) {
+        static const char *names[KIND_COUNT] = {"buffer", "texture", "renderbuffer", "vertexArray"};
+        return kind < KIND_COUNT ? names[kind] : "unknown";
+    }
+
+    static void track(Kind kind, unsigned int id, std::size_t bytes, MemorySubsystem subsystem, const std::string &label) {
+        if (id == 0)
+            return;
+        Registry &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        Object &object = registry.objects[Key(kind, id)];
+        object.bytes = bytes;
+        object.subsystem = subsystem;
+        object.label = label;
+    }
+
+    static void untrack(Kind kind, unsigned int id) {
+        Registry &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.objects.erase(Key(kind, id));
+    }
+
+    static void untrack(Kind kind, unsigned int count, const unsigned int *ids) {
+        for (unsigned int i = 0; i < count; i++)
+            untrack(kind, ids[i]);
+    }
+
+    struct Totals {
+        std::uint64_t bytes[MEMORY_SUBSYSTEM_COUNT] = {};
+        unsigned int objects[MEMORY_SUBSYSTEM_COUNT] = {};
+        std::uint64_t totalBytes = 0;
+        unsigned int totalObjects = 0;
+    };
+
+    static Totals totals() {
+        Totals totals;
+        Registry &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto &entry: registry.objects) {
+            const Object &object = entry.second;
+            totals.bytes[object.subsystem] += object.bytes;
+            totals.objects[object.subsystem]++;
+            totals.totalBytes += object.bytes;
+            totals.totalObjects++;
+        }
+        return totals;
+    }
+
+    // CPU (live operator new bytes) and GPU usage per subsystem, plus every tracked GL object
+    static void writeJson(std::ostream &out) {
+        Totals gpu = totals();
+        out << "{\n  \"cpu\": {\"liveBytes\": " << AllocationCounter::liveBytes()
+            << ", \"peakBytes\": " << AllocationCounter::peakBytes() << "},\n";
+        out << "  \"gpu\": {\"bytes\": " << gpu.totalBytes << ", \"objects\": " << gpu.totalObjects << "},\n";
+        out << "  \"subsystems\": [\n";
+        for (unsigned int s = 0; s < MEMORY_SUBSYSTEM_COUNT; s++) {
+            out << "    {\"name\": \"" << MemorySubsystemName(s) << "\", \"cpuBytes\": " << AllocationCounter::liveBytes(s)
+                << ", \"gpuBytes\": " << gpu.bytes[s] << ", \"gpuObjects\": " << gpu.objects[s] << "}"
+                << (s + 1 < MEMORY_SUBSYSTEM_COUNT ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"objects\": [\n";
+        Registry &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        unsigned int written = 0;
+        for (const auto &entry: registry.objects) {
+            const Object &object = entry.second;
+            out << "    {\"kind\": \"" << kindName(entry.first.first) << "\", \"id\": " << entry.first.second
+                << ", \"subsystem\": \"" << MemorySubsystemName(object.subsystem) << "\", \"bytes\": " << object.bytes
+                << ", \"label\": \"";
+            writeEscaped(out, object.label);
+            out << "\"}" << (++written < registry.objects.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+
+    // prints every GL object that is still registered; call after all the cleanup, returns how many there were
+    static unsigned int reportLeaks(std::ostream &out) {
+        Registry &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto &entry: registry.objects) {
+            const Object &object = entry.second;
+            out << "LEAK: " << kindName(entry.first.first) << ' ' << entry.first.second << " ("
+                << MemorySubsystemName(object.subsystem) << ", " << object.label << ", " << object.bytes
+                << " bytes) was never deleted" << std::endl;
+        }
+        return registry.objects.size();
+    }
+
+    // bytes of a texture level chain; unsized formats (GL_RGB, ...) are assumed to be 8 bits per channel
+    static std::size_t textureBytes(GLenum internalFormat, int width, int height, bool mipmaps = false, int faces = 1) {
+        std::size_t level = (std::size_t) width * height * bytesPerTexel(internalFormat);
+        // a full mip chain adds a third
+        std::size_t bytes = mipmaps ? level + level / 3 : level;
+        return bytes * faces;
+    }
+
+    static unsigned int bytesPerTexel(GLenum internalFormat) {
+        switch (internalFormat) {
+            case GL_RED:
+            case GL_R8:
+                return 1;
+            case GL_RG:
+            case GL_R16F:
+            case GL_DEPTH_COMPONENT16:
+                return 2;
+            case GL_RGB:
+            case GL_SRGB:
+                return 3;
+            case GL_RGBA16F:
+            case GL_RGB16F:
+                return 8;
+            case GL_RGBA32F:
+                return 16;
+            case GL_RGB32F:
+                return 12;
+            default:
+                // GL_RGBA, GL_R32F, GL_RG16F, GL_DEPTH_COMPONENT24/32F, GL_DEPTH24_STENCIL8, ...
+                return 4;
+        }
+    }
+
+private:
+    typedef std::pair<unsigned int, unsigned int> Key;
+
+    struct Object {
+        std::size_t bytes = 0;
+        unsigned int subsystem = MEMORY_GENERAL;
+        std::string label;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::map<Key, Object> objects;
+    };
+
+    static Registry &instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    static void writeEscaped(std::ostream &out, const std::string &text) {
+        for (char c: text) {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            out << c;
+        }
+    }
+};
+
+#endif //PROJECT_BASE_MEMORYTRACKER_H
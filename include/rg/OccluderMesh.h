@@ -0,0 +1,192 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_OCCLUDERMESH_H
+#define PROJECT_BASE_OCCLUDERMESH_H
+
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <learnopengl/model.h>
+#include <rg/AABB.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Simplified world-space triangle soup of a model for the software occlusion rasterizer (DepthRasterizer).
+// Positions are welded (the GPU mesh splits vertices along uv and normal seams), degenerate triangles
+// dropped and simplify() keeps only the largest triangles. Everything kept is part of the original surface,
+// so a simplified occluder hides less than the model, never more, and culling stays conservative.
+// fromFile() reads the file itself and makes no GL calls, so it also works without a context, in headless tools
+// like visibility baking; fromModel() takes an already loaded Model.
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    AABB bounds;
+
+    unsigned int triangleCount() const { return indices.size() / 3; }
+
+    // maxTriangles = 0 keeps every triangle
+    static OccluderMesh fromModel(const Model &model, const glm::mat4 &transform, unsigned int maxTriangles = 0) {
+        OccluderMesh occluder;
+        std::vector<glm::vec3> meshPositions;
+        std::vector<glm::mat4> meshTransforms = model.MeshTransforms();
+        for (unsigned int i = 0; i < model.meshes.size(); i++) {
+            const Mesh &mesh = model.meshes[i];
+            // geometry already released from RAM can't occlude
+            if (!mesh.HasCpuPositions())
+                continue;
+            meshPositions.clear();
+            meshPositions.reserve(mesh.vertexCount);
+            for (unsigned int v = 0; v < mesh.vertexCount; v++)
+                meshPositions.push_back(mesh.VertexPosition(v));
+            occluder.append(meshPositions.data(), mesh.indices.data(), mesh.indices.size(), transform * meshTransforms[i]);
+        }
+        occluder.simplify(maxTriangles);
+        return occluder;
+    }
+
+    // same meshes and node transforms as Model, without textures or GL objects
+    static OccluderMesh fromFile(const std::string &path, const glm::mat4 &transform, unsigned int maxTriangles = 0) {
+        OccluderMesh occluder;
+        Assimp::Importer importer;
+        const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cout << "ERROR::OCCLUDER_MESH cannot load " << path << ": " << importer.GetErrorString() << std::endl;
+            return occluder;
+        }
+        std::vector<glm::vec3> meshPositions;
+        std::vector<unsigned int> meshIndices;
+        std::vector<std::pair<const aiNode *, glm::mat4>> nodes(1, std::make_pair(scene->mRootNode, transform));
+        while (!nodes.empty()) {
+            const aiNode *node = nodes.back().first;
+            glm::mat4 nodeTransform = nodes.back().second * ConvertMatrix(node->mTransformation);
+            nodes.pop_back();
+            for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+                const aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+                meshPositions.resize(mesh->mNumVertices);
+                for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+                    meshPositions[v] = glm::vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+                meshIndices.clear();
+                for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+                    if (mesh->mFaces[f].mNumIndices != 3)
+                        continue; // points and lines left by triangulation
+                    meshIndices.insert(meshIndices.end(), mesh->mFaces[f].mIndices, mesh->mFaces[f].mIndices + 3);
+                }
+                occluder.append(meshPositions.data(), meshIndices.data(), meshIndices.size(), nodeTransform);
+            }
+            for (unsigned int i = node->mNumChildren; i-- > 0;)
+                nodes.push_back(std::make_pair(node->mChildren[i], nodeTransform));
+        }
+        occluder.simplify(maxTriangles);
+        return occluder;
+    }
+
+    // adds an indexed triangle list given in model space
+    void append(const glm::vec3 *meshPositions, const unsigned int *meshIndices, unsigned int indexCount,
+                const glm::mat4 &transform) {
+        // the weld map is kept between calls, so each mesh hashes only its own vertices; built again when it
+        // doesn't cover positions (after simplify())
+        if (m_Welded.size() != positions.size()) {
+            m_Welded.clear();
+            for (unsigned int i = 0; i < positions.size(); i++)
+                m_Welded.emplace(PositionKey(positions[i]), i);
+        }
+        std::unordered_map<unsigned int, unsigned int> remap;
+        for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+            unsigned int triangle[3];
+            for (int k = 0; k < 3; k++) {
+                unsigned int source = meshIndices[i + k];
+                auto found = remap.find(source);
+                if (found == remap.end()) {
+                    glm::vec3 position = glm::vec3(transform * glm::vec4(meshPositions[source], 1.0f));
+                    auto inserted = m_Welded.emplace(PositionKey(position), (unsigned int) positions.size());
+                    if (inserted.second) {
+                        positions.push_back(position);
+                        bounds.expand(position);
+                    }
+                    found = remap.emplace(source, inserted.first->second).first;
+                }
+                triangle[k] = found->second;
+            }
+            if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+                continue;
+            if (area(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]) <= 0.0f)
+                continue;
+            indices.insert(indices.end(), triangle, triangle + 3);
+        }
+    }
+
+    // keeps the maxTriangles triangles with the largest area and drops vertices no longer used
+    void simplify(unsigned int maxTriangles) {
+        // the occluder is complete, the weld map would only take memory
+        std::unordered_map<PositionKey, unsigned int, PositionHash>().swap(m_Welded);
+        unsigned int count = triangleCount();
+        if (maxTriangles == 0 || count <= maxTriangles)
+            return;
+        std::vector<std::pair<float, unsigned int>> order(count);
+        for (unsigned int i = 0; i < count; i++)
+            order[i] = std::make_pair(area(positions[indices[3 * i]], positions[indices[3 * i + 1]],
+                                           positions[indices[3 * i + 2]]), i);
+        std::nth_element(order.begin(), order.begin() + maxTriangles, order.end(),
+                         [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) {
+                             return a.first > b.first;
+                         });
+        // original order keeps neighbouring triangles together
+        std::sort(order.begin(), order.begin() + maxTriangles,
+                  [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) {
+                      return a.second < b.second;
+                  });
+        std::vector<unsigned int> remap(positions.size(), ~0u);
+        std::vector<glm::vec3> keptPositions;
+        std::vector<unsigned int> keptIndices;
+        bounds = AABB();
+        for (unsigned int i = 0; i < maxTriangles; i++) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int index = indices[3 * order[i].second + k];
+                if (remap[index] == ~0u) {
+                    remap[index] = keptPositions.size();
+                    keptPositions.push_back(positions[index]);
+                    bounds.expand(positions[index]);
+                }
+                keptIndices.push_back(remap[index]);
+            }
+        }
+        positions.swap(keptPositions);
+        indices.swap(keptIndices);
+    }
+
+private:
+    struct PositionKey {
+        unsigned int bits[3];
+
+        explicit PositionKey(const glm::vec3 &position) {
+            memcpy(bits, &position[0], sizeof(bits));
+        }
+
+        bool operator==(const PositionKey &other) const {
+            return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+        }
+    };
+
+    struct PositionHash {
+        size_t operator()(const PositionKey &key) const {
+            return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+        }
+    };
+
+    static float area(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+        return 0.5f * glm::length(glm::cross(b - a, c - a));
+    }
+
+    // position -> index in positions, shared by the append() calls that build the occluder
+    std::unordered_map<PositionKey, unsigned int, PositionHash> m_Welded;
+};
+
+#endif //PROJECT_BASE_OCCLUDERMESH_H
@@ -0,0 +1,404 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_PATHTRACER_H
+#define PROJECT_BASE_PATHTRACER_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <rg/BVH.h>
+#include <rg/ImageFile.h>
+#include <rg/JobSystem.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// CPU path tracer for reference images of the rasterized scene, and for stills without a GPU.
+// Surfaces are shaded with the Blinn-Phong terms of lights.glsl, from textures read the way GL reads them and
+// the light parameters the shaders get, so with shadows off and no bounces the image matches the GL frame up
+// to sampling, and with them on the difference is what the rasterizer leaves out. The constant ambient terms
+// stand in for indirect light, so they are only added when no bounces are traced.
+// Rays go through a SceneBVH over the meshes' MeshBVHs. The image is cut into tiles that the JobSystem hands
+// out from its shared counter, so threads that finish early keep taking tiles; every pixel seeds its own random
+// sequence, so the image is the same whichever thread rendered which tile.
+class PathTracer {
+public:
+    static const int TILE_SIZE = 16;
+
+    struct DirLight {
+        glm::vec3 direction;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+    };
+
+    struct PointLight {
+        glm::vec3 position;
+        float constant;
+        float linear;
+        float quadratic;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+    };
+
+    struct SpotLight {
+        glm::vec3 position;
+        glm::vec3 direction;
+        float cutOff;
+        float outerCutOff;
+        float constant;
+        float linear;
+        float quadratic;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+    };
+
+    struct Lights {
+        DirLight dir;
+        std::vector<PointLight> points;
+        bool spotEnabled = false;
+        SpotLight spot;
+    };
+
+    struct Settings {
+        int width = 800;
+        int height = 600;
+        unsigned int samples = 16;
+        // diffuse bounces after the first hit; 0 is direct light plus the constant ambient, like the rasterizer
+        unsigned int bounces = 0;
+        bool shadows = true;
+        float shininess = 32.0f;
+        // primary rays that hit nothing see the skybox, or this when there is none
+        glm::vec3 background = glm::vec3(0.0f);
+        std::uint32_t seed = 1;
+    };
+
+    // decoded image, referenced and not copied; components as stb_image returned them
+    struct Texture {
+        const unsigned char *data = nullptr;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+    };
+
+    unsigned int addTexture(const Texture &texture) {
+        m_Textures.push_back(texture);
+        return m_Textures.size() - 1;
+    }
+
+    // faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order, as loadCubemap uploads them
+    void setSkybox(const Texture faces[6]) {
+        std::copy(faces, faces + 6, m_Skybox);
+        m_HasSkybox = true;
+    }
+
+    // the mesh's vertices and indices are read while rendering; texture -1 reads black, like an unbound sampler
+    void addInstance(const MeshBVH &bvh, const Mesh &mesh, const glm::mat4 &transform, int diffuseTexture,
+                     int specularTexture) {
+        Instance instance;
+        instance.mesh = &mesh;
+        instance.transform = transform;
+        // same as mat3(transpose(inverse(model))) in 2.model_lighting.vs
+        instance.normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+        instance.diffuseTexture = diffuseTexture;
+        instance.specularTexture = specularTexture;
+        m_Scene.add(bvh, transform, m_Instances.size());
+        m_Instances.push_back(instance);
+    }
+
+    void build() { m_Scene.build(); }
+
+    // linear radiance, width * height pixels with rows top to bottom; rays through pixel centers of the
+    // camera whose clip space inverseViewProjection undoes, from the near to the far plane
+    void render(JobSystem &jobs, const glm::mat4 &inverseViewProjection, const Lights &lights, const Settings &settings,
+                std::vector<glm::vec3> &image) {
+        image.assign((std::size_t) settings.width * settings.height, glm::vec3(0.0f));
+        int tilesX = (settings.width + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (settings.height + TILE_SIZE - 1) / TILE_SIZE;
+        std::atomic<std::uint64_t> rays(0);
+        jobs.parallelFor(tilesX * tilesY, [&](unsigned int tile, unsigned int) {
+            int x0 = (tile % tilesX) * TILE_SIZE;
+            int y0 = (tile / tilesX) * TILE_SIZE;
+            std::uint64_t tileRays = 0;
+            for (int y = y0; y < std::min(y0 + TILE_SIZE, settings.height); y++) {
+                for (int x = x0; x < std::min(x0 + TILE_SIZE, settings.width); x++) {
+                    Random random(hash((std::uint32_t) (y * settings.width + x) ^ hash(settings.seed)));
+                    glm::vec3 sum(0.0f);
+                    for (unsigned int s = 0; s < settings.samples; s++) {
+                        // jittered inside the pixel; y goes down the image, up in clip space
+                        float px = (x + random.next()) / settings.width * 2.0f - 1.0f;
+                        float py = 1.0f - (y + random.next()) / settings.height * 2.0f;
+                        glm::vec4 nearPoint = inverseViewProjection * glm::vec4(px, py, -1.0f, 1.0f);
+                        glm::vec4 farPoint = inverseViewProjection * glm::vec4(px, py, 1.0f, 1.0f);
+                        glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+                        glm::vec3 toFar = glm::vec3(farPoint) / farPoint.w - origin;
+                        float length = glm::length(toFar);
+                        sum += trace(Ray(origin, toFar / length, length), random, lights, settings, tileRays);
+                    }
+                    image[(std::size_t) y * settings.width + x] = sum / (float) settings.samples;
+                }
+            }
+            rays += tileRays;
+        });
+        m_Rays = rays;
+    }
+
+    // rays traced by the last render(), shadow rays included
+    std::uint64_t rayCount() const { return m_Rays; }
+
+    // the curve bloom_final.fs applies (exposure only with bloom on, gamma 1.3), without the bloom blur itself
+    static void toneMap(const std::vector<glm::vec3> &hdr, int width, int height, bool bloom, float exposure, Image &out) {
+        out.resize(width, height);
+        const float gamma = 1.3f;
+        for (std::size_t i = 0; i < hdr.size(); i++) {
+            glm::vec3 color = glm::max(hdr[i], glm::vec3(0.0f));
+            if (bloom)
+                color = glm::vec3(1.0f) - glm::exp(-color * exposure);
+            for (int c = 0; c < 3; c++) {
+                float value = std::pow(color[c], 1.0f / gamma);
+                out.pixels[i * 3 + c] = (unsigned char) std::min(255.0f, value * 255.0f + 0.5f);
+            }
+        }
+    }
+
+private:
+    struct Instance {
+        const Mesh *mesh = nullptr;
+        glm::mat4 transform;
+        glm::mat3 normalMatrix;
+        int diffuseTexture = -1;
+        int specularTexture = -1;
+    };
+
+    struct Surface {
+        glm::vec3 position;
+        // interpolated vertex normal, what the shaders light with
+        glm::vec3 normal;
+        // of the triangle, facing the side the ray came from; rays leave along it
+        glm::vec3 faceNormal;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+    };
+
+    // pcg32
+    struct Random {
+        std::uint64_t state;
+
+        explicit Random(std::uint32_t seed) : state(seed + 0x853c49e6748fea9bull) { next(); }
+
+        float next() {
+            std::uint64_t old = state;
+            state = old * 6364136223846793005ull + 1442695040888963407ull;
+            std::uint32_t shifted = (std::uint32_t) (((old >> 18u) ^ old) >> 27u);
+            std::uint32_t rotation = (std::uint32_t) (old >> 59u);
+            std::uint32_t value = (shifted >> rotation) | (shifted << ((-rotation) & 31));
+            // 24 bits, so the result stays below 1
+            return (value >> 8) * (1.0f / 16777216.0f);
+        }
+    };
+
+    static std::uint32_t hash(std::uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    glm::vec3 trace(Ray ray, Random &random, const Lights &lights, const Settings &settings, std::uint64_t &rays) const {
+        glm::vec3 radiance(0.0f);
+        glm::vec3 throughput(1.0f);
+        for (unsigned int bounce = 0;; bounce++) {
+            RayHit hit;
+            rays++;
+            if (!m_Scene.intersect(ray, hit)) {
+                if (bounce == 0)
+                    radiance += m_HasSkybox ? skybox(ray.direction) : settings.background;
+                break;
+            }
+            Surface surface = surfaceAt(ray, hit);
+            radiance += throughput * direct(surface, -ray.direction, lights, settings, rays);
+            if (bounce >= settings.bounces)
+                break;
+            throughput *= surface.diffuse;
+            if (std::max(throughput.x, std::max(throughput.y, throughput.z)) < 1e-3f)
+                break;
+            ray = Ray(offset(surface, surface.faceNormal), cosineSample(surface.faceNormal, random));
+        }
+        return radiance;
+    }
+
+    Surface surfaceAt(const Ray &ray, const RayHit &hit) const {
+        const Instance &instance = m_Instances[hit.instance];
+        const Mesh &mesh = *instance.mesh;
+        const Vertex &a = mesh.vertices[mesh.indices[3 * hit.triangle]];
+        const Vertex &b = mesh.vertices[mesh.indices[3 * hit.triangle + 1]];
+        const Vertex &c = mesh.vertices[mesh.indices[3 * hit.triangle + 2]];
+        float w = 1.0f - hit.u - hit.v;
+        Surface surface;
+        surface.position = ray.origin + ray.direction * hit.t;
+        glm::vec3 face = instance.normalMatrix * glm::cross(b.Position - a.Position, c.Position - a.Position);
+        float faceLength = glm::length(face);
+        face = faceLength > 0.0f ? face / faceLength : -ray.direction;
+        surface.faceNormal = glm::dot(face, ray.direction) < 0.0f ? face : -face;
+        glm::vec3 normal = instance.normalMatrix * (a.Normal * w + b.Normal * hit.u + c.Normal * hit.v);
+        float normalLength = glm::length(normal);
+        surface.normal = normalLength > 0.0f ? normal / normalLength : surface.faceNormal;
+        glm::vec2 uv = a.TexCoords * w + b.TexCoords * hit.u + c.TexCoords * hit.v;
+        surface.diffuse = sample(instance.diffuseTexture, uv);
+        surface.specular = sample(instance.specularTexture, uv);
+        return surface;
+    }
+
+    // CalcDirLight, CalcPointLight and CalcSpotLight, with the diffuse and specular parts shadowed
+    glm::vec3 direct(const Surface &surface, const glm::vec3 &view, const Lights &lights, const Settings &settings,
+                     std::uint64_t &rays) const {
+        glm::vec3 viewDir = glm::normalize(view);
+        bool ambient = settings.bounces == 0;
+        glm::vec3 result(0.0f);
+        {
+            const DirLight &light = lights.dir;
+            glm::vec3 lightDir = glm::normalize(-light.direction);
+            glm::vec3 lit = blinnPhong(surface, lightDir, viewDir, light.diffuse, light.specular, settings.shininess);
+            if (ambient)
+                result += light.ambient * surface.diffuse;
+            if (lit != glm::vec3(0.0f) && visible(surface, lightDir, FLT_MAX, settings, rays))
+                result += lit;
+        }
+        for (const PointLight &light: lights.points) {
+            glm::vec3 toLight = light.position - surface.position;
+            float distance = glm::length(toLight);
+            glm::vec3 lightDir = toLight / distance;
+            float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+            glm::vec3 lit = blinnPhong(surface, lightDir, viewDir, light.diffuse, light.specular, settings.shininess);
+            if (ambient)
+                result += light.ambient * surface.diffuse * attenuation;
+            if (lit != glm::vec3(0.0f) && visible(surface, lightDir, distance, settings, rays))
+                result += lit * attenuation;
+        }
+        if (lights.spotEnabled) {
+            const SpotLight &light = lights.spot;
+            glm::vec3 toLight = light.position - surface.position;
+            float distance = glm::length(toLight);
+            glm::vec3 lightDir = toLight / distance;
+            float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+            float theta = glm::dot(lightDir, glm::normalize(-light.direction));
+            float intensity = glm::clamp((theta - light.outerCutOff) / (light.cutOff - light.outerCutOff), 0.0f, 1.0f);
+            glm::vec3 lit = blinnPhong(surface, lightDir, viewDir, light.diffuse, light.specular, settings.shininess);
+            if (ambient)
+                result += light.ambient * surface.diffuse * attenuation * intensity;
+            if (intensity > 0.0f && lit != glm::vec3(0.0f) && visible(surface, lightDir, distance, settings, rays))
+                result += lit * attenuation * intensity;
+        }
+        return result;
+    }
+
+    static glm::vec3 blinnPhong(const Surface &surface, const glm::vec3 &lightDir, const glm::vec3 &viewDir,
+                                const glm::vec3 &diffuse, const glm::vec3 &specular, float shininess) {
+        float diff = std::max(glm::dot(surface.normal, lightDir), 0.0f);
+        glm::vec3 halfwayDir = glm::normalize(lightDir + viewDir);
+        float spec = std::pow(std::max(glm::dot(surface.normal, halfwayDir), 0.0f), shininess);
+        return diffuse * diff * surface.diffuse + specular * spec * surface.specular;
+    }
+
+    // nothing between the surface and a light distance away in lightDir
+    bool visible(const Surface &surface, const glm::vec3 &lightDir, float distance, const Settings &settings,
+                 std::uint64_t &rays) const {
+        if (!settings.shadows)
+            return true;
+        // light behind the triangle: the surface shadows itself
+        glm::vec3 side = glm::dot(surface.faceNormal, lightDir) >= 0.0f ? surface.faceNormal : -surface.faceNormal;
+        glm::vec3 origin = offset(surface, side);
+        rays++;
+        return !m_Scene.occluded(Ray(origin, lightDir, distance == FLT_MAX ? FLT_MAX : distance * 0.999f));
+    }
+
+    // off the surface along the normal, relative to how far from the origin the point is (float precision)
+    static glm::vec3 offset(const Surface &surface, const glm::vec3 &normal) {
+        float scale = std::max(std::max(std::abs(surface.position.x), std::abs(surface.position.y)),
+                               std::max(std::abs(surface.position.z), 1.0f));
+        return surface.position + normal * (scale * 1e-4f);
+    }
+
+    static glm::vec3 cosineSample(const glm::vec3 &normal, Random &random) {
+        float r = std::sqrt(random.next());
+        float phi = 6.28318531f * random.next();
+        glm::vec3 tangent = glm::normalize(glm::cross(std::abs(normal.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f)
+                                                                                : glm::vec3(1.0f, 0.0f, 0.0f), normal));
+        glm::vec3 bitangent = glm::cross(normal, tangent);
+        return glm::normalize(tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi))
+                              + normal * std::sqrt(std::max(0.0f, 1.0f - r * r)));
+    }
+
+    // bilinear with GL_REPEAT; one component reads as red only and four drop alpha, as with GL_RED and GL_RGBA
+    glm::vec3 sample(int texture, const glm::vec2 &uv) const {
+        if (texture < 0 || m_Textures[texture].data == nullptr)
+            return glm::vec3(0.0f);
+        const Texture &t = m_Textures[texture];
+        float x = uv.x * t.width - 0.5f;
+        float y = uv.y * t.height - 0.5f;
+        float fx = std::floor(x), fy = std::floor(y);
+        int x0 = (int) fx, y0 = (int) fy;
+        float ax = x - fx, ay = y - fy;
+        glm::vec3 top = glm::mix(texel(t, x0, y0), texel(t, x0 + 1, y0), ax);
+        glm::vec3 bottom = glm::mix(texel(t, x0, y0 + 1), texel(t, x0 + 1, y0 + 1), ax);
+        return glm::mix(top, bottom, ay);
+    }
+
+    static glm::vec3 texel(const Texture &t, int x, int y) {
+        x = ((x % t.width) + t.width) % t.width;
+        y = ((y % t.height) + t.height) % t.height;
+        const unsigned char *p = t.data + ((std::size_t) y * t.width + x) * t.components;
+        const float scale = 1.0f / 255.0f;
+        if (t.components == 1)
+            return glm::vec3(p[0] * scale, 0.0f, 0.0f);
+        if (t.components == 2)
+            return glm::vec3(p[0] * scale, p[1] * scale, 0.0f);
+        return glm::vec3(p[0], p[1], p[2]) * scale;
+    }
+
+    // cube map face selection of the GL specification (major axis, then s and t on that face), clamped
+    glm::vec3 skybox(const glm::vec3 &direction) const {
+        glm::vec3 a = glm::abs(direction);
+        int face;
+        float sc, tc, ma;
+        if (a.x >= a.y && a.x >= a.z) {
+            face = direction.x > 0.0f ? 0 : 1;
+            sc = direction.x > 0.0f ? -direction.z : direction.z;
+            tc = -direction.y;
+            ma = a.x;
+        } else if (a.y >= a.z) {
+            face = direction.y > 0.0f ? 2 : 3;
+            sc = direction.x;
+            tc = direction.y > 0.0f ? direction.z : -direction.z;
+            ma = a.y;
+        } else {
+            face = direction.z > 0.0f ? 4 : 5;
+            sc = direction.z > 0.0f ? direction.x : -direction.x;
+            tc = -direction.y;
+            ma = a.z;
+        }
+        const Texture &t = m_Skybox[face];
+        if (t.data == nullptr)
+            return glm::vec3(0.0f);
+        int x = std::min(t.width - 1, std::max(0, (int) ((sc / ma + 1.0f) * 0.5f * t.width)));
+        int y = std::min(t.height - 1, std::max(0, (int) ((tc / ma + 1.0f) * 0.5f * t.height)));
+        return texel(t, x, y);
+    }
+
+    std::vector<Instance> m_Instances;
+    std::vector<Texture> m_Textures;
+    Texture m_Skybox[6];
+    bool m_HasSkybox = false;
+    SceneBVH m_Scene;
+    std::uint64_t m_Rays = 0;
+};
+
+#endif //PROJECT_BASE_PATHTRACER_H
@@ -0,0 +1,322 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_POINTSHADOWMAPS_H
+#define PROJECT_BASE_POINTSHADOWMAPS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/Frustum.h>
+#include <rg/MemoryTracker.h>
+#include <rg/ShadowAtlas.h>
+
+#include <algorithm>
+#include <cfloat>
+
+// Omnidirectional shadows of point lights: the six cube faces of every light are 90 degree perspective views,
+// each in its own tile of a 2D depth atlas (ShadowAtlas hands the tiles out), so any number of lights share
+// one texture and one sampler and GL 3.3 needs no cubemap arrays.
+// There are two atlases with the same layout. The static one holds only what never moves and is a cache:
+// a light's faces are rendered again only when the light moved (or its range changed) by more than a
+// tolerance, and at most faceBudget faces per frame, the most out of date light first. The shader uses the
+// position and matrices a light was rendered with, so a light waiting for its turn casts slightly old but
+// consistent shadows. The final atlas, the one that is sampled, is a copy of the static tiles (a depth blit)
+// with the dynamic casters drawn over them every frame; without dynamic casters only refreshed lights are copied.
+class PointShadowMaps {
+public:
+    static const int MAX_LIGHTS = 8;
+    static const int FACES = 6;
+    static const int MIN_TILE_SIZE = 64;
+
+    // what the last render() did
+    struct Stats {
+        unsigned int staticFaces = 0;
+        unsigned int cachedFaces = 0;
+        unsigned int dynamicFaces = 0;
+        // lights that moved past the tolerance but didn't fit in this frame's budget
+        unsigned int staleLights = 0;
+        // lights that got no tile because the atlas is full
+        unsigned int lightsWithoutTile = 0;
+    };
+
+    PointShadowMaps() = default;
+    PointShadowMaps(const PointShadowMaps &) = delete;
+    PointShadowMaps &operator=(const PointShadowMaps &) = delete;
+
+    ~PointShadowMaps() {
+        destroy();
+    }
+
+    // (re)creates both atlases if the size changed; every light loses its tiles and is rendered again
+    void resize(int atlasSize) {
+        if (m_StaticTexture != 0 && atlasSize == m_Atlas.size())
+            return;
+        destroy();
+        m_Atlas.reset(atlasSize, MIN_TILE_SIZE);
+        for (Light &light: m_Lights)
+            light = Light();
+        createAtlas(m_StaticTexture, m_StaticFramebuffer, atlasSize, "point shadow cache");
+        createAtlas(m_FinalTexture, m_FinalFramebuffer, atlasSize, "point shadow atlas");
+    }
+
+    // this frame's lights; tileSize is the wanted size of one face, a light gets smaller faces when the atlas
+    // has no room for that
+    void setLights(const glm::vec3 *positions, int count, float range, int tileSize) {
+        count = std::min(count, MAX_LIGHTS);
+        if (tileSize != m_TileSize) {
+            for (int i = 0; i < MAX_LIGHTS; i++)
+                releaseTiles(i);
+            m_TileSize = tileSize;
+        }
+        for (int i = count; i < m_LightCount; i++)
+            releaseTiles(i);
+        m_LightCount = count;
+        for (int i = 0; i < count; i++) {
+            Light &light = m_Lights[i];
+            light.position = positions[i];
+            light.range = range;
+            if (!light.allocated && !light.noRoom)
+                allocateTiles(i);
+        }
+    }
+
+    // brings the cache and the final atlas up to date; drawStatic(matrix, frustum) draws the static casters of
+    // one face into the bound target, drawDynamic(matrix, frustum) the moving ones. Depth state is the caller's.
+    template<class DrawStatic, class DrawDynamic>
+    void render(int faceBudget, float tolerance, bool dynamicCasters, DrawStatic &&drawStatic, DrawDynamic &&drawDynamic) {
+        m_Stats = Stats();
+        if (m_StaticTexture == 0)
+            return;
+        bool refreshed[MAX_LIGHTS] = {false};
+        int budget = std::max(faceBudget, FACES);
+        int faces = 0;
+        glEnable(GL_SCISSOR_TEST);
+        glDepthMask(GL_TRUE);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_StaticFramebuffer);
+        while (faces + FACES <= budget) {
+            int index = mostStale(tolerance);
+            if (index < 0)
+                break;
+            Light &light = m_Lights[index];
+            light.renderedFrom = light.position;
+            light.renderedRange = light.range;
+            light.rendered = true;
+            for (int face = 0; face < FACES; face++) {
+                light.matrices[face] = faceMatrix(light.position, light.range, face);
+                bindTile(light.tiles[face]);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                drawStatic(light.matrices[face], Frustum(light.matrices[face]));
+            }
+            refreshed[index] = true;
+            faces += FACES;
+        }
+        m_Stats.staticFaces = faces;
+        for (int i = 0; i < m_LightCount; i++) {
+            m_Stats.staleLights += stale(m_Lights[i], tolerance);
+            m_Stats.lightsWithoutTile += !m_Lights[i].allocated;
+        }
+        // the dynamic depth of the last frame has to be covered as well when the dynamic casters are gone
+        bool copyAll = dynamicCasters || m_HadDynamicCasters;
+        for (int i = 0; i < m_LightCount; i++) {
+            const Light &light = m_Lights[i];
+            if (!light.allocated || !light.rendered)
+                continue;
+            if (!refreshed[i] && !copyAll) {
+                m_Stats.cachedFaces += FACES;
+                continue;
+            }
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_StaticFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_FinalFramebuffer);
+            for (const ShadowTile &tile: light.tiles) {
+                // the blit is scissored too
+                glScissor(tile.x, tile.y, tile.size, tile.size);
+                glBlitFramebuffer(tile.x, tile.y, tile.x + tile.size, tile.y + tile.size,
+                                  tile.x, tile.y, tile.x + tile.size, tile.y + tile.size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            }
+            if (!dynamicCasters)
+                continue;
+            glBindFramebuffer(GL_FRAMEBUFFER, m_FinalFramebuffer);
+            for (int face = 0; face < FACES; face++) {
+                bindTile(light.tiles[face]);
+                drawDynamic(light.matrices[face], Frustum(light.matrices[face]));
+            }
+            m_Stats.dynamicFaces += FACES;
+        }
+        m_HadDynamicCasters = dynamicCasters;
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    int lightCount() const { return m_LightCount; }
+
+    // false until the light has a tile and was rendered once; such a light is lit everywhere
+    bool hasShadow(int light) const { return m_Lights[light].allocated && m_Lights[light].rendered; }
+
+    // where the light was when its faces were rendered, the shader picks the face from the direction to this
+    const glm::vec3 &origin(int light) const { return m_Lights[light].renderedFrom; }
+
+    // world to clip space of one face (+x, -x, +y, -y, +z, -z)
+    const glm::mat4 &matrix(int light, int face) const { return m_Lights[light].matrices[face]; }
+
+    // the face's tile in atlas uv: offset in xy, size in zw
+    glm::vec4 rect(int light, int face) const {
+        const ShadowTile &tile = m_Lights[light].tiles[face];
+        float size = (float) m_Atlas.size();
+        return glm::vec4(tile.x / size, tile.y / size, tile.size / size, tile.size / size);
+    }
+
+    unsigned int texture() const { return m_FinalTexture; }
+
+    int atlasSize() const { return m_Atlas.size(); }
+
+    float atlasUsage() const { return m_Atlas.usage(); }
+
+    const Stats &stats() const { return m_Stats; }
+
+    void destroy() {
+        if (m_StaticTexture == 0)
+            return;
+        unsigned int framebuffers[] = {m_StaticFramebuffer, m_FinalFramebuffer};
+        glDeleteFramebuffers(2, framebuffers);
+        unsigned int textures[] = {m_StaticTexture, m_FinalTexture};
+        glDeleteTextures(2, textures);
+        MemoryTracker::untrack(MemoryTracker::TEXTURE, m_StaticTexture);
+        MemoryTracker::untrack(MemoryTracker::TEXTURE, m_FinalTexture);
+        m_StaticTexture = m_FinalTexture = 0;
+        m_StaticFramebuffer = m_FinalFramebuffer = 0;
+        m_LightCount = 0;
+    }
+
+private:
+    struct Light {
+        ShadowTile tiles[FACES];
+        glm::mat4 matrices[FACES];
+        glm::vec3 position = glm::vec3(0.0f);
+        float range = 0.0f;
+        glm::vec3 renderedFrom = glm::vec3(0.0f);
+        float renderedRange = 0.0f;
+        bool allocated = false;
+        bool rendered = false;
+        // the last allocation failed; tried again when some tile is released
+        bool noRoom = false;
+    };
+
+    static void createAtlas(unsigned int &texture, unsigned int &framebuffer, int size, const char *label) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        // linear filtering with depth compare gives 2x2 PCF per tap; the shader keeps taps inside the tile
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        MemoryTracker::track(MemoryTracker::TEXTURE, texture,
+                             MemoryTracker::textureBytes(GL_DEPTH_COMPONENT24, size, size, false, 1),
+                             MEMORY_SHADOWS, label);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        // a fresh atlas is all far plane
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // all six faces at the same size, halving it until they fit
+    void allocateTiles(int index) {
+        Light &light = m_Lights[index];
+        for (int size = m_TileSize; size >= MIN_TILE_SIZE; size /= 2) {
+            int face = 0;
+            for (; face < FACES; face++) {
+                light.tiles[face] = m_Atlas.allocate(size);
+                if (!light.tiles[face].valid())
+                    break;
+            }
+            if (face == FACES) {
+                light.allocated = true;
+                light.rendered = false;
+                return;
+            }
+            while (face-- > 0) {
+                m_Atlas.release(light.tiles[face]);
+                light.tiles[face] = ShadowTile();
+            }
+        }
+        light.noRoom = true;
+    }
+
+    void releaseTiles(int index) {
+        Light &light = m_Lights[index];
+        if (!light.allocated && !light.noRoom)
+            return;
+        for (ShadowTile &tile: light.tiles) {
+            m_Atlas.release(tile);
+            tile = ShadowTile();
+        }
+        light.allocated = false;
+        light.rendered = false;
+        light.noRoom = false;
+        // the space may be enough for a light that didn't fit
+        for (Light &other: m_Lights)
+            other.noRoom = false;
+    }
+
+    bool stale(const Light &light, float tolerance) const {
+        return light.allocated && (!light.rendered || glm::length(light.position - light.renderedFrom) > tolerance
+                                   || std::abs(light.range - light.renderedRange) > tolerance);
+    }
+
+    // the light that needs a refresh the most: never rendered first, then the one that moved furthest
+    int mostStale(float tolerance) const {
+        int best = -1;
+        float bestError = 0.0f;
+        for (int i = 0; i < m_LightCount; i++) {
+            const Light &light = m_Lights[i];
+            if (!stale(light, tolerance))
+                continue;
+            float error = !light.rendered ? FLT_MAX : glm::length(light.position - light.renderedFrom)
+                                                      + std::abs(light.range - light.renderedRange);
+            if (best < 0 || error > bestError) {
+                best = i;
+                bestError = error;
+            }
+        }
+        return best;
+    }
+
+    static glm::mat4 faceMatrix(const glm::vec3 &position, float range, int face) {
+        // the usual cubemap face directions and up vectors
+        static const glm::vec3 directions[FACES] = {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+                                                    glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+                                                    glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)};
+        static const glm::vec3 ups[FACES] = {glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+                                             glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+                                             glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, std::max(range, 0.1f));
+        return projection * glm::lookAt(position, position + directions[face], ups[face]);
+    }
+
+    static void bindTile(const ShadowTile &tile) {
+        glViewport(tile.x, tile.y, tile.size, tile.size);
+        glScissor(tile.x, tile.y, tile.size, tile.size);
+    }
+
+    Light m_Lights[MAX_LIGHTS];
+    ShadowAtlas m_Atlas;
+    Stats m_Stats;
+    unsigned int m_StaticTexture = 0;
+    unsigned int m_StaticFramebuffer = 0;
+    unsigned int m_FinalTexture = 0;
+    unsigned int m_FinalFramebuffer = 0;
+    int m_LightCount = 0;
+    int m_TileSize = 0;
+    bool m_HadDynamicCasters = false;
+};
+
+#endif //PROJECT_BASE_POINTSHADOWMAPS_H
@@ -0,0 +1,193 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+#include <rg/GpuTimer.h>
+
+#include "imgui.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Frame profiler: a GPU + CPU timer for the whole frame and for every named scope (render graph passes),
+// plus running averages of the frame time per pipeline mode so toggling a feature shows what it costs.
+class Profiler {
+public:
+    Profiler() = default;
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    void beginFrame() {
+        m_FrameCpuStart = now();
+        m_FrameIndex++;
+        m_Frame.begin();
+    }
+
+    void endFrame() {
+        m_Frame.end();
+        m_FrameCpuMs = (float) (now() - m_FrameCpuStart);
+        for (auto &comparison: m_Comparisons) {
+            if (comparison->hasCurrent && m_Frame.hasResult())
+                comparison->record(frameGpuMs());
+        }
+    }
+
+    // scopes are matched by name and keep their own copy of it
+    void begin(const char *name) {
+        Scope &scope = find(name);
+        scope.cpuStart = now();
+        scope.frame = m_FrameIndex;
+        scope.gpu.begin();
+    }
+
+    void end(const char *name) {
+        Scope &scope = find(name);
+        scope.gpu.end();
+        scope.cpuMs = (float) (now() - scope.cpuStart);
+    }
+
+    float frameGpuMs() const { return m_Frame.lastMs(); }
+
+    float frameCpuMs() const { return m_FrameCpuMs; }
+
+    bool hasFrameResult() const { return m_Frame.hasResult(); }
+
+    // last GPU time of a scope, 0 if it never ran
+    float scopeGpuMs(const char *name) const {
+        for (const auto &scope: m_Scopes) {
+            if (scope->name == name)
+                return scope->gpu.lastMs();
+        }
+        return 0.0f;
+    }
+
+    // tells the profiler which state a toggleable feature is in this frame,
+    // the frame time is then averaged separately for "on" and "off"
+    void setMode(const char *name, bool on) {
+        Comparison &comparison = findComparison(name);
+        comparison.hasCurrent = true;
+        comparison.currentOn = on;
+    }
+
+    // delta between the averaged "on" and "off" frame times, 0 until both were measured
+    float modeDeltaMs(const char *name) {
+        Comparison &comparison = findComparison(name);
+        if (comparison.samples[0] == 0 || comparison.samples[1] == 0)
+            return 0.0f;
+        return comparison.averageMs[1] - comparison.averageMs[0];
+    }
+
+    void drawOverlay() {
+        ImGui::Begin("Profiler");
+        ImGui::Text("Frame: GPU %.2f ms, CPU %.2f ms", frameGpuMs(), frameCpuMs());
+        ImGui::Separator();
+        for (auto &scope: m_Scopes) {
+            // passes the render graph culled this frame are not shown
+            if (scope->frame != m_FrameIndex)
+                continue;
+            ImGui::Text("%-12s GPU %6.3f ms  CPU %6.3f ms", scope->name.c_str(), scope->gpu.lastMs(), scope->cpuMs);
+        }
+        for (auto &comparison: m_Comparisons) {
+            ImGui::Separator();
+            const char *name = comparison->name.c_str();
+            char average[64];
+            ImGui::Text("%s on:  %s", name, formatAverage(*comparison, true, average, sizeof(average)));
+            ImGui::Text("%s off: %s", name, formatAverage(*comparison, false, average, sizeof(average)));
+            if (comparison->samples[0] > 0 && comparison->samples[1] > 0)
+                ImGui::Text("%s costs %.3f ms per frame", name, comparison->averageMs[1] - comparison->averageMs[0]);
+            else
+                ImGui::Text("toggle %s to measure the difference", name);
+        }
+        ImGui::End();
+    }
+
+    void destroy() {
+        m_Frame.destroy();
+        for (auto &scope: m_Scopes)
+            scope->gpu.destroy();
+    }
+
+private:
+    struct Scope {
+        std::string name;
+        GpuTimer gpu;
+        double cpuStart = 0.0;
+        float cpuMs = 0.0f;
+        unsigned int frame = 0;
+    };
+
+    struct Comparison {
+        std::string name;
+        bool hasCurrent = false;
+        bool currentOn = false;
+        // index 0 = off, 1 = on
+        float averageMs[2] = {0.0f, 0.0f};
+        unsigned int samples[2] = {0, 0};
+        bool lastOn = false;
+        unsigned int settleFrames = 0;
+
+        void record(float ms) {
+            // the GPU timer lags a few frames, skip the frames right after a toggle
+            if (currentOn != lastOn) {
+                lastOn = currentOn;
+                settleFrames = GpuTimer::QUERY_COUNT + 1;
+            }
+            if (settleFrames > 0) {
+                settleFrames--;
+                return;
+            }
+            int i = currentOn ? 1 : 0;
+            averageMs[i] = samples[i] == 0 ? ms : averageMs[i] * 0.95f + ms * 0.05f;
+            samples[i]++;
+        }
+    };
+
+    static double now() {
+        using namespace std::chrono;
+        return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // into the caller's buffer, the overlay is drawn every frame
+    static const char *formatAverage(const Comparison &comparison, bool on, char *buffer, size_t size) {
+        int i = on ? 1 : 0;
+        if (comparison.samples[i] == 0)
+            return "not measured";
+        snprintf(buffer, size, "%.3f ms (%u frames)", comparison.averageMs[i], comparison.samples[i]);
+        return buffer;
+    }
+
+    Scope &find(const char *name) {
+        for (auto &scope: m_Scopes) {
+            if (scope->name == name)
+                return *scope;
+        }
+        m_Scopes.emplace_back(new Scope());
+        m_Scopes.back()->name = name;
+        return *m_Scopes.back();
+    }
+
+    Comparison &findComparison(const char *name) {
+        for (auto &comparison: m_Comparisons) {
+            if (comparison->name == name)
+                return *comparison;
+        }
+        m_Comparisons.emplace_back(new Comparison());
+        m_Comparisons.back()->name = name;
+        return *m_Comparisons.back();
+    }
+
+    GpuTimer m_Frame;
+    unsigned int m_FrameIndex = 0;
+    double m_FrameCpuStart = 0.0;
+    float m_FrameCpuMs = 0.0f;
+    std::vector<std::unique_ptr<Scope>> m_Scopes;
+    std::vector<std::unique_ptr<Comparison>> m_Comparisons;
+};
+
+#endif //PROJECT_BASE_PROFILER_H
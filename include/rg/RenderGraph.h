@@ -0,0 +1,391 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_RENDERGRAPH_H
+#define PROJECT_BASE_RENDERGRAPH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <rg/RenderTargets.h>
+#include <rg/Profiler.h>
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Small render graph for the frame pipeline. Passes declare which resources they read and write,
+// compile() then
+//  - culls passes whose results never reach an output (e.g. the blur chain when bloom is off),
+//  - drops color attachments nobody reads afterwards,
+//  - computes resource lifetimes and aliases transient textures with disjoint lifetimes onto the
+//    same physical texture from RenderTargets,
+//  - clears a resource only before its first write, and only if it asked for it.
+// The graph is meant to be rebuilt only when the configuration changes (resize, toggled effects),
+// execute() is called every frame.
+class RenderGraph {
+public:
+    typedef int Resource;
+    static const Resource INVALID = -1;
+
+    struct TextureDesc {
+        GLenum internalFormat = GL_RGBA16F;
+        // clear before the first pass that writes it; leave false if that pass overwrites every pixel
+        bool clear = false;
+        glm::vec4 clearValue = glm::vec4(0.0f);
+    };
+
+    class PassBuilder {
+    public:
+        PassBuilder(RenderGraph *graph, int pass) : m_Graph(graph), m_Pass(pass) {}
+
+        PassBuilder &read(Resource resource) {
+            m_Graph->m_Passes[m_Pass].reads.push_back(resource);
+            return *this;
+        }
+
+        // color attachment, attached in declaration order (location 0, 1, ...)
+        PassBuilder &write(Resource resource) {
+            m_Graph->m_Passes[m_Pass].writes.push_back(resource);
+            return *this;
+        }
+
+        PassBuilder &depth(Resource resource) {
+            m_Graph->m_Passes[m_Pass].depth = resource;
+            return *this;
+        }
+
+        // the pass covers the whole window instead of the scaled render region
+        PassBuilder &fullResolution() {
+            m_Graph->m_Passes[m_Pass].fullResolution = true;
+            return *this;
+        }
+
+        // the pass has an effect outside the graph (e.g. reads its target back to the CPU, renders a shadow map),
+        // so it and everything it reads is never culled, and all its writes stay attached
+        PassBuilder &sideEffect() {
+            m_Graph->m_Passes[m_Pass].sideEffect = true;
+            return *this;
+        }
+
+    private:
+        RenderGraph *m_Graph;
+        int m_Pass;
+    };
+
+    explicit RenderGraph(RenderTargets &targets) : m_Targets(targets) {}
+
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    ~RenderGraph() {
+        destroyFramebuffers();
+    }
+
+    // forgets all passes and resources, call before declaring a new configuration
+    void reset() {
+        destroyFramebuffers();
+        m_Passes.clear();
+        m_Resources.clear();
+        m_Compiled = false;
+    }
+
+    Resource createTexture(const std::string &name, const TextureDesc &desc) {
+        ResourceNode node;
+        node.name = name;
+        node.desc = desc;
+        m_Resources.push_back(node);
+        return (Resource) m_Resources.size() - 1;
+    }
+
+    // the default framebuffer, always kept alive
+    Resource importBackbuffer(const std::string &name) {
+        ResourceNode node;
+        node.name = name;
+        node.backbuffer = true;
+        m_Resources.push_back(node);
+        return (Resource) m_Resources.size() - 1;
+    }
+
+    PassBuilder addPass(const std::string &name, std::function<void()> execute) {
+        PassNode pass;
+        pass.name = name;
+        pass.execute = std::move(execute);
+        m_Passes.push_back(pass);
+        return PassBuilder(this, (int) m_Passes.size() - 1);
+    }
+
+    // every executed pass gets its own profiler scope
+    void setProfiler(Profiler *profiler) {
+        m_Profiler = profiler;
+    }
+
+    void setClearValue(Resource resource, const glm::vec4 &value) {
+        m_Resources[resource].desc.clearValue = value;
+    }
+
+    void compile() {
+        destroyFramebuffers();
+        cullPasses();
+        allocateResources();
+        createFramebuffers();
+        m_Compiled = true;
+    }
+
+    bool compiled() const { return m_Compiled; }
+
+    void execute() {
+        for (PassNode &pass: m_Passes) {
+            if (pass.culled)
+                continue;
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+            if (pass.fullResolution || pass.fbo == 0)
+                glViewport(0, 0, m_Targets.width(), m_Targets.height());
+            else
+                glViewport(0, 0, m_Targets.renderWidth(), m_Targets.renderHeight());
+            if (m_Profiler)
+                m_Profiler->begin(pass.name.c_str());
+            performClears(pass);
+            pass.execute();
+            if (m_Profiler)
+                m_Profiler->end(pass.name.c_str());
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // physical texture backing a resource, valid between compile() and the next reset()
+    unsigned int texture(Resource resource) const {
+        return m_Resources[resource].texture;
+    }
+
+    // --- statistics, for the ImGui overlay ---
+    unsigned int passCount() const { return m_Passes.size(); }
+
+    unsigned int culledPassCount() const {
+        unsigned int count = 0;
+        for (const PassNode &pass: m_Passes)
+            count += pass.culled;
+        return count;
+    }
+
+    unsigned int resourceCount() const { return m_Resources.size(); }
+
+    unsigned int physicalTextureCount() const { return m_Targets.textureCount(); }
+
+    void printSummary(std::ostream &out) const {
+        for (const PassNode &pass: m_Passes) {
+            out << (pass.culled ? "  [culled] " : "  ") << pass.name;
+            if (!pass.clears.empty())
+                out << " (" << pass.clears.size() << " clears)";
+            out << '\n';
+        }
+    }
+
+private:
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        bool backbuffer = false;
+        bool needed = false;
+        int firstUse = -1;
+        int lastUse = -1;
+        unsigned int texture = 0;
+    };
+
+    struct Clear {
+        Resource resource;
+        int drawBuffer; // -1 for depth
+    };
+
+    struct PassNode {
+        std::string name;
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        Resource depth = INVALID;
+        bool fullResolution = false;
+        bool sideEffect = false;
+        std::function<void()> execute;
+
+        bool culled = false;
+        std::vector<bool> attached; // per color write, false if nobody consumes it
+        std::vector<Clear> clears;
+        unsigned int fbo = 0;
+    };
+
+    void cullPasses() {
+        // a write to a resource an earlier pass already wrote is a load of that resource
+        std::vector<bool> written(m_Resources.size(), false);
+        std::vector<std::vector<Resource>> loads(m_Passes.size());
+        for (unsigned int p = 0; p < m_Passes.size(); p++) {
+            PassNode &pass = m_Passes[p];
+            for (Resource r: pass.writes) {
+                if (written[r])
+                    loads[p].push_back(r);
+                written[r] = true;
+            }
+            if (pass.depth != INVALID) {
+                if (written[pass.depth])
+                    loads[p].push_back(pass.depth);
+                written[pass.depth] = true;
+            }
+        }
+
+        for (ResourceNode &resource: m_Resources)
+            resource.needed = resource.backbuffer;
+        for (int p = (int) m_Passes.size() - 1; p >= 0; p--) {
+            PassNode &pass = m_Passes[p];
+            pass.attached.assign(pass.writes.size(), false);
+            bool alive = false;
+            for (unsigned int i = 0; i < pass.writes.size(); i++) {
+                pass.attached[i] = pass.sideEffect || m_Resources[pass.writes[i]].needed;
+                alive = alive || pass.attached[i];
+            }
+            if (pass.depth != INVALID)
+                alive = alive || m_Resources[pass.depth].needed;
+            alive = alive || pass.sideEffect;
+            pass.culled = !alive;
+            if (!alive)
+                continue;
+            for (Resource r: pass.reads)
+                m_Resources[r].needed = true;
+            for (Resource r: loads[p])
+                m_Resources[r].needed = true;
+        }
+    }
+
+    void allocateResources() {
+        for (ResourceNode &resource: m_Resources) {
+            resource.firstUse = resource.lastUse = -1;
+            resource.texture = 0;
+        }
+        for (unsigned int p = 0; p < m_Passes.size(); p++) {
+            PassNode &pass = m_Passes[p];
+            if (pass.culled)
+                continue;
+            for (Resource r: pass.reads)
+                touch(r, p);
+            for (unsigned int i = 0; i < pass.writes.size(); i++) {
+                if (pass.attached[i])
+                    touch(pass.writes[i], p);
+            }
+            if (pass.depth != INVALID)
+                touch(pass.depth, p);
+        }
+
+        // walk the passes in order, taking textures from the pool at first use and returning them after
+        // the last one, so resources with disjoint lifetimes end up sharing memory
+        m_Targets.releaseAll();
+        for (unsigned int p = 0; p < m_Passes.size(); p++) {
+            for (ResourceNode &resource: m_Resources) {
+                if (!resource.backbuffer && resource.firstUse == (int) p)
+                    resource.texture = m_Targets.acquire(resource.desc.internalFormat);
+            }
+            for (ResourceNode &resource: m_Resources) {
+                if (!resource.backbuffer && resource.lastUse == (int) p)
+                    m_Targets.release(resource.texture);
+            }
+        }
+        // everything handed out stays reserved for this graph, trim() frees the rest
+        for (ResourceNode &resource: m_Resources) {
+            if (resource.texture != 0)
+                m_Targets.retain(resource.texture);
+        }
+        m_Targets.trim();
+
+        // clear only at the first write, and only resources that asked for it
+        std::vector<bool> written(m_Resources.size(), false);
+        for (PassNode &pass: m_Passes) {
+            pass.clears.clear();
+            if (pass.culled)
+                continue;
+            for (unsigned int i = 0; i < pass.writes.size(); i++) {
+                Resource r = pass.writes[i];
+                if (!pass.attached[i] || written[r])
+                    continue;
+                written[r] = true;
+                if (m_Resources[r].desc.clear)
+                    pass.clears.push_back({r, (int) i});
+            }
+            if (pass.depth != INVALID && !written[pass.depth]) {
+                written[pass.depth] = true;
+                if (m_Resources[pass.depth].desc.clear)
+                    pass.clears.push_back({pass.depth, -1});
+            }
+        }
+    }
+
+    void touch(Resource r, unsigned int pass) {
+        ResourceNode &resource = m_Resources[r];
+        if (resource.firstUse < 0)
+            resource.firstUse = pass;
+        resource.lastUse = pass;
+    }
+
+    void createFramebuffers() {
+        for (PassNode &pass: m_Passes) {
+            pass.fbo = 0;
+            if (pass.culled)
+                continue;
+            bool toBackbuffer = false;
+            for (Resource r: pass.writes)
+                toBackbuffer = toBackbuffer || m_Resources[r].backbuffer;
+            // a side effect pass without attachments binds its own targets (e.g. shadow maps)
+            if (toBackbuffer || (pass.writes.empty() && pass.depth == INVALID))
+                continue;
+
+            glGenFramebuffers(1, &pass.fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+            // keep the declared locations, a color write nobody reads is simply not attached
+            std::vector<GLenum> drawBuffers(pass.writes.size(), GL_NONE);
+            for (unsigned int i = 0; i < pass.writes.size(); i++) {
+                if (!pass.attached[i])
+                    continue;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D,
+                                       m_Resources[pass.writes[i]].texture, 0);
+                drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+            }
+            if (pass.depth != INVALID)
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                                       m_Resources[pass.depth].texture, 0);
+            if (drawBuffers.empty())
+                glDrawBuffer(GL_NONE);
+            else
+                glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "Framebuffer not complete! (" << pass.name << ")" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void performClears(const PassNode &pass) {
+        if (pass.clears.empty())
+            return;
+        for (const Clear &clear: pass.clears) {
+            const glm::vec4 &value = m_Resources[clear.resource].desc.clearValue;
+            if (clear.drawBuffer < 0) {
+                glDepthMask(GL_TRUE);
+                glClearBufferfv(GL_DEPTH, 0, &value.x);
+            } else {
+                glClearBufferfv(GL_COLOR, clear.drawBuffer, &value.x);
+            }
+        }
+    }
+
+    void destroyFramebuffers() {
+        for (PassNode &pass: m_Passes) {
+            if (pass.fbo != 0)
+                glDeleteFramebuffers(1, &pass.fbo);
+            pass.fbo = 0;
+        }
+    }
+
+    RenderTargets &m_Targets;
+    Profiler *m_Profiler = nullptr;
+    std::vector<ResourceNode> m_Resources;
+    std::vector<PassNode> m_Passes;
+    bool m_Compiled = false;
+};
+
+#endif //PROJECT_BASE_RENDERGRAPH_H
@@ -0,0 +1,150 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_RENDERTARGETS_H
+#define PROJECT_BASE_RENDERTARGETS_H
+
+#include <glad/glad.h>
+#include <rg/MemoryTracker.h>
+#include <algorithm>
+#include <vector>
+
+// Pool of window-sized render target textures used by the render graph.
+// Textures are allocated at full window resolution; the scene is rendered into the lower-left
+// renderWidth() x renderHeight() region, so changing the render scale never reallocates anything.
+// A resize drops every pooled texture, the render graph then acquires new ones on its next compile.
+class RenderTargets {
+public:
+    float renderScale = 1.0f;
+
+    RenderTargets() = default;
+    RenderTargets(const RenderTargets &) = delete;
+    RenderTargets &operator=(const RenderTargets &) = delete;
+
+    ~RenderTargets() {
+        destroy();
+    }
+
+    // drops all pooled textures if the window size changed; returns true if it did
+    bool resize(int width, int height) {
+        if (width <= 0 || height <= 0)
+            return false; // minimized window, keep the old targets
+        if (width == m_Width && height == m_Height)
+            return false;
+        destroy();
+        m_Width = width;
+        m_Height = height;
+        return true;
+    }
+
+    int width() const { return m_Width; }
+    int height() const { return m_Height; }
+
+    int renderWidth() const { return std::max(1, (int) (m_Width * renderScale + 0.5f)); }
+    int renderHeight() const { return std::max(1, (int) (m_Height * renderScale + 0.5f)); }
+
+    // fraction of the target textures covered by the rendered region, used by the composite and blur passes
+    float uvScaleX() const { return (float) renderWidth() / m_Width; }
+    float uvScaleY() const { return (float) renderHeight() / m_Height; }
+
+    // returns a free texture with the given internal format, allocating one if none is free
+    unsigned int acquire(GLenum internalFormat) {
+        for (Target &target: m_Targets) {
+            if (!target.inUse && target.internalFormat == internalFormat) {
+                target.inUse = true;
+                return target.texture;
+            }
+        }
+        Target target;
+        target.internalFormat = internalFormat;
+        target.inUse = true;
+        glGenTextures(1, &target.texture);
+        allocate(target.texture, internalFormat, m_Width, m_Height);
+        MemoryTracker::track(MemoryTracker::TEXTURE, target.texture, MemoryTracker::textureBytes(internalFormat, m_Width, m_Height),
+                             MEMORY_RENDER_TARGETS, "render target");
+        m_Targets.push_back(target);
+        return target.texture;
+    }
+
+    void release(unsigned int texture) {
+        for (Target &target: m_Targets) {
+            if (target.texture == texture)
+                target.inUse = false;
+        }
+    }
+
+    void retain(unsigned int texture) {
+        for (Target &target: m_Targets) {
+            if (target.texture == texture)
+                target.inUse = true;
+        }
+    }
+
+    void releaseAll() {
+        for (Target &target: m_Targets)
+            target.inUse = false;
+    }
+
+    // deletes the textures nobody acquired since the last releaseAll()
+    void trim() {
+        for (unsigned int i = 0; i < m_Targets.size();) {
+            if (!m_Targets[i].inUse) {
+                glDeleteTextures(1, &m_Targets[i].texture);
+                MemoryTracker::untrack(MemoryTracker::TEXTURE, m_Targets[i].texture);
+                m_Targets.erase(m_Targets.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    unsigned int textureCount() const { return m_Targets.size(); }
+
+    void destroy() {
+        for (Target &target: m_Targets) {
+            glDeleteTextures(1, &target.texture);
+            MemoryTracker::untrack(MemoryTracker::TEXTURE, target.texture);
+        }
+        m_Targets.clear();
+    }
+
+    static bool isDepthFormat(GLenum internalFormat) {
+        return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24
+               || internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH_COMPONENT;
+    }
+
+private:
+    struct Target {
+        unsigned int texture = 0;
+        GLenum internalFormat = GL_RGBA16F;
+        bool inUse = false;
+    };
+
+    static void allocate(unsigned int texture, GLenum internalFormat, int width, int height) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (isDepthFormat(internalFormat)) {
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        } else {
+            GLenum format = GL_RGBA;
+            if (internalFormat == GL_R8 || internalFormat == GL_R16F || internalFormat == GL_R32F)
+                format = GL_RED;
+            else if (internalFormat == GL_RG16F)
+                format = GL_RG;
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    std::vector<Target> m_Targets;
+    int m_Width = 0;
+    int m_Height = 0;
+};
+
+#endif //PROJECT_BASE_RENDERTARGETS_H
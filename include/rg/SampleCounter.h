@@ -0,0 +1,75 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_SAMPLECOUNTER_H
+#define PROJECT_BASE_SAMPLECOUNTER_H
+
+#include <glad/glad.h>
+
+// Counts the samples that pass the depth test between begin() and end() (GL_SAMPLES_PASSED occlusion query),
+// i.e. how many fragments were shaded. Like GpuTimer the queries rotate through a ring and results are read
+// a few frames late, so the counter never stalls. Occlusion queries can't nest.
+class SampleCounter {
+public:
+    static const int QUERY_COUNT = 4;
+
+    SampleCounter() = default;
+    SampleCounter(const SampleCounter &) = delete;
+    SampleCounter &operator=(const SampleCounter &) = delete;
+
+    ~SampleCounter() {
+        destroy();
+    }
+
+    void destroy() {
+        if (m_Created)
+            glDeleteQueries(QUERY_COUNT, m_Queries);
+        m_Created = false;
+    }
+
+    void begin() {
+        if (!m_Created) {
+            glGenQueries(QUERY_COUNT, m_Queries);
+            m_Created = true;
+        }
+        collect();
+        glBeginQuery(GL_SAMPLES_PASSED, m_Queries[m_Current]);
+    }
+
+    void end() {
+        glEndQuery(GL_SAMPLES_PASSED);
+        m_Pending[m_Current] = true;
+        m_Current = (m_Current + 1) % QUERY_COUNT;
+    }
+
+    // last resolved sample count (lags the current frame by a few frames)
+    unsigned int lastCount() const { return m_LastCount; }
+
+    bool hasResult() const { return m_HasResult; }
+
+private:
+    void collect() {
+        for (int i = 0; i < QUERY_COUNT; i++) {
+            int index = (m_Current + i) % QUERY_COUNT;
+            if (!m_Pending[index])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(m_Queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            glGetQueryObjectuiv(m_Queries[index], GL_QUERY_RESULT, &m_LastCount);
+            m_Pending[index] = false;
+            m_HasResult = true;
+        }
+    }
+
+    unsigned int m_Queries[QUERY_COUNT] = {0};
+    bool m_Pending[QUERY_COUNT] = {false};
+    int m_Current = 0;
+    bool m_Created = false;
+    bool m_HasResult = false;
+    unsigned int m_LastCount = 0;
+};
+
+#endif //PROJECT_BASE_SAMPLECOUNTER_H
@@ -0,0 +1,484 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_SCENEFILE_H
+#define PROJECT_BASE_SCENEFILE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Scene description: models, placed objects, lights and render settings.
+// The text form is for authoring, one statement per line ('#' starts a comment, "quotes" allow spaces):
+//     model <name> <path> [residency keep|positions|discard]
+//     object <name> <model> [position x y z] [rotation x y z] [scale s | scale x y z]
+//            [occluder] [transparent] [lamp] [bob ax ay az speed] [spin x y z]
+//     pointLight [ambient r g b] [diffuse r g b] [specular r g b] [attenuation constant linear quadratic]
+//     dirLight [direction x y z] [intensity ambient diffuse specular]
+//     skybox <right> <left> <top> <bottom> <front> <back>
+//     exposure <value>
+//     bloom on|off
+// residency is what the model keeps in RAM after its geometry is on the GPU (default keep).
+// Rotations are degrees applied around x, then y, then z. The binary form (save()) is a header and the
+// record arrays as they are in memory, so loading it is a few memcpy's. load() tells them apart by the magic.
+// The text parser doesn't allocate per token or line: a first pass counts models, objects and string bytes,
+// everything is reserved once and the second pass fills it. Strings live in one table, records hold offsets.
+class SceneFile {
+public:
+    static const unsigned int VERSION = 2;
+
+    enum ObjectFlags : unsigned int {
+        OBJECT_OCCLUDER = 1,
+        OBJECT_LAMP = 2,
+        OBJECT_TRANSPARENT = 4,
+    };
+
+    // same order as MeshResidency
+    enum ModelResidency : unsigned int {
+        RESIDENCY_KEEP = 0,
+        RESIDENCY_POSITIONS = 1,
+        RESIDENCY_DISCARD = 2,
+    };
+
+    struct Model {
+        unsigned int name;
+        unsigned int path;
+        unsigned int residency;
+    };
+
+    struct Object {
+        unsigned int name;
+        // index into models()
+        unsigned int model;
+        glm::vec3 position;
+        glm::vec3 rotation;
+        glm::vec3 scale;
+        unsigned int flags;
+        glm::vec3 bobAmplitude;
+        float bobSpeed;
+        // degrees per second
+        glm::vec3 spin;
+    };
+
+    struct Settings {
+        glm::vec3 pointAmbient = glm::vec3(0.1f);
+        glm::vec3 pointDiffuse = glm::vec3(0.6f);
+        glm::vec3 pointSpecular = glm::vec3(1.0f);
+        // constant, linear, quadratic
+        glm::vec3 pointAttenuation = glm::vec3(1.0f, 0.09f, 0.032f);
+        glm::vec3 dirDirection = glm::vec3(-0.2f, -1.0f, -0.3f);
+        // ambient, diffuse, specular
+        glm::vec3 dirIntensity = glm::vec3(0.25f, 0.2f, 0.1f);
+        float exposure = 1.0f;
+        unsigned int bloom = 1;
+        // string offsets, NO_STRING when the scene has no skybox
+        unsigned int skybox[6] = {NO_STRING, NO_STRING, NO_STRING, NO_STRING, NO_STRING, NO_STRING};
+    };
+
+    static const unsigned int NO_STRING = ~0u;
+
+    // text or binary, by the first bytes of the file
+    bool load(const std::string &path, std::string *error = nullptr) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            setError(error, "cannot open " + path);
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string data = buffer.str();
+        if (data.size() >= MAGIC_SIZE && memcmp(data.data(), magic(), MAGIC_SIZE) == 0)
+            return loadBinary(data.data(), data.size(), error);
+        return parse(data.c_str(), error);
+    }
+
+    // parses the text form; text must be 0 terminated
+    bool parse(const char *text, std::string *error = nullptr) {
+        clear();
+        unsigned int modelCount = 0, objectCount = 0, stringBytes = 0;
+        if (!parsePass(text, false, modelCount, objectCount, stringBytes, error))
+            return false;
+        m_Models.reserve(modelCount);
+        m_Objects.reserve(objectCount);
+        m_Strings.reserve(stringBytes);
+        if (!parsePass(text, true, modelCount, objectCount, stringBytes, error))
+            return false;
+        // objects name their model; models may be declared after the objects that use them
+        for (Object &object: m_Objects) {
+            unsigned int model = findModel(string(object.model));
+            if (model == NO_STRING) {
+                setError(error, std::string("object ") + string(object.name) + " uses unknown model " + string(object.model));
+                return false;
+            }
+            object.model = model;
+        }
+        return true;
+    }
+
+    bool loadBinary(const char *data, size_t size, std::string *error = nullptr) {
+        clear();
+        Header header;
+        if (size < sizeof(Header)) {
+            setError(error, "binary scene is truncated");
+            return false;
+        }
+        memcpy(&header, data, sizeof(Header));
+        if (header.version != VERSION) {
+            setError(error, "binary scene has version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION));
+            return false;
+        }
+        size_t expected = sizeof(Header) + header.modelCount * sizeof(Model) + header.objectCount * sizeof(Object)
+                          + header.stringBytes;
+        if (size != expected) {
+            setError(error, "binary scene has the wrong size");
+            return false;
+        }
+        const char *cursor = data + sizeof(Header);
+        m_Settings = header.settings;
+        m_Models.resize(header.modelCount);
+        memcpy(m_Models.data(), cursor, header.modelCount * sizeof(Model));
+        cursor += header.modelCount * sizeof(Model);
+        m_Objects.resize(header.objectCount);
+        memcpy(m_Objects.data(), cursor, header.objectCount * sizeof(Object));
+        cursor += header.objectCount * sizeof(Object);
+        m_Strings.assign(cursor, cursor + header.stringBytes);
+        if (!m_Strings.empty() && m_Strings.back() != '\0') {
+            setError(error, "binary scene string table is not terminated");
+            clear();
+            return false;
+        }
+        for (const Object &object: m_Objects) {
+            if (object.model >= m_Models.size()) {
+                setError(error, "binary scene object uses model " + std::to_string(object.model) + " of "
+                                + std::to_string(m_Models.size()));
+                clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // writes the binary form
+    bool save(const std::string &path, std::string *error = nullptr) const {
+        Header header;
+        memcpy(header.magic, magic(), MAGIC_SIZE);
+        header.version = VERSION;
+        header.modelCount = m_Models.size();
+        header.objectCount = m_Objects.size();
+        header.stringBytes = m_Strings.size();
+        header.settings = m_Settings;
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(m_Models.data()), m_Models.size() * sizeof(Model));
+        file.write(reinterpret_cast<const char *>(m_Objects.data()), m_Objects.size() * sizeof(Object));
+        file.write(m_Strings.data(), m_Strings.size());
+        if (!file) {
+            setError(error, "cannot write " + path);
+            return false;
+        }
+        return true;
+    }
+
+    const std::vector<Model> &models() const { return m_Models; }
+
+    const std::vector<Object> &objects() const { return m_Objects; }
+
+    const Settings &settings() const { return m_Settings; }
+
+    const char *string(unsigned int offset) const {
+        return offset < m_Strings.size() ? m_Strings.data() + offset : "";
+    }
+
+    bool hasSkybox() const { return m_Settings.skybox[0] != NO_STRING; }
+
+private:
+    static const size_t MAGIC_SIZE = 8;
+
+    // a function-local static, a static data member would need a definition in exactly one .cpp
+    static const char *magic() {
+        static const char value[MAGIC_SIZE] = {'R', 'G', 'S', 'C', 'E', 'N', 'E', '\0'};
+        return value;
+    }
+
+    struct Header {
+        char magic[MAGIC_SIZE];
+        unsigned int version;
+        unsigned int modelCount;
+        unsigned int objectCount;
+        unsigned int stringBytes;
+        Settings settings;
+    };
+
+    struct Token {
+        const char *begin = nullptr;
+        const char *end = nullptr;
+
+        bool empty() const { return begin == end; }
+
+        bool is(const char *word) const {
+            size_t length = strlen(word);
+            return (size_t) (end - begin) == length && memcmp(begin, word, length) == 0;
+        }
+    };
+
+    // cuts tokens out of one line
+    struct Line {
+        const char *cursor;
+        const char *end;
+
+        Token next() {
+            while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+                cursor++;
+            Token token;
+            if (cursor == end || *cursor == '#')
+                return token;
+            if (*cursor == '"') {
+                token.begin = ++cursor;
+                while (cursor < end && *cursor != '"')
+                    cursor++;
+                token.end = cursor;
+                if (cursor < end)
+                    cursor++;
+                return token;
+            }
+            token.begin = cursor;
+            while (cursor < end && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '#')
+                cursor++;
+            token.end = cursor;
+            return token;
+        }
+
+        // the next token parsed as a number, without consuming it when it isn't one
+        bool number(float &value) {
+            Line saved = *this;
+            Token token = next();
+            if (token.empty()) {
+                *this = saved;
+                return false;
+            }
+            char *numberEnd = nullptr;
+            value = strtof(token.begin, &numberEnd);
+            if (numberEnd != token.end) {
+                *this = saved;
+                return false;
+            }
+            return true;
+        }
+
+        bool vector(glm::vec3 &value) {
+            return number(value.x) && number(value.y) && number(value.z);
+        }
+    };
+
+    void clear() {
+        m_Models.clear();
+        m_Objects.clear();
+        m_Strings.clear();
+        m_Settings = Settings();
+    }
+
+    static void setError(std::string *error, const std::string &message) {
+        if (error)
+            *error = message;
+    }
+
+    // first pass (fill = false) only counts, the second one stores
+    bool parsePass(const char *text, bool fill, unsigned int &modelCount, unsigned int &objectCount,
+                   unsigned int &stringBytes, std::string *error) {
+        unsigned int lineNumber = 0;
+        const char *cursor = text;
+        while (*cursor) {
+            const char *lineEnd = cursor;
+            while (*lineEnd && *lineEnd != '\n')
+                lineEnd++;
+            lineNumber++;
+            Line line{cursor, lineEnd};
+            cursor = *lineEnd ? lineEnd + 1 : lineEnd;
+            Token keyword = line.next();
+            if (keyword.empty())
+                continue;
+            const char *problem = statement(keyword, line, fill, modelCount, objectCount, stringBytes);
+            if (problem == nullptr && !line.next().empty())
+                problem = "unexpected text at the end of the line";
+            if (problem) {
+                // only the first pass can fail, the second sees the same text
+                setError(error, "line " + std::to_string(lineNumber) + ": " + problem);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char *statement(const Token &keyword, Line &line, bool fill, unsigned int &modelCount,
+                          unsigned int &objectCount, unsigned int &stringBytes) {
+        if (keyword.is("model")) {
+            Token name = line.next(), path = line.next();
+            if (name.empty() || path.empty())
+                return "model needs a name and a path";
+            unsigned int residency = RESIDENCY_KEEP;
+            for (Token option = line.next(); !option.empty(); option = line.next()) {
+                if (!option.is("residency"))
+                    return "unknown model option";
+                Token mode = line.next();
+                if (mode.is("keep"))
+                    residency = RESIDENCY_KEEP;
+                else if (mode.is("positions"))
+                    residency = RESIDENCY_POSITIONS;
+                else if (mode.is("discard"))
+                    residency = RESIDENCY_DISCARD;
+                else
+                    return "residency is keep, positions or discard";
+            }
+            if (!fill) {
+                modelCount++;
+                stringBytes += stringSize(name) + stringSize(path);
+                return nullptr;
+            }
+            m_Models.push_back(Model{addString(name), addString(path), residency});
+            return nullptr;
+        }
+        if (keyword.is("object")) {
+            Token name = line.next(), model = line.next();
+            if (name.empty() || model.empty())
+                return "object needs a name and a model";
+            Object object = Object();
+            object.scale = glm::vec3(1.0f);
+            for (Token option = line.next(); !option.empty(); option = line.next()) {
+                if (option.is("position")) {
+                    if (!line.vector(object.position))
+                        return "position needs 3 numbers";
+                } else if (option.is("rotation")) {
+                    if (!line.vector(object.rotation))
+                        return "rotation needs 3 numbers";
+                } else if (option.is("scale")) {
+                    if (!line.number(object.scale.x))
+                        return "scale needs 1 or 3 numbers";
+                    if (line.number(object.scale.y)) {
+                        if (!line.number(object.scale.z))
+                            return "scale needs 1 or 3 numbers";
+                    } else {
+                        object.scale = glm::vec3(object.scale.x);
+                    }
+                } else if (option.is("occluder")) {
+                    object.flags |= OBJECT_OCCLUDER;
+                } else if (option.is("transparent")) {
+                    object.flags |= OBJECT_TRANSPARENT;
+                } else if (option.is("lamp")) {
+                    object.flags |= OBJECT_LAMP;
+                } else if (option.is("bob")) {
+                    if (!line.vector(object.bobAmplitude) || !line.number(object.bobSpeed))
+                        return "bob needs an amplitude vector and a speed";
+                } else if (option.is("spin")) {
+                    if (!line.vector(object.spin))
+                        return "spin needs 3 numbers";
+                } else {
+                    return "unknown object option";
+                }
+            }
+            if (!fill) {
+                objectCount++;
+                stringBytes += stringSize(name) + stringSize(model);
+                return nullptr;
+            }
+            object.name = addString(name);
+            // resolved to a model index after the whole file is read
+            object.model = addString(model);
+            m_Objects.push_back(object);
+            return nullptr;
+        }
+        if (keyword.is("pointLight")) {
+            for (Token option = line.next(); !option.empty(); option = line.next()) {
+                glm::vec3 value;
+                if (!line.vector(value))
+                    return "pointLight values need 3 numbers";
+                if (option.is("ambient"))
+                    m_Settings.pointAmbient = value;
+                else if (option.is("diffuse"))
+                    m_Settings.pointDiffuse = value;
+                else if (option.is("specular"))
+                    m_Settings.pointSpecular = value;
+                else if (option.is("attenuation"))
+                    m_Settings.pointAttenuation = value;
+                else
+                    return "unknown pointLight option";
+            }
+            return nullptr;
+        }
+        if (keyword.is("dirLight")) {
+            for (Token option = line.next(); !option.empty(); option = line.next()) {
+                glm::vec3 value;
+                if (!line.vector(value))
+                    return "dirLight values need 3 numbers";
+                if (option.is("direction"))
+                    m_Settings.dirDirection = value;
+                else if (option.is("intensity"))
+                    m_Settings.dirIntensity = value;
+                else
+                    return "unknown dirLight option";
+            }
+            return nullptr;
+        }
+        if (keyword.is("skybox")) {
+            Token faces[6];
+            for (Token &face: faces) {
+                face = line.next();
+                if (face.empty())
+                    return "skybox needs 6 faces";
+            }
+            for (int i = 0; i < 6; i++) {
+                if (!fill)
+                    stringBytes += stringSize(faces[i]);
+                else
+                    m_Settings.skybox[i] = addString(faces[i]);
+            }
+            return nullptr;
+        }
+        if (keyword.is("exposure")) {
+            if (!line.number(m_Settings.exposure))
+                return "exposure needs a number";
+            return nullptr;
+        }
+        if (keyword.is("bloom")) {
+            Token value = line.next();
+            if (!value.is("on") && !value.is("off"))
+                return "bloom is on or off";
+            m_Settings.bloom = value.is("on");
+            return nullptr;
+        }
+        return "unknown statement";
+    }
+
+    static unsigned int stringSize(const Token &token) {
+        return token.end - token.begin + 1;
+    }
+
+    // the table was reserved by the counting pass, so this never reallocates
+    unsigned int addString(const Token &token) {
+        unsigned int offset = m_Strings.size();
+        m_Strings.insert(m_Strings.end(), token.begin, token.end);
+        m_Strings.push_back('\0');
+        return offset;
+    }
+
+    unsigned int findModel(const char *name) const {
+        for (unsigned int i = 0; i < m_Models.size(); i++) {
+            if (strcmp(string(m_Models[i].name), name) == 0)
+                return i;
+        }
+        return NO_STRING;
+    }
+
+    std::vector<Model> m_Models;
+    std::vector<Object> m_Objects;
+    std::vector<char> m_Strings;
+    Settings m_Settings;
+};
+
+#endif //PROJECT_BASE_SCENEFILE_H
@@ -0,0 +1,114 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_SCENEGRAPH_H
+#define PROJECT_BASE_SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/model.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Transform hierarchy with cached world matrices.
+// Nodes are stored structure-of-arrays (parent, local, world and flag arrays indexed by node) and a node is
+// always added after its parent, so update() is one forward sweep over contiguous arrays: a node is
+// recomputed only when its local transform was set or its parent's world matrix changed in the same sweep,
+// i.e. exactly the dirty subtrees. The sweep starts at the first dirty node and is skipped when nothing is.
+// Nodes can't be removed or reparented; the scene is built once and then only animated.
+class SceneGraph {
+public:
+    static const unsigned int NONE = ~0u;
+
+    unsigned int addNode(const std::string &name, const glm::mat4 &local, unsigned int parent = NONE) {
+        unsigned int node = m_Parent.size();
+        m_Names.push_back(name);
+        m_Parent.push_back(parent);
+        m_Local.push_back(local);
+        m_World.push_back(local);
+        m_Dirty.push_back(1);
+        m_Changed.push_back(0);
+        m_FirstDirty = std::min(m_FirstDirty, node);
+        return node;
+    }
+
+    // instance of the model's node hierarchy under a new node with the given local transform;
+    // meshNodes[i] becomes the node holding model.meshes[i] (every Model mesh belongs to exactly one node)
+    unsigned int addModel(const std::string &name, const Model &model, const glm::mat4 &local, unsigned int parent,
+                          std::vector<unsigned int> &meshNodes) {
+        unsigned int root = addNode(name, local, parent);
+        unsigned int first = m_Parent.size();
+        meshNodes.assign(model.meshes.size(), root);
+        for (unsigned int i = 0; i < model.nodes.size(); i++) {
+            const ModelNode &modelNode = model.nodes[i];
+            unsigned int node = addNode(modelNode.name, modelNode.transform,
+                                        modelNode.parent < 0 ? root : first + modelNode.parent);
+            for (unsigned int mesh: modelNode.meshes)
+                meshNodes[mesh] = node;
+        }
+        return root;
+    }
+
+    void setLocal(unsigned int node, const glm::mat4 &local) {
+        m_Local[node] = local;
+        m_Dirty[node] = 1;
+        m_FirstDirty = std::min(m_FirstDirty, node);
+    }
+
+    // recomputes the world matrices of dirty subtrees, returns how many nodes were recomputed
+    unsigned int update() {
+        unsigned int count = m_Parent.size();
+        if (m_ChangedAny) {
+            memset(m_Changed.data(), 0, m_Changed.size());
+            m_ChangedAny = false;
+        }
+        if (m_FirstDirty >= count)
+            return 0;
+        const unsigned int *parents = m_Parent.data();
+        const glm::mat4 *locals = m_Local.data();
+        glm::mat4 *worlds = m_World.data();
+        unsigned char *dirty = m_Dirty.data();
+        unsigned char *changed = m_Changed.data();
+        unsigned int updated = 0;
+        for (unsigned int i = m_FirstDirty; i < count; i++) {
+            unsigned int parent = parents[i];
+            if (!dirty[i] && (parent == NONE || !changed[parent]))
+                continue;
+            worlds[i] = parent == NONE ? locals[i] : worlds[parent] * locals[i];
+            dirty[i] = 0;
+            changed[i] = 1;
+            updated++;
+        }
+        m_FirstDirty = NONE;
+        m_ChangedAny = updated > 0;
+        return updated;
+    }
+
+    const glm::mat4 &local(unsigned int node) const { return m_Local[node]; }
+
+    const glm::mat4 &world(unsigned int node) const { return m_World[node]; }
+
+    // the world matrix was recomputed by the last update()
+    bool changed(unsigned int node) const { return m_Changed[node] != 0; }
+
+    unsigned int parent(unsigned int node) const { return m_Parent[node]; }
+
+    const std::string &name(unsigned int node) const { return m_Names[node]; }
+
+    unsigned int size() const { return m_Parent.size(); }
+
+private:
+    std::vector<std::string> m_Names;
+    std::vector<unsigned int> m_Parent;
+    std::vector<glm::mat4> m_Local;
+    std::vector<glm::mat4> m_World;
+    std::vector<unsigned char> m_Dirty;
+    std::vector<unsigned char> m_Changed;
+    unsigned int m_FirstDirty = NONE;
+    bool m_ChangedAny = false;
+};
+
+#endif //PROJECT_BASE_SCENEGRAPH_H
@@ -0,0 +1,410 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_SHADERLIBRARY_H
+#define PROJECT_BASE_SHADERLIBRARY_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// Shader permutations compiled on demand.
+// A program is declared once with its vertex/fragment files and the list of on/off keys it supports
+// ("BLOOM", "SPOTLIGHT", ...) plus valued constants ("NR_POINT_LIGHTS" = "2"). get(program, mask)
+// returns the variant with the keys whose bits are set in mask, compiling it the first time.
+// Sources are preprocessed here: the keys become #define lines after #version and
+// #include "file" is resolved relative to the including file (every file is included once).
+// Linked programs are stored with glGetProgramBinary in cacheDirectory, keyed by a hash of the
+// preprocessed sources and the driver, so the next start skips GLSL compilation entirely.
+// Every variant remembers the files it was built from, so ShaderReloader can rebuild the ones an edited file
+// affects and swap the new program in with replace().
+class ShaderLibrary {
+public:
+    typedef unsigned int ProgramHandle;
+
+    std::string cacheDirectory = "resources/shader_cache";
+
+    ShaderLibrary() = default;
+    ShaderLibrary(const ShaderLibrary &) = delete;
+    ShaderLibrary &operator=(const ShaderLibrary &) = delete;
+
+    // program binaries are not part of the 3.3 core glad we use, so the entry points are looked up here
+    // (core since 4.1, or GL_ARB_get_program_binary); without them the cache is simply disabled
+    void loadBinaryCacheFunctions(GLADloadproc load) {
+        m_GetProgramBinary = (GetProgramBinaryProc) load("glGetProgramBinary");
+        m_ProgramBinary = (ProgramBinaryProc) load("glProgramBinary");
+        m_ProgramParameteri = (ProgramParameteriProc) load("glProgramParameteri");
+        GLint formats = 0;
+        if (m_GetProgramBinary && m_ProgramBinary && m_ProgramParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        while (glGetError() != GL_NO_ERROR) {}
+        m_BinaryCache = formats > 0;
+        if (m_BinaryCache)
+            mkdir(cacheDirectory.c_str(), 0755);
+        const char *renderer = (const char *) glGetString(GL_RENDERER);
+        const char *version = (const char *) glGetString(GL_VERSION);
+        m_DriverHash = hash(std::string(renderer ? renderer : "") + "|" + (version ? version : ""));
+    }
+
+    bool binaryCacheEnabled() const { return m_BinaryCache; }
+
+    ProgramHandle declare(const std::string &vertexPath, const std::string &fragmentPath,
+                          const std::vector<std::string> &keys = {}) {
+        Program program;
+        program.vertexPath = vertexPath;
+        program.fragmentPath = fragmentPath;
+        program.keys = keys;
+        m_Programs.push_back(std::move(program));
+        return (ProgramHandle) m_Programs.size() - 1;
+    }
+
+    // valued define shared by every variant of the program
+    void setConstant(ProgramHandle handle, const std::string &name, const std::string &value) {
+        m_Programs[handle].constants.push_back(std::make_pair(name, value));
+    }
+
+    unsigned int keyBit(ProgramHandle handle, const std::string &key) const {
+        const std::vector<std::string> &keys = m_Programs[handle].keys;
+        for (unsigned int i = 0; i < keys.size(); i++) {
+            if (keys[i] == key)
+                return 1u << i;
+        }
+        std::cout << "ERROR::SHADER_LIBRARY unknown key " << key << std::endl;
+        return 0;
+    }
+
+    // the variant with the keys in mask, compiled (or loaded from the binary cache) the first time it is asked for
+    Shader &get(ProgramHandle handle, unsigned int mask = 0) {
+        Program &program = m_Programs[handle];
+        for (Variant &variant: program.variants) {
+            if (variant.mask == mask)
+                return *variant.shader;
+        }
+        Variant variant;
+        variant.mask = mask;
+        variant.shader.reset(new Shader(build(program, mask, variant.files)));
+        program.variants.push_back(std::move(variant));
+        return *program.variants.back().shader;
+    }
+
+    // --- hot reload ---
+    // preprocessed sources of one variant, everything needed to compile it on another thread
+    struct Source {
+        ProgramHandle handle = 0;
+        unsigned int mask = 0;
+        std::string vertexName;
+        std::string fragmentName;
+        std::string vertexCode;
+        std::string fragmentCode;
+        uint64_t sourceHash = 0;
+        std::vector<std::string> files;
+    };
+
+    // compiled variants that include a file with this name (inotify only reports the name inside the watched directory)
+    std::vector<std::pair<ProgramHandle, unsigned int>> dependents(const std::string &fileName) const {
+        std::vector<std::pair<ProgramHandle, unsigned int>> result;
+        for (ProgramHandle handle = 0; handle < m_Programs.size(); handle++) {
+            for (const Variant &variant: m_Programs[handle].variants) {
+                for (const std::string &file: variant.files) {
+                    if (file.compare(directoryOf(file).size(), std::string::npos, fileName) == 0) {
+                        result.push_back(std::make_pair(handle, variant.mask));
+                        break;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    // reads and preprocesses the variant's files again
+    Source source(ProgramHandle handle, unsigned int mask) {
+        return source(m_Programs[handle], handle, mask);
+    }
+
+    // compiles and links on the calling thread's context (the main one or a shared one);
+    // returns 0 and fills log if anything failed
+    unsigned int link(const Source &source, std::string *log = nullptr) const {
+        bool vertexOk = false;
+        bool fragmentOk = false;
+        unsigned int vertex = Shader::compileStage(GL_VERTEX_SHADER, source.vertexCode, "VERTEX " + source.vertexName, &vertexOk, log);
+        unsigned int fragment = Shader::compileStage(GL_FRAGMENT_SHADER, source.fragmentCode, "FRAGMENT " + source.fragmentName, &fragmentOk, log);
+        unsigned int id = glCreateProgram();
+        glAttachShader(id, vertex);
+        glAttachShader(id, fragment);
+        if (m_BinaryCache)
+            m_ProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        bool linked = false;
+        if (vertexOk && fragmentOk) {
+            glLinkProgram(id);
+            linked = Shader::checkCompileErrors(id, "PROGRAM", log);
+        }
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        if (!linked) {
+            glDeleteProgram(id);
+            return 0;
+        }
+        return id;
+    }
+
+    // swaps a successfully linked program into its variant; every Shader& handed out by get() keeps working
+    // and uses the new program from the next use() on. Uniforms start from their defaults again.
+    void replace(const Source &source, unsigned int id) {
+        for (Variant &variant: m_Programs[source.handle].variants) {
+            if (variant.mask != source.mask)
+                continue;
+            glDeleteProgram(variant.shader->ID);
+            variant.shader->ID = id;
+            variant.files = source.files;
+            saveBinary(id, cacheFileName(m_Programs[source.handle], source.mask), source.sourceHash);
+            return;
+        }
+        glDeleteProgram(id); // variant does not exist (anymore)
+    }
+
+    // --- statistics ---
+    unsigned int compiledCount() const { return m_Compiled; }
+
+    unsigned int cacheHitCount() const { return m_CacheHits; }
+
+    void destroy() {
+        for (Program &program: m_Programs) {
+            for (Variant &variant: program.variants)
+                glDeleteProgram(variant.shader->ID);
+            program.variants.clear();
+        }
+    }
+
+    static uint64_t hash(const std::string &data, uint64_t seed = 14695981039346656037ull) {
+        // FNV-1a
+        uint64_t h = seed;
+        for (unsigned char c: data) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                                  GLenum *binaryFormat, void *binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    struct Variant {
+        unsigned int mask = 0;
+        std::unique_ptr<Shader> shader;
+        std::vector<std::string> files;
+    };
+
+    struct Program {
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::vector<std::string> keys;
+        std::vector<std::pair<std::string, std::string>> constants;
+        std::vector<Variant> variants;
+    };
+
+    std::string definesFor(const Program &program, unsigned int mask) const {
+        std::string defines;
+        for (const auto &constant: program.constants)
+            defines += "#define " + constant.first + " " + constant.second + "\n";
+        for (unsigned int i = 0; i < program.keys.size(); i++) {
+            if (mask & (1u << i))
+                defines += "#define " + program.keys[i] + "\n";
+        }
+        return defines;
+    }
+
+    Source source(const Program &program, ProgramHandle handle, unsigned int mask) {
+        Source result;
+        result.handle = handle;
+        result.mask = mask;
+        result.vertexName = program.vertexPath;
+        result.fragmentName = program.fragmentPath;
+        std::string defines = definesFor(program, mask);
+        result.vertexCode = preprocess(program.vertexPath, defines, result.files);
+        result.fragmentCode = preprocess(program.fragmentPath, defines, result.files);
+        result.sourceHash = hash(result.fragmentCode, hash(result.vertexCode, m_DriverHash));
+        return result;
+    }
+
+    unsigned int build(const Program &program, unsigned int mask, std::vector<std::string> &files) {
+        Source src = source(program, (ProgramHandle) (&program - m_Programs.data()), mask);
+        files = src.files;
+
+        std::string cachePath = cacheFileName(program, mask);
+        unsigned int id = loadBinary(cachePath, src.sourceHash);
+        if (id != 0) {
+            m_CacheHits++;
+            return id;
+        }
+
+        // a variant that fails here stays 0 (draws nothing) until hot reload brings a version that links
+        id = link(src);
+        m_Compiled++;
+        if (id != 0)
+            saveBinary(id, cachePath, src.sourceHash);
+        return id;
+    }
+
+    std::string cacheFileName(const Program &program, unsigned int mask) const {
+        uint64_t key = hash(program.vertexPath + "|" + program.fragmentPath + "|" + definesFor(program, mask));
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+        return cacheDirectory + "/" + name;
+    }
+
+    struct BinaryHeader {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t sourceHash;
+        uint32_t length;
+    };
+    static const uint32_t BINARY_MAGIC = 0x52474253; // "RGBS"
+
+    unsigned int loadBinary(const std::string &path, uint64_t sourceHash) {
+        if (!m_BinaryCache)
+            return 0;
+        std::ifstream in(path, std::ios::binary);
+        BinaryHeader header;
+        if (!in || !in.read((char *) &header, sizeof(header)))
+            return 0;
+        // a stale binary (edited sources, driver update) is simply recompiled and overwritten
+        if (header.magic != BINARY_MAGIC || header.sourceHash != sourceHash)
+            return 0;
+        // a truncated or damaged file: the length must fit in what is left of it and all of it must be read,
+        // otherwise the entry is dropped and the program compiled and cached again
+        std::streamoff start = in.tellg();
+        in.seekg(0, std::ios::end);
+        std::streamoff remaining = in.tellg() - start;
+        in.seekg(start);
+        if (header.length == 0 || (std::streamoff) header.length > remaining) {
+            in.close();
+            std::remove(path.c_str());
+            return 0;
+        }
+        std::vector<char> binary(header.length);
+        if (!in.read(binary.data(), binary.size()) || in.gcount() != (std::streamsize) binary.size()) {
+            in.close();
+            std::remove(path.c_str());
+            return 0;
+        }
+        unsigned int id = glCreateProgram();
+        m_ProgramBinary(id, header.format, binary.data(), (GLsizei) binary.size());
+        GLint linked = 0;
+        glGetProgramiv(id, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(id);
+            return 0;
+        }
+        return id;
+    }
+
+    void saveBinary(unsigned int id, const std::string &path, uint64_t sourceHash) {
+        if (!m_BinaryCache)
+            return;
+        GLint length = 0;
+        glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        m_GetProgramBinary(id, length, &length, &format, binary.data());
+        BinaryHeader header = {BINARY_MAGIC, format, sourceHash, (uint32_t) length};
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write((const char *) &header, sizeof(header));
+        out.write(binary.data(), length);
+    }
+
+    // resolves #include "file" relative to the including file and puts the defines right after #version;
+    // #line directives keep the driver's error messages pointing at the right file (source string number = file index)
+    // (files collects every file read, for the hot reload)
+    std::string preprocess(const std::string &path, const std::string &defines, std::vector<std::string> &files) {
+        std::vector<std::string> included;
+        std::string out;
+        expand(path, defines, included, out);
+        for (const std::string &file: included) {
+            if (std::find(files.begin(), files.end(), file) == files.end())
+                files.push_back(file);
+        }
+        return out;
+    }
+
+    static std::string directoryOf(const std::string &path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+
+    void expand(const std::string &path, const std::string &defines, std::vector<std::string> &included,
+                std::string &out) {
+        for (const std::string &file: included) {
+            if (file == path)
+                return;
+        }
+        included.push_back(path);
+        unsigned int fileIndex = included.size() - 1;
+
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return;
+        }
+        std::string line;
+        unsigned int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            size_t first = line.find_first_not_of(" \t");
+            if (first != std::string::npos && line.compare(first, 8, "#version") == 0) {
+                out += line + "\n" + defines;
+                out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+            } else if (first != std::string::npos && line.compare(first, 8, "#include") == 0) {
+                size_t open = line.find('"', first);
+                size_t close = line.find('"', open + 1);
+                if (open == std::string::npos || close == std::string::npos) {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << lineNumber << std::endl;
+                    continue;
+                }
+                std::string includePath = directoryOf(path) + line.substr(open + 1, close - open - 1);
+                out += "#line 1 " + std::to_string(included.size()) + "\n";
+                expand(includePath, "", included, out);
+                out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+            } else {
+                out += line + "\n";
+            }
+        }
+    }
+
+    std::vector<Program> m_Programs;
+    GetProgramBinaryProc m_GetProgramBinary = nullptr;
+    ProgramBinaryProc m_ProgramBinary = nullptr;
+    ProgramParameteriProc m_ProgramParameteri = nullptr;
+    bool m_BinaryCache = false;
+    uint64_t m_DriverHash = 0;
+    unsigned int m_Compiled = 0;
+    unsigned int m_CacheHits = 0;
+};
+
+#endif //PROJECT_BASE_SHADERLIBRARY_H
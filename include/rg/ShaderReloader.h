@@ -0,0 +1,229 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_SHADERRELOADER_H
+#define PROJECT_BASE_SHADERRELOADER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <rg/AllocationCounter.h>
+#include <rg/ShaderLibrary.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Shader hot reload without stalling the render loop.
+// An inotify watch on the shader directory reports saved files; every compiled variant of the library that
+// reads such a file (directly or through #include) is preprocessed again and handed to a worker thread.
+// The worker owns a hidden window whose context shares objects with the main one, so the driver compiles
+// and links there while the main thread keeps rendering with the old program. When the worker's fence
+// has signaled, update() swaps the new program into the variant between two frames; if compiling or
+// linking failed the old program stays and the error is kept for the UI.
+class ShaderReloader {
+public:
+    ShaderReloader() = default;
+    ShaderReloader(const ShaderReloader &) = delete;
+    ShaderReloader &operator=(const ShaderReloader &) = delete;
+
+    ~ShaderReloader() {
+        stop();
+    }
+
+    // call on the main thread with the main context current; returns false if watching is not possible here
+    bool start(GLFWwindow *mainWindow, ShaderLibrary &library, const std::string &directory) {
+#ifdef __linux__
+        m_Library = &library;
+        m_Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_Notify < 0 || inotify_add_watch(m_Notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cout << "ERROR::SHADER_RELOADER cannot watch " << directory << std::endl;
+            stop();
+            return false;
+        }
+        // 1x1 invisible window, only its context is used
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        m_Context = glfwCreateWindow(1, 1, "shader compiler", NULL, mainWindow);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (m_Context == NULL) {
+            std::cout << "ERROR::SHADER_RELOADER cannot create the shared context" << std::endl;
+            stop();
+            return false;
+        }
+        m_Stop = false;
+        m_Worker = std::thread(&ShaderReloader::work, this);
+        return true;
+#else
+        std::cout << "shader hot reload needs inotify, disabled" << std::endl;
+        return false;
+#endif
+    }
+
+    // once per frame on the main thread, between two frames
+    void update() {
+        if (m_Library == nullptr)
+            return;
+        queueChanged();
+        swapFinished();
+    }
+
+    bool busy() const { return m_InFlight > 0; }
+
+    unsigned int reloadCount() const { return m_Reloaded; }
+
+    unsigned int failedCount() const { return m_Failed; }
+
+    // compiler log of the last failed reload, empty once a reload succeeded again
+    const std::string &lastError() const { return m_LastError; }
+
+    // main thread, before the main context and the library are destroyed
+    void stop() {
+        if (m_Worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stop = true;
+            }
+            m_Wake.notify_one();
+            m_Worker.join();
+        }
+        // programs that finished but were never swapped in
+        for (Job &job: m_Done) {
+            glDeleteSync(job.fence);
+            glDeleteProgram(job.program);
+        }
+        m_Done.clear();
+        m_Queue.clear();
+        m_InFlight = 0;
+        if (m_Context != NULL) {
+            glfwDestroyWindow(m_Context);
+            m_Context = NULL;
+        }
+#ifdef __linux__
+        if (m_Notify >= 0) {
+            close(m_Notify);
+            m_Notify = -1;
+        }
+#endif
+        m_Library = nullptr;
+    }
+
+private:
+    struct Job {
+        ShaderLibrary::Source source;
+        unsigned int program = 0;
+        std::string log;
+        GLsync fence = 0;
+    };
+
+    // drains the inotify events and queues a rebuild of every variant that uses a changed file
+    void queueChanged() {
+#ifdef __linux__
+        // editors often write a file several times per save, every name is handled once per frame
+        std::vector<std::string> changed;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(m_Notify, buffer, sizeof(buffer))) > 0) {
+            for (char *p = buffer; p < buffer + length;) {
+                const inotify_event *event = (const inotify_event *) p;
+                if (event->len > 0 && std::find(changed.begin(), changed.end(), event->name) == changed.end())
+                    changed.push_back(event->name);
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        std::vector<std::pair<ShaderLibrary::ProgramHandle, unsigned int>> variants;
+        for (const std::string &name: changed) {
+            for (const auto &variant: m_Library->dependents(name)) {
+                if (std::find(variants.begin(), variants.end(), variant) == variants.end())
+                    variants.push_back(variant);
+            }
+        }
+        if (variants.empty())
+            return;
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (const auto &variant: variants) {
+            Job job;
+            // reading the files is cheap, the library is only touched on the main thread
+            job.source = m_Library->source(variant.first, variant.second);
+            m_Queue.push_back(std::move(job));
+            m_InFlight++;
+        }
+        m_Wake.notify_one();
+#endif
+    }
+
+    // swaps in the programs whose compilation the GPU has finished, in the order they were queued
+    void swapFinished() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (!m_Done.empty()) {
+            Job &job = m_Done.front();
+            // never waits: a program that is not done yet is picked up next frame
+            if (job.fence != 0) {
+                if (glClientWaitSync(job.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                    break;
+                glDeleteSync(job.fence);
+            }
+            if (job.program != 0) {
+                m_Library->replace(job.source, job.program);
+                m_Reloaded++;
+                m_LastError.clear();
+                std::cout << "reloaded " << job.source.vertexName << " + " << job.source.fragmentName << std::endl;
+            } else {
+                // the old program keeps rendering
+                m_Failed++;
+                m_LastError = job.source.fragmentName + "\n" + job.log;
+            }
+            m_Done.pop_front();
+            m_InFlight--;
+        }
+    }
+
+    void work() {
+        // links whenever a shader is saved, not part of any frame
+        AllocationCounter::markBackgroundThread();
+        glfwMakeContextCurrent(m_Context);
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true) {
+            m_Wake.wait(lock, [this]() { return m_Stop || !m_Queue.empty(); });
+            if (m_Stop)
+                break;
+            Job job = std::move(m_Queue.front());
+            m_Queue.pop_front();
+            lock.unlock();
+
+            job.program = m_Library->link(job.source, &job.log);
+            // the main context may only use the program once the commands building it have executed
+            job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+
+            lock.lock();
+            m_Done.push_back(std::move(job));
+        }
+        lock.unlock();
+        glfwMakeContextCurrent(NULL);
+    }
+
+    ShaderLibrary *m_Library = nullptr;
+    GLFWwindow *m_Context = NULL;
+    int m_Notify = -1;
+    std::thread m_Worker;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    bool m_Stop = false;
+    std::deque<Job> m_Queue;
+    std::deque<Job> m_Done;
+    unsigned int m_InFlight = 0;
+    unsigned int m_Reloaded = 0;
+    unsigned int m_Failed = 0;
+    std::string m_LastError;
+};
+
+#endif //PROJECT_BASE_SHADERRELOADER_H
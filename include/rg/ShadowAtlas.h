@@ -0,0 +1,122 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_SHADOWATLAS_H
+#define PROJECT_BASE_SHADOWATLAS_H
+
+#include <algorithm>
+#include <vector>
+
+// square region of a shadow atlas, in texels; size 0 means no tile
+struct ShadowTile {
+    int x = 0;
+    int y = 0;
+    int size = 0;
+
+    bool valid() const { return size > 0; }
+};
+
+// Hands out square power-of-two tiles of one square atlas texture (a quadtree buddy allocator, no GL here).
+// A tile is split off a bigger free block by halving it; release() merges it back with its three siblings
+// once they are all free, so allocating and releasing lights in any order doesn't fragment the atlas.
+// Free blocks are kept in one list per level; level 0 is the whole atlas.
+class ShadowAtlas {
+public:
+    void reset(int size, int minTileSize) {
+        m_Size = size;
+        m_MinTileSize = std::min(minTileSize, size);
+        int levels = 1;
+        while ((size >> (levels - 1)) > m_MinTileSize)
+            levels++;
+        m_Free.assign(levels, std::vector<ShadowTile>());
+        ShadowTile whole;
+        whole.size = size;
+        m_Free[0].push_back(whole);
+        m_UsedArea = 0;
+    }
+
+    // a tile of at least size texels (rounded up to a power of two, not smaller than the minimum); an invalid
+    // tile when no free block is that big
+    ShadowTile allocate(int size) {
+        if (size > m_Size || m_Free.empty())
+            return ShadowTile();
+        int level = levelOf(std::max(size, m_MinTileSize));
+        // the smallest free block that still fits
+        int from = level;
+        while (from >= 0 && m_Free[from].empty())
+            from--;
+        if (from < 0)
+            return ShadowTile();
+        ShadowTile tile = m_Free[from].back();
+        m_Free[from].pop_back();
+        // keeps the lower left quarter at every split, the other three become free
+        while (from < level) {
+            from++;
+            tile.size /= 2;
+            m_Free[from].push_back(child(tile, tile.size, 0));
+            m_Free[from].push_back(child(tile, 0, tile.size));
+            m_Free[from].push_back(child(tile, tile.size, tile.size));
+        }
+        m_UsedArea += (long long) tile.size * tile.size;
+        return tile;
+    }
+
+    void release(ShadowTile tile) {
+        if (!tile.valid())
+            return;
+        m_UsedArea -= (long long) tile.size * tile.size;
+        int level = levelOf(tile.size);
+        while (level > 0) {
+            int parentSize = tile.size * 2;
+            ShadowTile parent;
+            parent.x = tile.x - tile.x % parentSize;
+            parent.y = tile.y - tile.y % parentSize;
+            parent.size = parentSize;
+            std::vector<ShadowTile> &free = m_Free[level];
+            // the siblings are the quarters of the parent other than this tile
+            int siblings = 0;
+            for (const ShadowTile &block: free)
+                siblings += block.x - parent.x < parentSize && block.x >= parent.x
+                            && block.y - parent.y < parentSize && block.y >= parent.y;
+            if (siblings < 3)
+                break;
+            free.erase(std::remove_if(free.begin(), free.end(), [&](const ShadowTile &block) {
+                return block.x >= parent.x && block.x < parent.x + parentSize
+                       && block.y >= parent.y && block.y < parent.y + parentSize;
+            }), free.end());
+            tile = parent;
+            level--;
+        }
+        m_Free[level].push_back(tile);
+    }
+
+    int size() const { return m_Size; }
+
+    // share of the atlas area handed out, 0..1
+    float usage() const { return m_Size > 0 ? (float) ((double) m_UsedArea / ((double) m_Size * m_Size)) : 0.0f; }
+
+private:
+    // deepest level whose blocks are still at least size texels
+    int levelOf(int size) const {
+        int level = 0;
+        while ((m_Size >> (level + 1)) >= size && level + 1 < (int) m_Free.size())
+            level++;
+        return level;
+    }
+
+    static ShadowTile child(const ShadowTile &tile, int dx, int dy) {
+        ShadowTile result;
+        result.x = tile.x + dx;
+        result.y = tile.y + dy;
+        result.size = tile.size;
+        return result;
+    }
+
+    std::vector<std::vector<ShadowTile>> m_Free;
+    long long m_UsedArea = 0;
+    int m_Size = 0;
+    int m_MinTileSize = 0;
+};
+
+#endif //PROJECT_BASE_SHADOWATLAS_H
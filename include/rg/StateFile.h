@@ -0,0 +1,244 @@
+//
+// Created by mi19123 on 19.10.26..
+//
+
+#ifndef PROJECT_BASE_STATEFILE_H
+#define PROJECT_BASE_STATEFILE_H
+
+#include <glm/glm.hpp>
+#include <rg/AllocationCounter.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Tagged key/value state file, one "key value..." per line after a "version N" line.
+// Readers take the keys they know and keep defaults for missing ones, so older files load in newer builds;
+// keys a build doesn't know are kept and written back unchanged, so a newer file survives an older build.
+// Floats are written with enough digits to read back bit-exact. save() writes a temporary file next to the
+// target and renames it over, so a crash mid-write leaves the previous file intact.
+class StateFile {
+public:
+    // false if the file is missing or has no version line (e.g. a legacy file)
+    bool load(const std::string &path) {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        return parse(buffer.str());
+    }
+
+    bool parse(const std::string &text) {
+        m_Values.clear();
+        m_Version = 0;
+        std::istringstream in(text);
+        std::string line;
+        bool first = true;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            size_t split = line.find(' ');
+            std::string key = line.substr(0, split);
+            std::string value = split == std::string::npos ? std::string() : line.substr(split + 1);
+            if (first) {
+                if (key != "version")
+                    return false;
+                m_Version = std::atoi(value.c_str());
+                first = false;
+                continue;
+            }
+            m_Values[key] = value;
+        }
+        return !first;
+    }
+
+    std::string serialize(int version) const {
+        std::ostringstream out;
+        out << "version " << version << '\n';
+        for (const auto &entry: m_Values)
+            out << entry.first << ' ' << entry.second << '\n';
+        return out.str();
+    }
+
+    // version the file was written with, 0 before a successful load
+    int version() const { return m_Version; }
+
+    bool has(const std::string &key) const { return m_Values.count(key) != 0; }
+
+    void set(const std::string &key, float value) { m_Values[key] = format(&value, 1); }
+
+    void set(const std::string &key, const glm::vec3 &value) { m_Values[key] = format(&value.x, 3); }
+
+    void set(const std::string &key, int value) { m_Values[key] = std::to_string(value); }
+
+    void set(const std::string &key, bool value) { m_Values[key] = value ? "1" : "0"; }
+
+    void set(const std::string &key, const std::string &value) { m_Values[key] = value; }
+
+    // leave value untouched when the key is missing or malformed
+    bool get(const std::string &key, float &value) const { return read(key, &value, 1); }
+
+    bool get(const std::string &key, glm::vec3 &value) const { return read(key, &value.x, 3); }
+
+    bool get(const std::string &key, int &value) const {
+        auto found = m_Values.find(key);
+        if (found == m_Values.end())
+            return false;
+        std::istringstream in(found->second);
+        int parsed;
+        if (!(in >> parsed))
+            return false;
+        value = parsed;
+        return true;
+    }
+
+    bool get(const std::string &key, bool &value) const {
+        int parsed = value;
+        if (!get(key, parsed))
+            return false;
+        value = parsed != 0;
+        return true;
+    }
+
+    bool get(const std::string &key, std::string &value) const {
+        auto found = m_Values.find(key);
+        if (found == m_Values.end())
+            return false;
+        value = found->second;
+        return true;
+    }
+
+    bool save(const std::string &path, int version) const {
+        return writeAtomically(path, serialize(version));
+    }
+
+    // temp file + rename; rename replaces the target in one step on POSIX
+    static bool writeAtomically(const std::string &path, const std::string &contents) {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out << contents;
+            out.flush();
+            if (!out)
+                return false;
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            // Windows refuses to rename over an existing file
+            std::remove(path.c_str());
+            if (std::rename(temporary.c_str(), path.c_str()) != 0)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    static std::string format(const float *values, int count) {
+        std::ostringstream out;
+        out << std::setprecision(9);
+        for (int i = 0; i < count; i++)
+            out << (i ? " " : "") << values[i];
+        return out.str();
+    }
+
+    bool read(const std::string &key, float *values, int count) const {
+        auto found = m_Values.find(key);
+        if (found == m_Values.end())
+            return false;
+        std::istringstream in(found->second);
+        float parsed[4];
+        for (int i = 0; i < count; i++) {
+            if (!(in >> parsed[i]))
+                return false;
+        }
+        for (int i = 0; i < count; i++)
+            values[i] = parsed[i];
+        return true;
+    }
+
+    std::map<std::string, std::string> m_Values;
+    int m_Version = 0;
+};
+
+// Writes state snapshots on a background thread so the render loop never waits on the disk.
+// The caller serializes on its own thread (cheap) and submit()s the text; only the newest pending
+// snapshot is written, older ones are dropped.
+class StateAutosave {
+public:
+    StateAutosave() = default;
+    StateAutosave(const StateAutosave &) = delete;
+    StateAutosave &operator=(const StateAutosave &) = delete;
+
+    ~StateAutosave() { stop(); }
+
+    void start() {
+        if (m_Thread.joinable())
+            return;
+        m_Stop = false;
+        m_Thread = std::thread([this]() { run(); });
+    }
+
+    // writes whatever is still pending before returning
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_Wake.notify_one();
+        if (m_Thread.joinable())
+            m_Thread.join();
+    }
+
+    void submit(const std::string &path, std::string contents) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Path = path;
+            m_Pending = std::move(contents);
+            m_HasPending = true;
+        }
+        m_Wake.notify_one();
+    }
+
+    unsigned int saves() const { return m_Saves; }
+
+private:
+    void run() {
+        // writes whenever a snapshot comes, not part of any frame
+        AllocationCounter::markBackgroundThread();
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true) {
+            m_Wake.wait(lock, [this]() { return m_Stop || m_HasPending; });
+            if (m_HasPending) {
+                std::string path = m_Path, contents;
+                contents.swap(m_Pending);
+                m_HasPending = false;
+                lock.unlock();
+                if (StateFile::writeAtomically(path, contents))
+                    m_Saves++;
+                lock.lock();
+                continue;
+            }
+            if (m_Stop)
+                return;
+        }
+    }
+
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    std::string m_Path;
+    std::string m_Pending;
+    bool m_HasPending = false;
+    bool m_Stop = false;
+    std::atomic<unsigned int> m_Saves{0};
+};
+
+#endif //PROJECT_BASE_STATEFILE_H
@@ -11,6 +11,9 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// depth.vs racuna poziciju istim izrazom, pa dubina iz depth pre-pass-a tacno odgovara (GL_EQUAL)
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
@@ -7,12 +7,30 @@ uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
 uniform float exposure;
+// deo teksture u koji je scena renderovana, ostatak se rasteze preko celog prozora
+uniform vec2 uvScale = vec2(1.0);
+
+#ifdef OVERDRAW
+// broj sejdovanih fragmenata po pikselu: 0 crno, 1 plavo, 2 zeleno, 3 zuto, 4 i vise crveno
+vec3 Heat(float count)
+{
+    const vec3 colors[5] = vec3[](vec3(0.0), vec3(0.0, 0.2, 1.0), vec3(0.0, 0.9, 0.2), vec3(1.0, 0.9, 0.0), vec3(1.0, 0.0, 0.0));
+    float x = clamp(count, 0.0, 4.0);
+    int i = int(min(floor(x), 3.0));
+    return mix(colors[i], colors[i + 1], x - float(i));
+}
+#endif
 
 void main()
 {
     const float gamma = 1.3;
-    vec3 hdrColor = texture(scene, TexCoords).rgb;
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
+    vec2 uv = TexCoords * uvScale;
+#ifdef OVERDRAW
+    FragColor = vec4(Heat(texture(scene, uv).r), 1.0);
+    return;
+#endif
+    vec3 hdrColor = texture(scene, uv).rgb;
+    vec3 bloomColor = texture(bloomBlur, uv).rgb;
     if(bloom){
         hdrColor += bloomColor;
         vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
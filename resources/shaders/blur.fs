@@ -7,25 +7,33 @@ uniform sampler2D image;
 
 uniform bool horizontal;
 uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162); //values from gaussian curve
+// deo teksture u koji je scena renderovana (render scale), van njega su stari podaci
+uniform vec2 uvScale = vec2(1.0);
+
+vec3 sampleImage(vec2 uv, vec2 tex_offset)
+{
+     return texture(image, clamp(uv, vec2(0.0), uvScale - 0.5 * tex_offset)).rgb;
+}
 
 void main()
 {
      vec2 tex_offset = 1.0 / textureSize(image, 0);
-     vec3 result = texture(image, TexCoords).rgb * weight[0];
+     vec2 uv = TexCoords * uvScale;
+     vec3 result = sampleImage(uv, tex_offset) * weight[0];
      if(horizontal)
      {
          for(int i = 1; i < 5; ++i)
          {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+            result += sampleImage(uv + vec2(tex_offset.x * i, 0.0), tex_offset) * weight[i];
+            result += sampleImage(uv - vec2(tex_offset.x * i, 0.0), tex_offset) * weight[i];
          }
      }
      else
      {
          for(int i = 1; i < 5; ++i)
          {
-             result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-             result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+             result += sampleImage(uv + vec2(0.0, tex_offset.y * i), tex_offset) * weight[i];
+             result += sampleImage(uv - vec2(0.0, tex_offset.y * i), tex_offset) * weight[i];
          }
      }
      FragColor = vec4(result, 1.0);
@@ -0,0 +1,15 @@
+#version 330 core
+// svetli delovi osvetljene scene za bloom (deferred put; forward ih pise direktno iz 2.model_lighting.fs)
+layout (location = 0) out vec4 BrightColor;
+
+uniform sampler2D scene;
+
+void main()
+{
+    vec3 result = texelFetch(scene, ivec2(gl_FragCoord.xy), 0).rgb;
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if(brightness > 0.9)
+        BrightColor = vec4(result, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
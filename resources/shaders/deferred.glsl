@@ -0,0 +1,40 @@
+// citanje G-buffer-a u deferred prolazima osvetljenja (deferred_directional.fs, deferred_point.fs)
+#include "lights.glsl"
+
+layout (location = 0) out vec4 FragColor;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+// velicina renderovanog dela meta (dinamicka rezolucija) i inverzna projection * view za rekonstrukciju pozicije
+uniform vec2 renderSize;
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPosition;
+uniform float shininess;
+
+#include "shadows.glsl"
+#include "occlusion.glsl"
+
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 diffuseColor;
+    vec3 specularColor;
+};
+
+// false za piksele u kojima nema geometrije (tu kasnije ide nebo)
+bool ReadGBuffer(out Surface surface)
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    if (depth >= 1.0)
+        return false;
+    vec4 ndc = vec4(gl_FragCoord.xy / renderSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * ndc;
+    surface.position = world.xyz / world.w;
+    surface.normal = texelFetch(gNormal, texel, 0).xyz;
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, texel, 0);
+    surface.diffuseColor = albedoSpec.rgb;
+    surface.specularColor = vec3(albedoSpec.a);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#version 330 core
+// deferred: usmereno svetlo (sa senkama kad je SHADOWS, ambijent sa SSAO) i baterijska lampa (SPOTLIGHT) preko celog ekrana,
+// point svetla dodaje deferred_point.fs
+#include "deferred.glsl"
+
+uniform DirLight dirLight;
+#ifdef SPOTLIGHT
+uniform SpotLight spotLight;
+#endif
+
+void main()
+{
+    Surface surface;
+    if (!ReadGBuffer(surface))
+        discard;
+    vec3 viewDir = normalize(viewPosition - surface.position);
+    float shadow = DirShadow(surface.position, surface.normal, normalize(-dirLight.direction));
+    vec3 result = CalcDirLight(dirLight, surface.normal, viewDir, surface.diffuseColor, surface.specularColor, shininess, shadow,
+                               AmbientOcclusion());
+#ifdef SPOTLIGHT
+    result += CalcSpotLight(spotLight, surface.normal, surface.position, viewDir, surface.diffuseColor, surface.specularColor, shininess);
+#endif
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
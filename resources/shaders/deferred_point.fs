@@ -0,0 +1,20 @@
+#version 330 core
+// deferred: jedno point svetlo, samo za piksele koje pokriva njegova zapremina; rezultati se sabiraju (blend ONE, ONE)
+// kljucevi (ShaderLibrary): POINT_SHADOWS - senka svetla iz atlasa, lightIndex bira njegove strane; SSAO - zaklonjenost ambijenta
+#include "deferred.glsl"
+
+uniform PointLight light;
+// domet posle kog je doprinos svetla zanemarljiv (isti kao poluprecnik zapremine)
+uniform float radius;
+// redni broj svetla u nizovima senki (POINT_SHADOWS)
+uniform int lightIndex;
+
+void main()
+{
+    Surface surface;
+    if (!ReadGBuffer(surface) || distance(surface.position, light.position) > radius)
+        discard;
+    vec3 viewDir = normalize(viewPosition - surface.position);
+    FragColor = vec4(CalcPointLight(light, surface.normal, surface.position, viewDir, surface.diffuseColor, surface.specularColor, shininess,
+                                      PointShadow(lightIndex, surface.position, surface.normal), AmbientOcclusion()), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 330 core
+// samo dubina, nema izlaza boje
+
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330 core
+// depth pre-pass: samo pozicije (Mesh::DrawDepth)
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// isti izraz kao u 2.model_lighting.vs, glavni prolaz testira dubinu sa GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    vec3 fragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
\ No newline at end of file
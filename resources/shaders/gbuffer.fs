@@ -0,0 +1,24 @@
+#version 330 core
+// G-buffer za deferred osvetljenje (RGBA16F mete iz RenderTargets):
+// gAlbedoSpec.rgb: difuzna boja, .a: jacina spekulara (prosek spekularne mape); gNormal.xyz: normala u svetu
+// pozicija se ne cuva, deferred.glsl je racuna iz dubine
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormal;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform Material material;
+
+void main()
+{
+    vec3 specularColor = texture(material.texture_specular1, TexCoords).rgb;
+    gAlbedoSpec = vec4(texture(material.texture_diffuse1, TexCoords).rgb, dot(specularColor, vec3(1.0 / 3.0)));
+    gNormal = vec4(normalize(Normal), 0.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+// Hi-Z izvor: najdalja dubina scene ispod svakog teksela male mete (cita se na CPU, HiZBuffer gradi piramidu)
+layout (location = 0) out float MaxDepth;
+
+uniform sampler2D depth;
+// koliko teksela dubine (renderovanog dela) pokriva jedan izlazni teksel
+uniform vec2 scale;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 start = ivec2(floor(vec2(texel) * scale));
+    ivec2 end = max(ivec2(ceil(vec2(texel + 1) * scale)), start + 1);
+    float farthest = 0.0;
+    for (int y = start.y; y < end.y; y++)
+        for (int x = start.x; x < end.x; x++)
+            farthest = max(farthest, texelFetch(depth, ivec2(x, y), 0).r);
+    MaxDepth = farthest;
+}
\ No newline at end of file
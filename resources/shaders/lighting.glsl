@@ -0,0 +1,52 @@
+// zajednicki deo 2.model_lighting.fs i transparent.fs: ulazi, materijal i osvetljenje fragmenta (izlaze deklarise svaki shader sam)
+// kljucevi (ShaderLibrary): SPOTLIGHT - baterijska lampa, SHADOWS - senke usmerenog svetla, POINT_SHADOWS - senke point svetala,
+// SSAO - ambijentalna zaklonjenost
+// konstante: NR_POINT_LIGHTS
+#include "lights.glsl"
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    float shininess;
+};
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform vec3 viewPosition;
+uniform DirLight dirLight;
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+#ifdef SPOTLIGHT
+uniform SpotLight spotLight;
+#endif
+uniform Material material;
+
+#include "shadows.glsl"
+#include "occlusion.glsl"
+
+// ukupno osvetljenje fragmenta; teksture se citaju jednom, a ne u svakoj f-ji svetla
+vec3 CalcLighting()
+{
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 diffuseColor = texture(material.texture_diffuse1, TexCoords).rgb;
+    vec3 specularColor = texture(material.texture_specular1, TexCoords).rgb;
+    float occlusion = AmbientOcclusion();
+    //dirlight
+    float shadow = DirShadow(FragPos, norm, normalize(-dirLight.direction));
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, diffuseColor, specularColor, material.shininess, shadow, occlusion);
+    //pointlight
+    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir, diffuseColor, specularColor, material.shininess,
+                                 PointShadow(i, FragPos, norm), occlusion);
+#ifdef SPOTLIGHT
+    //spotlight
+    result += CalcSpotLight(spotLight, norm, FragPos, viewDir, diffuseColor, specularColor, material.shininess);
+#endif
+    return result;
+}
\ No newline at end of file
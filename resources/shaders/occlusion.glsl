@@ -0,0 +1,16 @@
+// ambijentalna zaklonjenost iz SSAO prolaza (ssao.fs, ssao_upsample.fs), za forward i deferred osvetljenje
+// kljucevi (ShaderLibrary): SSAO - bez njega AmbientOcclusion uvek vraca 1
+#ifdef SSAO
+// isti raspored kao ciljevi scene: piksel renderovanog dela je isti teksel
+uniform sampler2D ambientOcclusion;
+#endif
+
+// udeo ambijentalnog svetla koji stize do piksela (0 - potpuno zaklonjen, 1 - otvoren)
+float AmbientOcclusion()
+{
+#ifdef SSAO
+    return texelFetch(ambientOcclusion, ivec2(gl_FragCoord.xy), 0).r;
+#else
+    return 1.0;
+#endif
+}
@@ -0,0 +1,28 @@
+#version 330 core
+// sklapa providne slojeve (transparent.fs) preko hdr scene, pre bloom-a
+// BLOOM - svetli delovi providnih objekata idu i u drugi izlaz
+layout (location = 0) out vec4 FragColor;
+#ifdef BLOOM
+layout (location = 1) out vec4 BrightColor;
+#endif
+
+uniform sampler2D accum;
+uniform sampler2D weight;
+
+void main()
+{
+    // iste dimenzije kao hdr tekstura, citamo isti piksel
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accumulated = texelFetch(accum, texel, 0);
+    float revealage = accumulated.a;
+    // nijedan providni fragment ovde, scena ostaje netaknuta
+    if (revealage > 0.9999)
+        discard;
+    vec3 color = accumulated.rgb / max(texelFetch(weight, texel, 0).r, 1e-5);
+    // blend SRC_ALPHA, ONE_MINUS_SRC_ALPHA: scena se vidi kroz revealage
+    FragColor = vec4(color, 1.0 - revealage);
+#ifdef BLOOM
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    BrightColor = vec4(brightness > 0.9 ? color : vec3(0.0), 1.0 - revealage);
+#endif
+}
\ No newline at end of file
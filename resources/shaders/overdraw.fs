@@ -0,0 +1,9 @@
+#version 330 core
+// debug prikaz overdraw-a: svaki fragment koji prodje depth test dodaje 1 (blend ONE, ONE),
+// bloom_final.fs sa OVERDRAW boji broj sejdovanja po pikselu
+layout (location = 0) out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(1.0, 0.0, 0.0, 0.0);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+// senke usmerenog svetla iz kaskadne shadow mape (CascadedShadowMap) i point svetala iz atlasa (PointShadowMaps),
+// za forward i deferred osvetljenje
+// kljucevi (ShaderLibrary): SHADOWS - bez njega DirShadow uvek vraca 1, POINT_SHADOWS - isto za PointShadow
+// ukljucuje se posle deklaracije viewPosition
+#ifdef SHADOWS
+#define MAX_CASCADES 4
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+// udaljenost duz pravca kamere na kojoj se kaskada zavrsava i velicina njenog teksela u svetu
+uniform float cascadeSplits[MAX_CASCADES];
+uniform float cascadeTexelSizes[MAX_CASCADES];
+uniform int cascadeCount;
+uniform vec3 viewForward;
+#endif
+
+// udeo direktnog usmerenog svetla koji stize do tacke (0 - u senci, 1 - osvetljena)
+float DirShadow(vec3 fragPos, vec3 normal, vec3 lightDir)
+{
+#ifdef SHADOWS
+    float depth = dot(fragPos - viewPosition, viewForward);
+    if (depth > cascadeSplits[cascadeCount - 1])
+        return 1.0;
+    int cascade = 0;
+    while (cascade < cascadeCount - 1 && depth > cascadeSplits[cascade])
+        cascade++;
+    // pomeraj duz normale za teksel-dva kaskade, veci sto svetlo pada koso; dubina iz mape onda ne zaklanja samu povrsinu
+    float slope = 1.0 - clamp(dot(normal, lightDir), 0.0, 1.0);
+    vec3 position = fragPos + normal * cascadeTexelSizes[cascade] * (0.5 + 1.5 * slope);
+    vec3 coord = (cascadeMatrices[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+    // 3x3 PCF, svaki uzorak je vec 2x2 zbog linearnog filtera sa poredjenjem dubine
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec4(coord.xy + vec2(x, y) / vec2(textureSize(shadowMap, 0).xy), cascade, coord.z));
+    return lit / 9.0;
+#else
+    return 1.0;
+#endif
+}
+
+#ifdef POINT_SHADOWS
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 2
+#endif
+uniform sampler2DShadow pointShadowAtlas;
+// sest strana svakog svetla redom +x, -x, +y, -y, +z, -z: matrica i deo atlasa (xy pocetak, zw velicina u uv)
+uniform mat4 pointShadowMatrices[NR_POINT_LIGHTS * 6];
+uniform vec4 pointShadowRects[NR_POINT_LIGHTS * 6];
+// pozicija sa koje su strane crtane (kes moze malo da kasni za svetlom), w = 0 za svetlo bez senke
+uniform vec4 pointShadowOrigins[NR_POINT_LIGHTS];
+#endif
+
+// udeo direktnog svetla point svetla light koji stize do tacke (0 - u senci, 1 - osvetljena)
+float PointShadow(int light, vec3 fragPos, vec3 normal)
+{
+#ifdef POINT_SHADOWS
+    vec4 origin = pointShadowOrigins[light];
+    if (origin.w == 0.0)
+        return 1.0;
+    // strana kocke je ona duz cije ose je tacka najdalje od svetla
+    vec3 toFragment = fragPos - origin.xyz;
+    vec3 axis = abs(toFragment);
+    int face;
+    if (axis.x >= axis.y && axis.x >= axis.z)
+        face = toFragment.x > 0.0 ? 0 : 1;
+    else if (axis.y >= axis.z)
+        face = toFragment.y > 0.0 ? 2 : 3;
+    else
+        face = toFragment.z > 0.0 ? 4 : 5;
+    int index = light * 6 + face;
+    vec4 rect = pointShadowRects[index];
+    vec2 atlasSize = vec2(textureSize(pointShadowAtlas, 0));
+    // teksel perspektivne strane raste sa udaljenoscu: 2 * udaljenost / broj teksela strane
+    float texel = 2.0 * length(toFragment) / (rect.z * atlasSize.x);
+    vec3 position = fragPos + normal * texel * 1.5;
+    vec4 clip = pointShadowMatrices[index] * vec4(position, 1.0);
+    vec3 coord = clip.xyz / clip.w * 0.5 + 0.5;
+    if (coord.z >= 1.0)
+        return 1.0;
+    // 4 uzorka po 2x2 (linearni filter sa poredjenjem), svi pola teksela unutar strane da se ne cita susedna
+    vec2 halfTexel = 0.5 / atlasSize;
+    vec2 center = rect.xy + coord.xy * rect.zw;
+    float lit = 0.0;
+    for (int x = 0; x < 2; x++)
+        for (int y = 0; y < 2; y++) {
+            vec2 uv = clamp(center + (vec2(x, y) - 0.5) / atlasSize, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+            lit += texture(pointShadowAtlas, vec3(uv, coord.z));
+        }
+    return lit / 4.0;
+#else
+    return 1.0;
+#endif
+}
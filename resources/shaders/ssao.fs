@@ -0,0 +1,93 @@
+#version 330 core
+// SSAO u pola rezolucije (AmbientOcclusion): zaklonjenost iz dubine scene, nagomilana kroz frejmove
+// izlaz: r - udeo ambijentalnog svetla koji stize do piksela, g - linearna dubina piksela (za uvecanje i istoriju)
+layout (location = 0) out vec4 FragColor;
+
+#define MAX_SAMPLES 32
+
+uniform sampler2D sceneDepth;
+// rezultat prethodnog frejma i deo te teksture (u uv) koji je tada bio renderovan
+uniform sampler2D history;
+uniform vec2 historyScale;
+uniform bool historyValid;
+// udeo novog frejma u rezultatu; manji - manje suma, ali sporije prati promene
+uniform float historyWeight;
+uniform mat4 previousViewProjection;
+// velicina renderovanog dela dubine (dinamicka rezolucija)
+uniform vec2 renderSize;
+uniform mat4 projection;
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+// uzorci u polusferi oko normale (z), duzine do 1
+uniform vec3 samples[MAX_SAMPLES];
+uniform int sampleCount;
+uniform float radius;
+uniform float bias;
+uniform float intensity;
+uniform int frame;
+
+// pozicija u prostoru kamere iz dubine jednog teksela
+vec3 ViewPosition(ivec2 texel)
+{
+    float depth = texelFetch(sceneDepth, texel, 0).r;
+    vec4 ndc = vec4((vec2(texel) + 0.5) / renderSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 position = inverseProjection * ndc;
+    return position.xyz / position.w;
+}
+
+void main()
+{
+    ivec2 lastTexel = ivec2(renderSize) - 1;
+    // piksel pola rezolucije uzima dubinu donjeg levog od svoja cetiri
+    ivec2 texel = min(ivec2(gl_FragCoord.xy) * 2, lastTexel);
+    if (texelFetch(sceneDepth, texel, 0).r >= 1.0) {
+        // nebo: nezaklonjeno, dubina 0 odbacuje ga kao istoriju
+        FragColor = vec4(1.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    vec3 position = ViewPosition(texel);
+    // normala iz dubine; po svakoj osi se uzima blizi od dva suseda, da ivica ne da kosu normalu
+    vec3 left = ViewPosition(max(texel - ivec2(1, 0), ivec2(0)));
+    vec3 right = ViewPosition(min(texel + ivec2(1, 0), lastTexel));
+    vec3 down = ViewPosition(max(texel - ivec2(0, 1), ivec2(0)));
+    vec3 up = ViewPosition(min(texel + ivec2(0, 1), lastTexel));
+    vec3 dx = abs(right.z - position.z) < abs(position.z - left.z) ? right - position : position - left;
+    vec3 dy = abs(up.z - position.z) < abs(position.z - down.z) ? up - position : position - down;
+    vec3 normal = normalize(cross(dx, dy));
+
+    // kernel se okrece oko normale za ugao koji zavisi od piksela (interleaved gradient noise) i od frejma,
+    // pa se sum razlikuje iz frejma u frejm i istorija ga usrednjava
+    float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))) + float(frame) * 0.618034);
+    float angle = noise * 6.2831853;
+    vec3 randomDirection = vec3(cos(angle), sin(angle), 0.0);
+    vec3 tangent = randomDirection - normal * dot(randomDirection, normal);
+    tangent = dot(tangent, tangent) > 1e-4 ? normalize(tangent) : normalize(cross(normal, vec3(0.0, 1.0, 0.0)));
+    mat3 tbn = mat3(tangent, cross(normal, tangent), normal);
+
+    float occlusion = 0.0;
+    for (int i = 0; i < sampleCount; i++) {
+        vec3 samplePosition = position + tbn * samples[i] * radius;
+        vec4 clip = projection * vec4(samplePosition, 1.0);
+        vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+        ivec2 sampleTexel = clamp(ivec2(uv * renderSize), ivec2(0), lastTexel);
+        float sceneZ = ViewPosition(sampleTexel).z;
+        // geometrija daleko ispred tacke (npr. ivica objekta) ne zaklanja
+        float rangeCheck = smoothstep(0.0, 1.0, radius / abs(position.z - sceneZ));
+        occlusion += (sceneZ >= samplePosition.z + bias ? 1.0 : 0.0) * rangeCheck;
+    }
+    float ambient = pow(1.0 - occlusion / float(max(sampleCount, 1)), intensity);
+
+    float linearDepth = -position.z;
+    if (historyValid) {
+        // gde je ista tacka bila u prethodnom frejmu; w projekcije je tada njena linearna dubina
+        vec4 previousClip = previousViewProjection * (inverseView * vec4(position, 1.0));
+        vec2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+        if (all(greaterThanEqual(previousUV, vec2(0.0))) && all(lessThanEqual(previousUV, vec2(1.0)))) {
+            vec2 previous = texture(history, previousUV * historyScale).rg;
+            // istorija vazi samo ako je tamo bila ista povrsina
+            if (abs(previous.g - previousClip.w) < 0.05 * previousClip.w)
+                ambient = mix(previous.r, ambient, historyWeight);
+        }
+    }
+    FragColor = vec4(ambient, linearDepth, 0.0, 1.0);
+}
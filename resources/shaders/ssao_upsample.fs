@@ -0,0 +1,39 @@
+#version 330 core
+// bilateralno uvecanje SSAO na punu rezoluciju: od cetiri najbliza teksela pola rezolucije vise teze oni cija je
+// dubina bliska dubini piksela, pa zaklonjenost ne curi preko ivica objekata
+layout (location = 0) out vec4 FragColor;
+
+uniform sampler2D sceneDepth;
+// r - zaklonjenost, g - linearna dubina (ssao.fs)
+uniform sampler2D occlusion;
+uniform ivec2 occlusionSize;
+uniform vec2 renderSize;
+uniform mat4 inverseProjection;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(sceneDepth, texel, 0).r;
+    if (depth >= 1.0) {
+        FragColor = vec4(1.0);
+        return;
+    }
+    vec4 position = inverseProjection * vec4((vec2(texel) + 0.5) / renderSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    float linearDepth = -position.z / position.w;
+    // teksel pola rezolucije h nosi vrednost punog teksela 2h
+    vec2 halfPosition = (gl_FragCoord.xy - 0.5) * 0.5;
+    ivec2 base = ivec2(floor(halfPosition));
+    vec2 f = halfPosition - vec2(base);
+    float result = 0.0;
+    float weightSum = 0.0;
+    for (int y = 0; y < 2; y++)
+        for (int x = 0; x < 2; x++) {
+            ivec2 tap = clamp(base + ivec2(x, y), ivec2(0), occlusionSize - 1);
+            vec2 value = texelFetch(occlusion, tap, 0).rg;
+            float bilinear = (x == 1 ? f.x : 1.0 - f.x) * (y == 1 ? f.y : 1.0 - f.y);
+            float weight = (bilinear + 0.001) / (0.001 + abs(linearDepth - value.g) / linearDepth);
+            result += value.r * weight;
+            weightSum += weight;
+        }
+    FragColor = vec4(result / weightSum, 0.0, 0.0, 1.0);
+}
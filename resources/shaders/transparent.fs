@@ -1,97 +1,21 @@
 #version 330 core
-layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
+// weighted blended OIT (McGuire & Bavoil): providni fragmenti se ne sortiraju, vec se sabiraju sa tezinom
+// koja opada sa udaljenoscu, a oit_resolve.fs ih posle sklapa preko scene
+// Accum.rgb: suma boja * alfa * tezina, Accum.a: revealage = proizvod (1 - alfa) (blend ZERO, ONE_MINUS_SRC_ALPHA)
+// Weight: suma alfa * tezina
+layout (location = 0) out vec4 Accum;
+layout (location = 1) out float Weight;
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
-
-    float shininess;
-};
-
-#define NR_POINT_LIGHTS 2
-
-in vec2 TexCoords;
-in vec3 Normal;
-in vec3 FragPos;
-
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform DirLight dirLight;
-uniform Material material;
-
-uniform vec3 viewPosition;
-
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
-}
-
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-    vec3 lightDir = normalize(-light.direction);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 normal1 = normalize(Normal);
-    vec3 halfwayDir = normalize(lightDir+ viewDir);
-    float spec = pow(max(dot(normal1, halfwayDir), 0.0), material.shininess);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-    return (ambient + diffuse + specular);
-}
+#include "lighting.glsl"
 
 void main()
 {
-    vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcDirLight(dirLight, normal, viewDir);
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-            result += CalcPointLight(pointLights[i], normal, FragPos, viewDir);
-    vec4 texColor = texture(material.texture_diffuse1, TexCoords);
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-    //ovde isto obradjujemo bloom da bi i na providne objekte bio primenjen efekat
-    if(brightness > 0.9)
-        BrightColor = vec4(result, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    vec3 result = CalcLighting();
     //ovo 0.6 nam je alfa komponenta, tj. procenat transparentnosti
-    FragColor = texture(material.texture_diffuse1, TexCoords)*vec4(result, 0.6);
-
+    vec4 color = texture(material.texture_diffuse1, TexCoords)*vec4(result, 0.6);
+    // tezina iz rada (jednacina 7), bliski fragmenti dominiraju; ogranicena da zbir ostane u opsegu RGBA16F
+    float z = length(viewPosition - FragPos);
+    float weight = color.a * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+    Accum = vec4(color.rgb * weight, color.a);
+    Weight = weight;
 }
\ No newline at end of file
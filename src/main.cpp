@@ -1,3 +1,8 @@
+// zamenjuje operator new/delete u ovoj (jedinoj) jedinici prevodjenja, da bi se brojale alokacije po frejmu;
+// mora pre svih ostalih zaglavlja, ukljucuju ga i learnopengl/mesh.h, rg/StateFile.h i rg/ShaderReloader.h
+#define RG_ALLOCATION_COUNTER_IMPLEMENTATION
+#include <rg/AllocationCounter.h>
+
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -14,15 +19,52 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#include <rg/RenderTargets.h>
+#include <rg/RenderGraph.h>
+#include <rg/DynamicResolution.h>
+#include <rg/Profiler.h>
+#include <rg/ShaderLibrary.h>
+#include <rg/ShaderReloader.h>
+#include <rg/SampleCounter.h>
+#include <rg/AABB.h>
+#include <rg/HiZBuffer.h>
+#include <rg/DepthReadback.h>
+#include <rg/DepthRasterizer.h>
+#include <rg/JobSystem.h>
+#include <rg/OccluderMesh.h>
+#include <rg/SceneGraph.h>
+#include <rg/EntityWorld.h>
+#include <rg/SceneFile.h>
+#include <rg/StateFile.h>
+#include <rg/FixedTimestep.h>
+#include <rg/CommandBuffer.h>
+#include <rg/Frustum.h>
+#include <rg/LinearAllocator.h>
+#include <rg/MemoryTracker.h>
+#include <rg/BVH.h>
+#include <rg/CascadedShadowMap.h>
+#include <rg/PointShadowMaps.h>
+#include <rg/AmbientOcclusion.h>
+#include <rg/ImageFile.h>
+#include <rg/PathTracer.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
-void processInput(GLFWwindow *window);
+struct SimulationInput;
+
+SimulationInput processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
@@ -30,9 +72,14 @@ unsigned int loadCubemap(vector<std::string> faces);
 
 void renderQuad();
 
+void destroyQuad();
+
 // settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 1200;
+// current framebuffer size, follows the window
+int windowWidth = SCR_WIDTH;
+int windowHeight = SCR_HEIGHT;
 bool spotlightOn = true;
 bool bloom = true;
 bool bloomKeyPressed = false;
@@ -56,6 +103,197 @@ struct PointLight {
     float quadratic;
 };
 
+// domet point svetla: rastojanje na kom oslabljen doprinos padne ispod 5/256 (deferred zapremina svetla)
+float PointLightRadius(const PointLight &light) {
+    float maxIntensity = std::max(std::max(light.ambient.r + light.diffuse.r + light.specular.r,
+                                           light.ambient.g + light.diffuse.g + light.specular.g),
+                                  light.ambient.b + light.diffuse.b + light.specular.b);
+    float c = light.constant - maxIntensity * 256.0f / 5.0f;
+    if (light.quadratic <= 0.0f)
+        return -c / std::max(light.linear, 0.0001f);
+    return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+}
+
+// ===================================================KOMPONENTE ENTITETA===================================================
+// polozaj, rotacija u stepenima (redom oko x, y, z) i skala; matrix = translate * scale * rotacije
+struct Transform {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    glm::mat4 matrix = glm::mat4(1.0f);
+};
+
+// njihanje oko pocetnog polozaja i okretanje stalnom brzinom
+struct Animated {
+    glm::vec3 basePosition = glm::vec3(0.0f);
+    glm::vec3 bobAmplitude = glm::vec3(0.0f);
+    float bobSpeed = 0.0f;
+    // stepeni u sekundi
+    glm::vec3 spin = glm::vec3(0.0f);
+};
+
+// Transform posle pretposlednjeg koraka simulacije; render interpolira izmedju njega i Transform
+struct PreviousTransform {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f);
+};
+
+// model scene za panel memorije; velicine se citaju iz modela pri svakom prikazu
+struct ModelMemory {
+    const char *name = "";
+    Model *model = nullptr;
+};
+
+// model i njegovi cvorovi u grafu scene
+struct Renderable {
+    Model *model = nullptr;
+    // koren instance modela i cvor svake mreze (transformacije iz aiNode hijerarhije)
+    unsigned int node = SceneGraph::NONE;
+    std::vector<unsigned int> meshNodes;
+    // occluder-i se rasterizuju na CPU kad Hi-Z ne koristi dubinu sa GPU
+    bool occluder = false;
+    // providni se crtaju u OIT prolazu, bez occlusion testa
+    bool transparent = false;
+    // kugla lampe, prati svoje point svetlo; da li je providna odredjuje transparent
+    bool lamp = false;
+    // granice svake mreze u svetu i rezultat occlusion testa ovog frejma
+    std::vector<AABB> meshBounds;
+    std::vector<unsigned char> meshVisible;
+    // neprovidni objekat koji se pomera: granice se racunaju svaki frejm iz localBounds, senke point svetala
+    // crta svaki frejm (staticni su u kesu)
+    bool dynamic = false;
+    std::vector<AABB> localBounds;
+};
+
+// isto sto i niz glm::translate, glm::scale i glm::rotate oko x, y i z, bez mnozenja cetiri matrice
+glm::mat4 ComposeTransform(const Transform &transform) {
+    float cx = std::cos(glm::radians(transform.rotation.x)), sx = std::sin(glm::radians(transform.rotation.x));
+    float cy = std::cos(glm::radians(transform.rotation.y)), sy = std::sin(glm::radians(transform.rotation.y));
+    float cz = std::cos(glm::radians(transform.rotation.z)), sz = std::sin(glm::radians(transform.rotation.z));
+    // kolone matrica rotacije oko x, y i z
+    glm::mat3 rotation = glm::mat3(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, cx, sx), glm::vec3(0.0f, -sx, cx))
+                         * glm::mat3(glm::vec3(cy, 0.0f, -sy), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(sy, 0.0f, cy))
+                         * glm::mat3(glm::vec3(cz, sz, 0.0f), glm::vec3(-sz, cz, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 matrix(1.0f);
+    for (int column = 0; column < 3; column++)
+        matrix[column] = glm::vec4(transform.scale * rotation[column], 0.0f);
+    matrix[3] = glm::vec4(transform.position, 1.0f);
+    return matrix;
+}
+
+// sistem animacije: paralelno po komadima arhetipova, samo entiteti sa Animated
+void AnimateEntities(EntityWorld &entities, JobSystem &jobs, float time) {
+    entities.parallelEach<Transform, Animated>(jobs, [time](Transform &transform, Animated &animated) {
+        transform.position = animated.basePosition + animated.bobAmplitude * std::sin(time * animated.bobSpeed);
+        transform.rotation = animated.spin * time;
+        transform.matrix = ComposeTransform(transform);
+    });
+}
+
+// korak simulacije traje 1/60 s bez obzira na brzinu renderovanja
+const double SIMULATION_STEP = 1.0 / 60.0;
+// promena ekspozicije u sekundi dok se drzi Q ili E
+const float EXPOSURE_RATE = 2.0f;
+
+// frejmovi posle pokretanja u kojima se jos pune kesevi, arene i bufferi; posle njih frejm ne sme da alocira
+const unsigned int ALLOCATION_WARMUP_FRAMES = 120;
+
+// ulaz uzorkovan jednom po frejmu na glavnoj niti; simulacija ne cita GLFW ni kameru direktno
+struct SimulationInput {
+    bool forward = false, backward = false, left = false, right = false;
+    bool exposureUp = false, exposureDown = false;
+    glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 cameraRight = glm::vec3(1.0f, 0.0f, 0.0f);
+    float cameraSpeed = 0.0f;
+};
+
+// stanje koje menja samo simulacija; glavna nit ga cita tek kad simulacija zavrsi
+struct SimulationState {
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    glm::vec3 previousCameraPosition = glm::vec3(0.0f);
+    float exposure = 1.0f;
+    unsigned int steps = 0;
+    float updateMs = 0.0f;
+};
+
+// posao jednog frejma za nit simulacije; zivi van petlje, pa lambda hvata samo jednu referencu
+// i std::function je cuva bez alokacije
+struct SimulationTask {
+    EntityWorld *entities = nullptr;
+    JobSystem *jobs = nullptr;
+    SimulationState *state = nullptr;
+    SimulationInput input;
+    unsigned int steps = 0;
+    std::uint64_t firstTick = 0;
+};
+
+// jedan korak: zavisi samo od rednog broja koraka i ulaza, pa se isti ulazi uvek isto odigraju
+void SimulateStep(EntityWorld &entities, JobSystem &jobs, SimulationState &state, const SimulationInput &input,
+                  std::uint64_t tick) {
+    float step = (float) SIMULATION_STEP;
+    state.previousCameraPosition = state.cameraPosition;
+    float velocity = input.cameraSpeed * step;
+    if (input.forward)
+        state.cameraPosition += input.cameraFront * velocity;
+    if (input.backward)
+        state.cameraPosition -= input.cameraFront * velocity;
+    if (input.left)
+        state.cameraPosition -= input.cameraRight * velocity;
+    if (input.right)
+        state.cameraPosition += input.cameraRight * velocity;
+    if (input.exposureUp)
+        state.exposure += EXPOSURE_RATE * step;
+    if (input.exposureDown)
+        state.exposure = std::max(state.exposure - EXPOSURE_RATE * step, 0.0f);
+    entities.each<Transform, PreviousTransform>([](const Transform &transform, PreviousTransform &previous) {
+        previous.position = transform.position;
+        previous.rotation = transform.rotation;
+    });
+    AnimateEntities(entities, jobs, (float) (tick * SIMULATION_STEP));
+}
+
+void DrawSceneObject(const Renderable &object, const SceneGraph &sceneGraph, Shader &shader) {
+    for (unsigned int i = 0; i < object.model->meshes.size(); i++) {
+        if (!object.meshVisible[i])
+            continue;
+        shader.setMat4("model", sceneGraph.world(object.meshNodes[i]));
+        object.model->meshes[i].Draw(shader);
+    }
+}
+
+// samo pozicije, zapisano u command buffer; modelLocation se trazi unapred na GL niti
+void RecordSceneObjectDepth(const Renderable &object, const SceneGraph &sceneGraph, int modelLocation, CommandBuffer &commands) {
+    for (unsigned int i = 0; i < object.model->meshes.size(); i++) {
+        if (!object.meshVisible[i])
+            continue;
+        const Mesh &mesh = object.model->meshes[i];
+        commands.uniform(modelLocation, sceneGraph.world(object.meshNodes[i]));
+        commands.bindVertexArray(mesh.depthVAO);
+        commands.drawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT);
+    }
+}
+
+// rezolucija Hi-Z izvora (dubina sa GPU ili CPU raster occluder-a)
+const int HIZ_WIDTH = 256;
+const int HIZ_HEIGHT = 128;
+// najvise trouglova uproscenog occluder-a za CPU raster
+const unsigned int OCCLUDER_TRIANGLES = 4096;
+// BVH mreza zavisi samo od geometrije, pa se cuva izmedju pokretanja
+const char *BVH_CACHE_DIRECTORY = "resources/bvh_cache";
+// jedinice tekstura shadow mape i atlasa senki point svetala; teksture materijala i G-buffer-a zauzimaju prve
+const int SHADOW_MAP_UNIT = 8;
+const int POINT_SHADOW_UNIT = 9;
+// jedinica teksture ambijentalne zaklonjenosti (SSAO) u prolazima osvetljenja
+const int AMBIENT_OCCLUSION_UNIT = 10;
+
+// jedna mreza jednog objekta u TLAS-u za biranje misem
+struct PickTarget {
+    // koren objekta (ime) i cvor mreze (world matrica)
+    unsigned int node;
+    unsigned int meshNode;
+    unsigned int mesh;
+};
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     glm::vec3 dirLightDir = glm::vec3(-0.2f, -1.0f, -0.3f);
@@ -65,52 +303,363 @@ struct ProgramState {
     bool CameraMouseMovementUpdateEnabled = true;
 
     vector<std::string> faces;
-    unsigned int cubemapTexture;
+    unsigned int cubemapTexture = 0;
 
     PointLight pointLight;
+    DynamicResolution dynamicResolution;
+    float renderScale = 1.0f;
+    float gpuFrameMs = 0.0f;
+    // render graph statistics, refreshed on every recompile
+    unsigned int graphPasses = 0;
+    unsigned int graphCulledPasses = 0;
+    unsigned int graphTextures = 0;
+    // depth pre-pass + GL_EQUAL u glavnom prolazu; overdraw prikaz boji koliko puta je piksel sejdovan
+    bool depthPrepass = true;
+    bool overdrawView = false;
+    // deferred: G-buffer + osvetljenje u prostoru ekrana umesto forward osvetljenja po objektu
+    bool deferred = false;
+    float overdraw = 0.0f;
+    // Hi-Z occlusion culling po mrezi; izvor je dubina prethodnih frejmova sa GPU ili CPU raster occluder-a
+    bool occlusionCulling = false;
+    bool occlusionCpuRaster = false;
+    // kaskadne senke usmerenog svetla; rezolucija i broj kaskada odredjuju cenu, kaskade pokrivaju shadowDistance
+    bool shadows = true;
+    int shadowResolution = 2048;
+    int shadowCascades = 4;
+    float shadowDistance = 40.0f;
+    float shadowSplitLambda = 0.75f;
+    unsigned int shadowCasters = 0;
+    // senke point svetala: strane kocke u atlasu, staticni deo se crta ponovo tek kad se svetlo pomeri za vise od
+    // pointShadowTolerance, najvise pointShadowBudget strana po frejmu
+    bool pointShadows = true;
+    int pointShadowAtlasSize = 2048;
+    int pointShadowResolution = 512;
+    int pointShadowBudget = 6;
+    float pointShadowTolerance = 0.05f;
+    PointShadowMaps::Stats pointShadowStats;
+    unsigned int pointShadowCasters = 0;
+    float pointShadowAtlasUsage = 0.0f;
+    // SSAO u pola rezolucije; broj uzoraka se smanjuje dok oba prolaza ne stanu u ssaoBudgetMs
+    bool ssao = true;
+    float ssaoRadius = 0.35f;
+    float ssaoBias = 0.02f;
+    float ssaoIntensity = 1.5f;
+    int ssaoMaxSamples = 16;
+    float ssaoBudgetMs = 0.5f;
+    bool ssaoTemporal = true;
+    int ssaoSamples = 0;
+    float ssaoMs = 0.0f;
+    unsigned int testedMeshes = 0;
+    unsigned int culledMeshes = 0;
+    unsigned int occluderTriangles = 0;
+    float occluderRasterMs = 0.0f;
+    unsigned int sceneNodes = 0;
+    unsigned int sceneNodesUpdated = 0;
+    unsigned int entityCount = 0;
+    unsigned int archetypeCount = 0;
+    float entityUpdateMs = 0.0f;
+    // shader hot reload
+    unsigned int shaderReloads = 0;
+    std::string shaderError;
+    // heap alokacije (operator new) u poslednjem frejmu; posle zagrevanja treba da budu 0
+    unsigned int frameAllocations = 0;
+    unsigned int frameAllocatedBytes = 0;
+    unsigned int allocatingFrames = 0;
+    unsigned int frameArenaBytes = 0;
+    // najveca zauzetost heap-a tokom ucitavanja i geometrija modela koja je ostala u RAM-u
+    std::uint64_t loadPeakBytes = 0;
+    std::vector<ModelMemory> modelMemory;
+    // gde dugme u panelu memorije upisuje JSON izvestaj
+    std::string memoryJsonPath = "memory.json";
+    // biranje objekta levim klikom: polozaj kursora (0..1) i pogodak, ime pokazuje na ime cvora u grafu scene
+    bool pickRequested = false;
+    glm::vec2 pickPosition = glm::vec2(0.0f);
+    const char *pickedName = nullptr;
+    unsigned int pickedMesh = 0;
+    unsigned int pickedTriangle = 0;
+    float pickedDistance = 0.0f;
+    float pickMs = 0.0f;
+    // stanje se cuva i u pozadini na svakih autosaveInterval sekundi
+    bool autosave = true;
+    float autosaveInterval = 10.0f;
+    // procitani fajl; kljucevi koje ova verzija ne zna se cuvaju i upisuju nazad
+    StateFile stateFile;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
+    // tekst stanja za SaveToFile ili StateAutosave
+    std::string Serialize();
+
     void SaveToFile(std::string filename);
 
     void LoadFromFile(std::string filename);
+
+    // SSAO cita dubinu pre osvetljenja; forward je dobija iz depth pre-pass-a, deferred iz G-buffer-a
+    bool UsesDepthPrepass() const { return depthPrepass || (ssao && !deferred); }
 };
 
+// verzija 1 je stari format sa 10 neoznacenih brojeva
+const int PROGRAM_STATE_VERSION = 2;
+
+std::string ProgramState::Serialize() {
+    StateFile &state = stateFile;
+    state.set("camera.position", camera.Position);
+    state.set("camera.yaw", camera.Yaw);
+    state.set("camera.pitch", camera.Pitch);
+    state.set("camera.zoom", camera.Zoom);
+    state.set("camera.speed", camera.MovementSpeed);
+    state.set("camera.sensitivity", camera.MouseSensitivity);
+    state.set("ui.imgui", ImGuiEnabled);
+    state.set("render.clearColor", clearColor);
+    state.set("render.exposure", exposure);
+    state.set("render.bloom", bloom);
+    state.set("render.spotlight", spotlightOn);
+    state.set("render.deferred", deferred);
+    state.set("render.depthPrepass", depthPrepass);
+    state.set("render.overdrawView", overdrawView);
+    state.set("render.occlusionCulling", occlusionCulling);
+    state.set("render.occlusionCpuRaster", occlusionCpuRaster);
+    state.set("shadows.enabled", shadows);
+    state.set("shadows.resolution", shadowResolution);
+    state.set("shadows.cascades", shadowCascades);
+    state.set("shadows.distance", shadowDistance);
+    state.set("shadows.splitLambda", shadowSplitLambda);
+    state.set("pointShadows.enabled", pointShadows);
+    state.set("pointShadows.atlasSize", pointShadowAtlasSize);
+    state.set("pointShadows.resolution", pointShadowResolution);
+    state.set("pointShadows.budget", pointShadowBudget);
+    state.set("pointShadows.tolerance", pointShadowTolerance);
+    state.set("ssao.enabled", ssao);
+    state.set("ssao.radius", ssaoRadius);
+    state.set("ssao.bias", ssaoBias);
+    state.set("ssao.intensity", ssaoIntensity);
+    state.set("ssao.maxSamples", ssaoMaxSamples);
+    state.set("ssao.budgetMs", ssaoBudgetMs);
+    state.set("ssao.temporal", ssaoTemporal);
+    state.set("resolution.dynamic", dynamicResolution.enabled);
+    state.set("resolution.budgetMs", dynamicResolution.budgetMs);
+    state.set("resolution.minScale", dynamicResolution.minScale);
+    state.set("resolution.maxScale", dynamicResolution.maxScale);
+    state.set("light.dir.direction", dirLightDir);
+    state.set("light.dir.ambientDiffuseSpecular", dirLightAmbDiffSpec);
+    state.set("light.point.ambient", pointLight.ambient);
+    state.set("light.point.diffuse", pointLight.diffuse);
+    state.set("light.point.specular", pointLight.specular);
+    state.set("light.point.attenuation", glm::vec3(pointLight.constant, pointLight.linear, pointLight.quadratic));
+    state.set("state.autosave", autosave);
+    state.set("state.autosaveInterval", autosaveInterval);
+    return state.serialize(PROGRAM_STATE_VERSION);
+}
+
 void ProgramState::SaveToFile(std::string filename) {
-    std::ofstream out(filename);
-    out << clearColor.r << '\n'
-        << clearColor.g << '\n'
-        << clearColor.b << '\n'
-        << ImGuiEnabled << '\n'
-        << camera.Position.x << '\n'
-        << camera.Position.y << '\n'
-        << camera.Position.z << '\n'
-        << camera.Front.x << '\n'
-        << camera.Front.y << '\n'
-        << camera.Front.z << '\n';
+    if (!StateFile::writeAtomically(filename, Serialize()))
+        std::cout << "ERROR::PROGRAM_STATE cannot write " << filename << std::endl;
 }
 
 void ProgramState::LoadFromFile(std::string filename) {
-    std::ifstream in(filename);
-    if (in) {
-        in >> clearColor.r
-           >> clearColor.g
-           >> clearColor.b
-           >> ImGuiEnabled
-           >> camera.Position.x
-           >> camera.Position.y
-           >> camera.Position.z
-           >> camera.Front.x
-           >> camera.Front.y
-           >> camera.Front.z;
+    StateFile &state = stateFile;
+    if (!state.load(filename)) {
+        // stari format: boja, ImGui, pozicija i pravac kamere; yaw i pitch se izvode iz pravca
+        std::ifstream in(filename);
+        glm::vec3 front;
+        if (in >> clearColor.r >> clearColor.g >> clearColor.b >> ImGuiEnabled
+               >> camera.Position.x >> camera.Position.y >> camera.Position.z
+               >> front.x >> front.y >> front.z) {
+            front = glm::normalize(front);
+            camera.SetOrientation(glm::degrees(std::atan2(front.z, front.x)), glm::degrees(std::asin(front.y)));
+        }
+        return;
+    }
+    if (state.version() > PROGRAM_STATE_VERSION)
+        std::cout << filename << " is version " << state.version() << ", newer keys are kept but ignored" << std::endl;
+    // kljucevi koji nedostaju zadrzavaju podrazumevane vrednosti
+    float yaw = camera.Yaw, pitch = camera.Pitch;
+    state.get("camera.position", camera.Position);
+    state.get("camera.yaw", yaw);
+    state.get("camera.pitch", pitch);
+    camera.SetOrientation(yaw, pitch);
+    state.get("camera.zoom", camera.Zoom);
+    state.get("camera.speed", camera.MovementSpeed);
+    state.get("camera.sensitivity", camera.MouseSensitivity);
+    state.get("ui.imgui", ImGuiEnabled);
+    state.get("render.clearColor", clearColor);
+    state.get("render.exposure", exposure);
+    state.get("render.bloom", bloom);
+    state.get("render.spotlight", spotlightOn);
+    state.get("render.deferred", deferred);
+    state.get("render.depthPrepass", depthPrepass);
+    state.get("render.overdrawView", overdrawView);
+    state.get("render.occlusionCulling", occlusionCulling);
+    state.get("render.occlusionCpuRaster", occlusionCpuRaster);
+    state.get("shadows.enabled", shadows);
+    state.get("shadows.resolution", shadowResolution);
+    state.get("shadows.cascades", shadowCascades);
+    state.get("shadows.distance", shadowDistance);
+    state.get("shadows.splitLambda", shadowSplitLambda);
+    state.get("pointShadows.enabled", pointShadows);
+    state.get("pointShadows.atlasSize", pointShadowAtlasSize);
+    state.get("pointShadows.resolution", pointShadowResolution);
+    state.get("pointShadows.budget", pointShadowBudget);
+    state.get("pointShadows.tolerance", pointShadowTolerance);
+    state.get("ssao.enabled", ssao);
+    state.get("ssao.radius", ssaoRadius);
+    state.get("ssao.bias", ssaoBias);
+    state.get("ssao.intensity", ssaoIntensity);
+    state.get("ssao.maxSamples", ssaoMaxSamples);
+    state.get("ssao.budgetMs", ssaoBudgetMs);
+    state.get("ssao.temporal", ssaoTemporal);
+    state.get("resolution.dynamic", dynamicResolution.enabled);
+    state.get("resolution.budgetMs", dynamicResolution.budgetMs);
+    state.get("resolution.minScale", dynamicResolution.minScale);
+    state.get("resolution.maxScale", dynamicResolution.maxScale);
+    state.get("light.dir.direction", dirLightDir);
+    state.get("light.dir.ambientDiffuseSpecular", dirLightAmbDiffSpec);
+    state.get("light.point.ambient", pointLight.ambient);
+    state.get("light.point.diffuse", pointLight.diffuse);
+    state.get("light.point.specular", pointLight.specular);
+    glm::vec3 attenuation(pointLight.constant, pointLight.linear, pointLight.quadratic);
+    if (state.get("light.point.attenuation", attenuation)) {
+        pointLight.constant = attenuation.x;
+        pointLight.linear = attenuation.y;
+        pointLight.quadratic = attenuation.z;
+    }
+    state.get("state.autosave", autosave);
+    state.get("state.autosaveInterval", autosaveInterval);
+}
+
+// podrazumevana svetla, ekspozicija i bloom iz scene; sacuvano stanje ih posle pregazi
+void ApplySceneSettings(ProgramState &state, const SceneFile &sceneFile) {
+    const SceneFile::Settings &sceneSettings = sceneFile.settings();
+    PointLight &pointLight = state.pointLight;
+    pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
+    pointLight.ambient = sceneSettings.pointAmbient;
+    pointLight.diffuse = sceneSettings.pointDiffuse;
+    pointLight.specular = sceneSettings.pointSpecular;
+    pointLight.constant = sceneSettings.pointAttenuation.x;
+    pointLight.linear = sceneSettings.pointAttenuation.y;
+    pointLight.quadratic = sceneSettings.pointAttenuation.z;
+    state.dirLightDir = sceneSettings.dirDirection;
+    state.dirLightAmbDiffSpec = sceneSettings.dirIntensity;
+    exposure = sceneSettings.exposure;
+    bloom = sceneSettings.bloom != 0;
+}
+
+// BVH svake mreze svih modela, paralelno; gotove mreze se citaju iz BVH_CACHE_DIRECTORY
+std::vector<std::vector<MeshBVH>> BuildMeshBVHs(const std::vector<Model> &models, JobSystem &jobs) {
+    AllocationScope scope(MEMORY_BVH);
+    std::vector<std::vector<MeshBVH>> meshBVHs(models.size());
+    std::vector<std::pair<unsigned int, unsigned int>> bvhMeshes;
+    for (unsigned int m = 0; m < models.size(); m++) {
+        meshBVHs[m].resize(models[m].meshes.size());
+        for (unsigned int i = 0; i < models[m].meshes.size(); i++)
+            bvhMeshes.emplace_back(m, i);
     }
+    std::atomic<unsigned int> cachedBVHs(0);
+    auto bvhStart = std::chrono::steady_clock::now();
+    jobs.parallelFor(bvhMeshes.size(), [&](unsigned int index, unsigned int) {
+        AllocationScope scope(MEMORY_BVH);
+        const Mesh &mesh = models[bvhMeshes[index].first].meshes[bvhMeshes[index].second];
+        std::vector<glm::vec3> positions(mesh.vertexCount);
+        for (unsigned int v = 0; v < mesh.vertexCount; v++)
+            positions[v] = mesh.VertexPosition(v);
+        MeshBVH &bvh = meshBVHs[bvhMeshes[index].first][bvhMeshes[index].second];
+        if (bvh.buildCached(positions.data(), positions.size(), mesh.indices.data(), mesh.indices.size(), BVH_CACHE_DIRECTORY))
+            cachedBVHs++;
+    });
+    std::cout << "BVH: " << bvhMeshes.size() << " meshes, " << cachedBVHs << " from cache, "
+              << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - bvhStart).count() << " ms" << std::endl;
+    return meshBVHs;
 }
 
 ProgramState *programState;
+Profiler *profiler;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
+int RunOcclusionBenchmark();
+
+int RunBvhBenchmark();
+
+int RunPathTracer(const SceneFile &sceneFile, const std::string &statePath, const PathTracer::Settings &settings,
+                  const std::string &outPath);
+
+int DiffImages(const char *firstPath, const char *secondPath, const char *diffPath);
+
+bool CaptureBackbuffer(const std::string &path, int width, int height);
+
+int RunEntityBenchmark();
+
+int CompileScene(const char *textPath, const char *binaryPath);
+
+int RunCommandBenchmark();
+
+int main(int argc, char *argv[]) {
+    // CPU occlusion raster benchmark, bez prozora i GL-a
+    std::string scenePath = "resources/scenes/main.scene";
+    std::string statePath = "resources/program_state.txt";
+    bool releaseMeshData = false;
+    std::string memoryJsonPath = "memory.json";
+    // referentna slika na CPU (--path-trace) ili snimak GL frejma (--capture), iste velicine za --image-diff
+    std::string pathTracePath;
+    std::string capturePath;
+    unsigned int captureFrame = 60;
+    PathTracer::Settings traceSettings;
+    traceSettings.width = SCR_WIDTH;
+    traceSettings.height = SCR_HEIGHT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--occlusion-benchmark") == 0)
+            return RunOcclusionBenchmark();
+        if (strcmp(argv[i], "--bvh-benchmark") == 0)
+            return RunBvhBenchmark();
+        if (strcmp(argv[i], "--entity-benchmark") == 0)
+            return RunEntityBenchmark();
+        if (strcmp(argv[i], "--command-benchmark") == 0)
+            return RunCommandBenchmark();
+        if (strcmp(argv[i], "--compile-scene") == 0 && i + 2 < argc)
+            return CompileScene(argv[i + 1], argv[i + 2]);
+        if (strcmp(argv[i], "--image-diff") == 0 && i + 2 < argc)
+            return DiffImages(argv[i + 1], argv[i + 2], i + 3 < argc && strncmp(argv[i + 3], "--", 2) != 0 ? argv[i + 3] : nullptr);
+        if (strcmp(argv[i], "--path-trace") == 0 && i + 1 < argc)
+            pathTracePath = argv[++i];
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            traceSettings.samples = std::max(1, atoi(argv[++i]));
+        if (strcmp(argv[i], "--bounces") == 0 && i + 1 < argc)
+            traceSettings.bounces = std::max(0, atoi(argv[++i]));
+        // velicina slike path tracer-a i prozora za --capture
+        if (strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+            traceSettings.width = std::max(1, atoi(argv[i + 1]));
+            traceSettings.height = std::max(1, atoi(argv[i + 2]));
+            i += 2;
+        }
+        // nevidljiv prozor, bez ImGui i simulacije; captureFrame-ti frejm se upisuje u PPM i program se zatvara
+        if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        if (strcmp(argv[i], "--capture-frame") == 0 && i + 1 < argc)
+            captureFrame = std::max(1, atoi(argv[++i]));
+        if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            scenePath = argv[++i];
+        // sacuvana sesija (kamera i podesavanja) za ponavljanje merenja
+        if (strcmp(argv[i], "--state") == 0 && i + 1 < argc)
+            statePath = argv[++i];
+        // geometrija modela scene se posle slanja na GPU brise iz RAM-a
+        if (strcmp(argv[i], "--release-mesh-data") == 0)
+            releaseMeshData = true;
+        // izvestaj o memoriji po podsistemima, upisuje se na izlasku i iz panela memorije
+        if (strcmp(argv[i], "--memory-json") == 0 && i + 1 < argc)
+            memoryJsonPath = argv[++i];
+    }
+    // alokacije na glavnoj niti se pripisuju podsistemu koji se upravo ucitava, do render petlje
+    AllocationCounter::currentSubsystem() = MEMORY_SCENE;
+    // tekstualna ili prevedena scena, greska se prijavljuje pre otvaranja prozora
+    SceneFile sceneFile;
+    std::string sceneError;
+    if (!sceneFile.load(scenePath, &sceneError)) {
+        std::cout << "ERROR::SCENE " << scenePath << ": " << sceneError << std::endl;
+        return -1;
+    }
+    if (!pathTracePath.empty())
+        return RunPathTracer(sceneFile, statePath, traceSettings, pathTracePath);
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -121,18 +670,24 @@ int main() {
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    bool capturing = !capturePath.empty();
+    if (capturing)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // glfw window creation
     // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    GLFWwindow *window = glfwCreateWindow(capturing ? traceSettings.width : SCR_WIDTH,
+                                          capturing ? traceSettings.height : SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
     // tell GLFW to capture our mouse
@@ -147,8 +702,24 @@ int main() {
 
     stbi_set_flip_vertically_on_load(false);// okrece teksture po y osi
 
+    // svetla i podesavanja scene su podrazumevane vrednosti, sacuvano stanje ih pregazi
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
+    programState->memoryJsonPath = memoryJsonPath;
+    const SceneFile::Settings &sceneSettings = sceneFile.settings();
+    PointLight& pointLight = programState->pointLight;
+    ApplySceneSettings(*programState, sceneFile);
+    programState->LoadFromFile(statePath);
+    if (capturing) {
+        // kadar iz sacuvanog stanja, u punoj rezoluciji i bez panela; stanje se ne upisuje nazad
+        programState->ImGuiEnabled = false;
+        programState->CameraMouseMovementUpdateEnabled = false;
+        programState->dynamicResolution.enabled = false;
+        programState->dynamicResolution.maxScale = 1.0f;
+        programState->autosave = false;
+    }
+    StateAutosave stateAutosave;
+    stateAutosave.start();
+    float lastAutosave = 0.0f;
     if (programState->ImGuiEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -172,88 +743,164 @@ int main() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // =================================================PRAVLJENJE I UCITAVANJE SEJDERA=================================================
-    //glavni shaderi
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    // varijante se prave po potrebi i cuvaju kao binarni programi u resources/shader_cache
+    ShaderLibrary shaderLibrary;
+    shaderLibrary.loadBinaryCacheFunctions((GLADloadproc) glfwGetProcAddress);
+    //glavni shaderi, varijanta sa BLOOM pise i svetle delove u drugi izlaz, SPOTLIGHT ukljucuje baterijsku lampu, SHADOWS i POINT_SHADOWS senke, SSAO zaklonjenost ambijenta
+    ShaderLibrary::ProgramHandle lightingProgram = shaderLibrary.declare("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs", {"BLOOM", "SPOTLIGHT", "SHADOWS", "POINT_SHADOWS", "SSAO"});
+    shaderLibrary.setConstant(lightingProgram, "NR_POINT_LIGHTS", "2");
+    //shader za providnost (weighted blended OIT) i sklapanje providnih slojeva preko scene
+    ShaderLibrary::ProgramHandle transparentProgram = shaderLibrary.declare("resources/shaders/2.model_lighting.vs", "resources/shaders/transparent.fs");
+    shaderLibrary.setConstant(transparentProgram, "NR_POINT_LIGHTS", "2");
+    ShaderLibrary::ProgramHandle oitResolveProgram = shaderLibrary.declare("resources/shaders/blur.vs", "resources/shaders/oit_resolve.fs", {"BLOOM"});
     //shaderi za nebo
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+    Shader &skyboxShader = shaderLibrary.get(shaderLibrary.declare("resources/shaders/skybox.vs", "resources/shaders/skybox.fs"));
     //shaderi za bloom
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
-    Shader bloomFinalShader("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");
-    //shader za providnost
-    Shader transparentShader("resources/shaders/2.model_lighting.vs", "resources/shaders/transparent.fs");
+    Shader &blurShader = shaderLibrary.get(shaderLibrary.declare("resources/shaders/blur.vs", "resources/shaders/blur.fs"));
+    ShaderLibrary::ProgramHandle bloomFinalProgram = shaderLibrary.declare("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs", {"OVERDRAW"});
+    //depth pre-pass i debug prikaz overdraw-a
+    Shader &depthShader = shaderLibrary.get(shaderLibrary.declare("resources/shaders/depth.vs", "resources/shaders/depth.fs"));
+    Shader &overdrawShader = shaderLibrary.get(shaderLibrary.declare("resources/shaders/2.model_lighting.vs", "resources/shaders/overdraw.fs"));
+    //deferred: G-buffer, svetla preko celog ekrana (usmereno + lampa), zapremine point svetala i svetli delovi za bloom
+    ShaderLibrary::ProgramHandle gbufferProgram = shaderLibrary.declare("resources/shaders/2.model_lighting.vs", "resources/shaders/gbuffer.fs");
+    ShaderLibrary::ProgramHandle deferredDirectionalProgram = shaderLibrary.declare("resources/shaders/blur.vs", "resources/shaders/deferred_directional.fs", {"SPOTLIGHT", "SHADOWS", "SSAO"});
+    ShaderLibrary::ProgramHandle deferredPointProgram = shaderLibrary.declare("resources/shaders/deferred_point.vs", "resources/shaders/deferred_point.fs", {"POINT_SHADOWS", "SSAO"});
+    shaderLibrary.setConstant(deferredPointProgram, "NR_POINT_LIGHTS", "2");
+    ShaderLibrary::ProgramHandle brightProgram = shaderLibrary.declare("resources/shaders/blur.vs", "resources/shaders/bright.fs");
+    //Hi-Z izvor za occlusion culling
+    ShaderLibrary::ProgramHandle hizDownsampleProgram = shaderLibrary.declare("resources/shaders/blur.vs", "resources/shaders/hiz_downsample.fs");
+    ShaderLibrary::ProgramHandle ssaoProgram = shaderLibrary.declare("resources/shaders/blur.vs", "resources/shaders/ssao.fs");
+    ShaderLibrary::ProgramHandle ssaoUpsampleProgram = shaderLibrary.declare("resources/shaders/blur.vs", "resources/shaders/ssao_upsample.fs");
+    //sacuvani shaderi se prevode u pozadini i menjaju bez zaustavljanja renderovanja
+    ShaderReloader shaderReloader;
+    shaderReloader.start(window, shaderLibrary, "resources/shaders");
 
     // ================================================================UCITAVANJE MODELA=================================================
-    //sobe
-    Model roomsModel("resources/objects/rooms/model.obj");
-    roomsModel.SetShaderTextureNamePrefix("material.");
-    //skulptura
-    Model skModel("resources/objects/skulptura/Colossal_Bust_Rameses_II.obj");
-    skModel.SetShaderTextureNamePrefix("material.");
-    //grave
-    Model graveModel("resources/objects/grave/churchyard_grave_20k_edit.obj");
-    graveModel.SetShaderTextureNamePrefix("material.");
-    //pecurka
-    Model pecurkaModel("resources/objects/pecurka/mushroom-2.obj");
-    pecurkaModel.SetShaderTextureNamePrefix("material.");
-    //light
+    // modeli scene se citaju i teksture dekodiraju paralelno, GL objekti se prave posle na ovoj niti
+    JobSystem jobs;
+    AllocationCounter::currentSubsystem() = MEMORY_MESHES;
+    std::vector<Model> sceneModels(sceneFile.models().size());
+    jobs.parallelFor(sceneModels.size(), [&](unsigned int index, unsigned int) {
+        AllocationScope scope(MEMORY_MESHES);
+        sceneModels[index].Import(sceneFile.string(sceneFile.models()[index].path));
+    });
+    for (Model &model: sceneModels) {
+        model.Upload();
+        model.SetShaderTextureNamePrefix("material.");
+    }
+    //BVH svake mreze za biranje misem i upite zracima, paralelno; sledeci put se ucitava iz BVH_CACHE_DIRECTORY
+    std::vector<std::vector<MeshBVH>> meshBVHs = BuildMeshBVHs(sceneModels, jobs);
+    AllocationCounter::currentSubsystem() = MEMORY_MESHES;
+    //zapremina point svetla za deferred, nezavisno od modela u sceni
     Model lightModel("resources/objects/ball/ball.obj");
     lightModel.SetShaderTextureNamePrefix("material.");
+    //poluprecnik ball.obj, zapremina point svetla se skalira na domet svetla
+    float lightModelRadius = 0.0f;
+    for (const Mesh &mesh: lightModel.meshes) {
+        for (const Vertex &vertex: mesh.vertices)
+            lightModelRadius = std::max(lightModelRadius, glm::length(vertex.Position));
+    }
 
+    // ================================================================SCENA=================================================
+    // svaki objekat iz scene postaje entitet; Animated dobija ako se njise ili okrece, PointLight ako je lampa
+    // staticni objekti dobiju world matrice jednom, posle se preracunavaju samo izmenjena podstabla
+    AllocationCounter::currentSubsystem() = MEMORY_SCENE;
+    SceneGraph sceneGraph;
+    EntityWorld entities;
+    for (const SceneFile::Object &description: sceneFile.objects()) {
+        Model *model = &sceneModels[description.model];
+        Transform transform;
+        transform.position = description.position;
+        transform.rotation = description.rotation;
+        transform.scale = description.scale;
+        transform.matrix = ComposeTransform(transform);
+        Renderable renderable;
+        renderable.model = model;
+        renderable.node = sceneGraph.addModel(sceneFile.string(description.name), *model, transform.matrix, SceneGraph::NONE, renderable.meshNodes);
+        renderable.meshVisible.assign(model->meshes.size(), 1);
+        renderable.occluder = (description.flags & SceneFile::OBJECT_OCCLUDER) != 0;
+        renderable.transparent = (description.flags & SceneFile::OBJECT_TRANSPARENT) != 0;
+        renderable.lamp = (description.flags & SceneFile::OBJECT_LAMP) != 0;
+        bool animate = description.bobAmplitude != glm::vec3(0.0f) || description.spin != glm::vec3(0.0f);
+        renderable.dynamic = animate && !renderable.transparent;
+        Animated animated;
+        animated.basePosition = description.position;
+        animated.bobAmplitude = description.bobAmplitude;
+        animated.bobSpeed = description.bobSpeed;
+        animated.spin = description.spin;
+        PreviousTransform previous;
+        previous.position = transform.position;
+        previous.rotation = transform.rotation;
+        if (renderable.lamp)
+            entities.create(transform, std::move(renderable), animated, previous, programState->pointLight);
+        else if (animate)
+            entities.create(transform, std::move(renderable), animated, previous);
+        else
+            entities.create(transform, std::move(renderable));
+    }
+    programState->sceneNodes = sceneGraph.size();
+    programState->entityCount = entities.size();
+    programState->archetypeCount = entities.archetypeCount();
+    sceneGraph.update();
+    //TLAS nad svim mrezama scene; objekti se pomeraju, pa se pred svako biranje postave world matrice i ponovo izgradi
+    AllocationCounter::currentSubsystem() = MEMORY_BVH;
+    std::vector<PickTarget> pickTargets;
+    SceneBVH sceneBVH;
+    entities.each<Renderable>([&](const Renderable &object) {
+        const std::vector<MeshBVH> &bvhs = meshBVHs[object.model - sceneModels.data()];
+        for (unsigned int i = 0; i < bvhs.size(); i++) {
+            sceneBVH.add(bvhs[i], sceneGraph.world(object.meshNodes[i]), pickTargets.size());
+            pickTargets.push_back(PickTarget{object.node, object.meshNodes[i], i});
+        }
+    });
+    sceneBVH.build();
+    AllocationCounter::currentSubsystem() = MEMORY_SCENE;
+    //granice mreza u svetu (pokretnim objektima i lokalne, za svaki frejm) i uprosceni occluder-i za CPU raster
+    AllocationCounter::currentSubsystem() = MEMORY_OCCLUSION;
+    std::vector<OccluderMesh> occluderMeshes;
+    // sve sto baca senku usmerenog svetla, kaskade se protezu do toga prema svetlu
+    AABB shadowCasterBounds;
+    // pokretni neprovidni objekti bacaju senke point svetala koje se crtaju svaki frejm
+    bool dynamicShadowCasters = false;
+    entities.each<Renderable>([&](Renderable &object) {
+        if (object.transparent)
+            return;
+        for (unsigned int i = 0; i < object.model->meshes.size(); i++) {
+            AABB bounds;
+            const Mesh &mesh = object.model->meshes[i];
+            for (unsigned int v = 0; mesh.HasCpuPositions() && v < mesh.vertexCount; v++)
+                bounds.expand(mesh.VertexPosition(v));
+            if (object.dynamic)
+                object.localBounds.push_back(bounds);
+            object.meshBounds.push_back(bounds.transformed(sceneGraph.world(object.meshNodes[i])));
+            shadowCasterBounds.expand(object.meshBounds.back());
+        }
+        dynamicShadowCasters = dynamicShadowCasters || object.dynamic;
+        if (object.occluder)
+            occluderMeshes.push_back(OccluderMesh::fromModel(*object.model, sceneGraph.world(object.node), OCCLUDER_TRIANGLES));
+    });
+    // granice i occluder-i su izracunati; u RAM-u ostaje samo ono sto residency modela trazi
+    size_t meshCpuBytes = 0;
+    for (unsigned int i = 0; i < sceneModels.size(); i++) {
+        unsigned int residency = std::min(sceneFile.models()[i].residency, (unsigned int) SceneFile::RESIDENCY_DISCARD);
+        sceneModels[i].SetResidency(releaseMeshData ? MESH_DISCARD : (MeshResidency) residency);
+        meshCpuBytes += sceneModels[i].CpuBytes();
+        ModelMemory memory;
+        memory.name = sceneFile.string(sceneFile.models()[i].name);
+        memory.model = &sceneModels[i];
+        programState->modelMemory.push_back(memory);
+    }
+    // najvise zauzete memorije (operator new) tokom ucitavanja; slike iz stb_image idu preko malloc i nisu tu
+    programState->loadPeakBytes = AllocationCounter::peakBytes();
+    std::cout << "Loading: heap peak " << programState->loadPeakBytes / (1024.0 * 1024.0) << " MiB, now "
+              << AllocationCounter::liveBytes() / (1024.0 * 1024.0) << " MiB, mesh data on CPU "
+              << meshCpuBytes / (1024.0 * 1024.0) << " MiB" << std::endl;
 
     // ============================================BLOOM================================================================
-    // config framebuffers
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // create and attach depth buffer
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffers[0], 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    // check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    // window-sized textures for the hdr framebuffer (scene + bright parts) and the blur chain, owned by the render graph below
+    AllocationCounter::currentSubsystem() = MEMORY_GENERAL;
+    RenderTargets renderTargets;
+    profiler = new Profiler;
 
     // ================================================SKYBOX===========================================================
     //Seting skybox vertices
@@ -311,42 +958,695 @@ int main() {
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    MemoryTracker::track(MemoryTracker::VERTEX_ARRAY, skyboxVAO, 0, MEMORY_SKYBOX, "skybox");
+    MemoryTracker::track(MemoryTracker::BUFFER, skyboxVBO, sizeof(skyboxVertices), MEMORY_SKYBOX, "skybox vertices");
 
     //========================================load textures for skybox===================================================
-    programState->faces =
-            {
-                    FileSystem::getPath("resources/textures/skybox/right.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/left.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/top.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/front.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/back.jpg"),
+    if (sceneFile.hasSkybox()) {
+        for (unsigned int face: sceneSettings.skybox)
+            programState->faces.push_back(FileSystem::getPath(sceneFile.string(face)));
+        programState->cubemapTexture = loadCubemap(programState->faces);
+    }
+
+    // ==============================================RENDER GRAPH======================================================
+    // per-frame values the passes read, updated at the top of every frame
+    float time = 0.0f;
+    glm::mat4 projection(1.0f);
+    glm::mat4 view(1.0f);
+    glm::vec3 pointLightPositions[2];
+    const unsigned int blurAmount = 5;
+
+    RenderGraph renderGraph(renderTargets);
+    renderGraph.setProfiler(profiler);
+    RenderGraph::Resource hdrColor = RenderGraph::INVALID;
+    bool graphBloom = bloom;
+    bool graphDepthPrepass = programState->UsesDepthPrepass();
+    bool graphDeferred = programState->deferred;
+    bool graphSsao = programState->ssao;
+    bool graphGpuOcclusion = false;
+    // Hi-Z occlusion culling: piramida, njen izvor sa GPU (readback) i CPU raster occluder-a
+    HiZBuffer hiz;
+    DepthReadback depthReadback;
+    DepthRasterizer occluderRasterizer;
+    {
+        AllocationScope scope(MEMORY_OCCLUSION);
+        occluderRasterizer.resize(HIZ_WIDTH, HIZ_HEIGHT);
+    }
+    std::vector<float> hizDepthValues;
+    glm::mat4 hizViewProjection(1.0f);
+    // senke usmerenog svetla: kaskade se namestaju na CPU pred svaki frejm, crtaju u prolazu shadowCascades
+    CascadedShadowMap shadowMap;
+    auto setShadowUniforms = [&](Shader &shader) {
+        if (!programState->shadows)
+            return;
+        glm::mat4 matrices[CascadedShadowMap::MAX_CASCADES];
+        float splits[CascadedShadowMap::MAX_CASCADES];
+        float texelSizes[CascadedShadowMap::MAX_CASCADES];
+        for (int c = 0; c < shadowMap.cascadeCount(); c++) {
+            matrices[c] = shadowMap.matrix(c);
+            splits[c] = shadowMap.splitDistance(c);
+            texelSizes[c] = shadowMap.texelSize(c);
+        }
+        glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap.texture());
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("shadowMap", SHADOW_MAP_UNIT);
+        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "cascadeMatrices"), shadowMap.cascadeCount(), GL_FALSE, &matrices[0][0][0]);
+        glUniform1fv(glGetUniformLocation(shader.ID, "cascadeSplits"), shadowMap.cascadeCount(), splits);
+        glUniform1fv(glGetUniformLocation(shader.ID, "cascadeTexelSizes"), shadowMap.cascadeCount(), texelSizes);
+        shader.setInt("cascadeCount", shadowMap.cascadeCount());
+        shader.setVec3("viewForward", programState->camera.Front);
+    };
+    // senke point svetala: strane iz kesa (PointShadowMaps), crtaju se u prolazu pointShadows
+    PointShadowMaps pointShadows;
+    auto setPointShadowUniforms = [&](Shader &shader) {
+        if (!programState->pointShadows)
+            return;
+        // koliko svetala shader ima (NR_POINT_LIGHTS); svetla bez senke dobijaju w = 0
+        const int lights = 2;
+        glm::mat4 matrices[lights * PointShadowMaps::FACES];
+        glm::vec4 rects[lights * PointShadowMaps::FACES];
+        glm::vec4 origins[lights];
+        for (int light = 0; light < lights; light++) {
+            bool shadowed = light < pointShadows.lightCount() && pointShadows.hasShadow(light);
+            origins[light] = shadowed ? glm::vec4(pointShadows.origin(light), 1.0f) : glm::vec4(0.0f);
+            for (int face = 0; face < PointShadowMaps::FACES; face++) {
+                matrices[light * PointShadowMaps::FACES + face] = shadowed ? pointShadows.matrix(light, face) : glm::mat4(1.0f);
+                rects[light * PointShadowMaps::FACES + face] = shadowed ? pointShadows.rect(light, face) : glm::vec4(0.0f);
+            }
+        }
+        glActiveTexture(GL_TEXTURE0 + POINT_SHADOW_UNIT);
+        glBindTexture(GL_TEXTURE_2D, pointShadows.texture());
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("pointShadowAtlas", POINT_SHADOW_UNIT);
+        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "pointShadowMatrices"), lights * PointShadowMaps::FACES, GL_FALSE, &matrices[0][0][0]);
+        glUniform4fv(glGetUniformLocation(shader.ID, "pointShadowRects"), lights * PointShadowMaps::FACES, &rects[0][0]);
+        glUniform4fv(glGetUniformLocation(shader.ID, "pointShadowOrigins"), lights, &origins[0][0]);
+    };
+    // SSAO: pola rezolucije sa istorijom u AmbientOcclusion, uvecan rezultat je tekstura grafa ambientOcclusion
+    AmbientOcclusion ambientOcclusion;
+    auto setAmbientOcclusionUniforms = [&](Shader &shader, unsigned int texture) {
+        if (!programState->ssao)
+            return;
+        glActiveTexture(GL_TEXTURE0 + AMBIENT_OCCLUSION_UNIT);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("ambientOcclusion", AMBIENT_OCCLUSION_UNIT);
+    };
+    // proverava granice svake mreze i pamti rezultat u meshVisible
+    auto cullOpaqueObjects = [&]() {
+        programState->testedMeshes = 0;
+        programState->culledMeshes = 0;
+        if (!programState->occlusionCulling) {
+            hiz.invalidate();
+            entities.each<Renderable>([](Renderable &object) {
+                std::fill(object.meshVisible.begin(), object.meshVisible.end(), 1);
+            });
+            return;
+        }
+        if (programState->occlusionCpuRaster) {
+            // occluder-i iz ovog frejma, bez kasnjenja
+            auto rasterStart = std::chrono::steady_clock::now();
+            occluderRasterizer.clear();
+            for (const OccluderMesh &occluder: occluderMeshes)
+                occluderRasterizer.addOccluder(occluder, projection * view);
+            occluderRasterizer.render(&jobs);
+            hiz.build(occluderRasterizer.depth(), HIZ_WIDTH, HIZ_HEIGHT, projection * view, occluderRasterizer.stride());
+            programState->occluderTriangles = occluderRasterizer.triangleCount();
+            programState->occluderRasterMs = std::chrono::duration<float, std::milli>(
+                    std::chrono::steady_clock::now() - rasterStart).count();
+        } else if (depthReadback.collect(hizDepthValues, hizViewProjection)) {
+            hiz.build(hizDepthValues.data(), HIZ_WIDTH, HIZ_HEIGHT, hizViewProjection);
+        }
+        entities.each<Renderable>([&](Renderable &object) {
+            for (unsigned int i = 0; i < object.meshBounds.size(); i++) {
+                object.meshVisible[i] = hiz.visible(object.meshBounds[i]);
+                programState->testedMeshes++;
+                programState->culledMeshes += !object.meshVisible[i];
+            }
+        });
+    };
+    SampleCounter overdrawCounter;
+    CommandQueue depthCommands;
+    // privremeni podaci jednog frejma; reset() na pocetku frejma, memorija ostaje za sledeci
+    LinearAllocator frameArena;
+    // (re)declares the passes of the current configuration, called on resize and when bloom is toggled
+    auto buildRenderGraph = [&]() {
+        AllocationScope scope(MEMORY_RENDER_TARGETS);
+        renderGraph.reset();
+        RenderGraph::TextureDesc colorDesc;
+        colorDesc.clear = true;
+        hdrColor = renderGraph.createTexture("hdrColor", colorDesc);
+        RenderGraph::Resource brightColor = renderGraph.createTexture("brightColor", colorDesc);
+        RenderGraph::TextureDesc depthDesc;
+        depthDesc.internalFormat = GL_DEPTH_COMPONENT24;
+        depthDesc.clear = true;
+        depthDesc.clearValue = glm::vec4(1.0f);
+        RenderGraph::Resource sceneDepth = renderGraph.createTexture("sceneDepth", depthDesc);
+        RenderGraph::Resource backbuffer = renderGraph.importBackbuffer("backbuffer");
+
+        // =====================kaskadne senke: samo pozicije (depthVAO) u sloj shadow mape svake kaskade=============
+        // svaka kaskada crta samo mreze cije granice sece njena projekcija svetla
+        renderGraph.addPass("shadowCascades", [&]() {
+            if (!programState->shadows)
+                return;
+            depthShader.use();
+            depthShader.setMat4("view", glm::mat4(1.0f));
+            int modelLocation = glGetUniformLocation(depthShader.ID, "model");
+            // i zadnje strane: zidovi soba su jednostrani
+            glDisable(GL_CULL_FACE);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(2.0f, 2.0f);
+            unsigned int casters = 0;
+            for (int c = 0; c < shadowMap.cascadeCount(); c++) {
+                shadowMap.bindCascade(c);
+                depthShader.setMat4("projection", shadowMap.matrix(c));
+                Frustum frustum = shadowMap.frustum(c);
+                entities.each<Renderable>([&](const Renderable &object) {
+                    if (object.transparent)
+                        return;
+                    for (unsigned int i = 0; i < object.meshBounds.size(); i++) {
+                        if (!frustum.intersects(object.meshBounds[i]))
+                            continue;
+                        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &sceneGraph.world(object.meshNodes[i])[0][0]);
+                        object.model->meshes[i].DrawDepth();
+                        casters++;
+                    }
+                });
+            }
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glEnable(GL_CULL_FACE);
+            programState->shadowCasters = casters;
+        }).sideEffect();
+
+        // =====================senke point svetala: strane kocke u atlasu, staticni deo iz kesa======================
+        // staticni objekti se crtaju samo za svetla koja su se pomerila (u okviru budzeta), pokretni svaki frejm
+        renderGraph.addPass("pointShadows", [&]() {
+            if (!programState->pointShadows)
+                return;
+            depthShader.use();
+            depthShader.setMat4("view", glm::mat4(1.0f));
+            int modelLocation = glGetUniformLocation(depthShader.ID, "model");
+            glDisable(GL_CULL_FACE);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(2.0f, 2.0f);
+            unsigned int casters = 0;
+            auto drawCasters = [&](const glm::mat4 &matrix, const Frustum &frustum, bool dynamic) {
+                depthShader.setMat4("projection", matrix);
+                entities.each<Renderable>([&](const Renderable &object) {
+                    if (object.transparent || object.dynamic != dynamic)
+                        return;
+                    for (unsigned int i = 0; i < object.meshBounds.size(); i++) {
+                        if (!frustum.intersects(object.meshBounds[i]))
+                            continue;
+                        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &sceneGraph.world(object.meshNodes[i])[0][0]);
+                        object.model->meshes[i].DrawDepth();
+                        casters++;
+                    }
+                });
             };
+            pointShadows.render(programState->pointShadowBudget, programState->pointShadowTolerance, dynamicShadowCasters,
+                                [&](const glm::mat4 &matrix, const Frustum &frustum) { drawCasters(matrix, frustum, false); },
+                                [&](const glm::mat4 &matrix, const Frustum &frustum) { drawCasters(matrix, frustum, true); });
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glEnable(GL_CULL_FACE);
+            programState->pointShadowCasters = casters;
+            programState->pointShadowStats = pointShadows.stats();
+            programState->pointShadowAtlasUsage = pointShadows.atlasUsage();
+        }).sideEffect();
+
+        // =====================depth pre-pass: samo pozicije, bez boje============================================
+        // objekti se zapisuju paralelno (jedan command buffer po objektu), GL komande izvrsava samo ova nit
+        if (programState->UsesDepthPrepass()) {
+            renderGraph.addPass("depthPrepass", [&]() {
+                depthShader.use();
+                depthShader.setMat4("projection", projection);
+                depthShader.setMat4("view", view);
+                int modelLocation = glGetUniformLocation(depthShader.ID, "model");
+                ArenaVector<const Renderable *> depthObjects{ArenaAllocator<const Renderable *>(frameArena)};
+                depthObjects.reserve(entities.count<Renderable>());
+                entities.each<Renderable>([&](const Renderable &object) {
+                    if (!object.transparent)
+                        depthObjects.push_back(&object);
+                });
+                depthCommands.reset();
+                depthCommands.record(jobs, depthObjects.size(), [&](CommandBuffer &commands, unsigned int index) {
+                    RecordSceneObjectDepth(*depthObjects[index], sceneGraph, modelLocation, commands);
+                });
+                depthCommands.execute();
+            }).depth(sceneDepth);
+        }
+
+        // =====================SSAO: zaklonjenost u pola rezolucije iz dubine scene, pa bilateralno uvecanje======
+        // ide posle prolaza koji pise dubinu (depth pre-pass ili G-buffer), a pre osvetljenja koje je cita
+        RenderGraph::TextureDesc occlusionDesc;
+        occlusionDesc.internalFormat = GL_R8;
+        RenderGraph::Resource occlusion = renderGraph.createTexture("ambientOcclusion", occlusionDesc);
+        ambientOcclusion.invalidateHistory();
+        auto addAmbientOcclusionPasses = [&]() {
+            // istorija je van grafa i zivi izmedju frejmova, zato je prolaz sideEffect
+            renderGraph.addPass("ssao", [&, sceneDepth]() {
+                ambientOcclusion.bind(renderTargets.renderWidth(), renderTargets.renderHeight(), projection * view);
+                Shader &ssaoShader = shaderLibrary.get(ssaoProgram);
+                ssaoShader.use();
+                ssaoShader.setInt("sceneDepth", 0);
+                ssaoShader.setInt("history", 1);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderGraph.texture(sceneDepth));
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, ambientOcclusion.history());
+                glActiveTexture(GL_TEXTURE0);
+                ssaoShader.setVec2("renderSize", renderTargets.renderWidth(), renderTargets.renderHeight());
+                ssaoShader.setMat4("projection", projection);
+                ssaoShader.setMat4("inverseProjection", glm::inverse(projection));
+                ssaoShader.setMat4("inverseView", glm::inverse(view));
+                ssaoShader.setMat4("previousViewProjection", ambientOcclusion.previousViewProjection());
+                ssaoShader.setVec2("historyScale", ambientOcclusion.historyScale());
+                ssaoShader.setBool("historyValid", programState->ssaoTemporal && ambientOcclusion.hasHistory());
+                ssaoShader.setFloat("historyWeight", 0.1f);
+                glUniform3fv(glGetUniformLocation(ssaoShader.ID, "samples"), AmbientOcclusion::MAX_SAMPLES, &ambientOcclusion.kernel()[0][0]);
+                // bez istorije nema ko da usrednji sum, pa se uzima puni broj uzoraka
+                ssaoShader.setInt("sampleCount", programState->ssaoTemporal ? ambientOcclusion.sampleCount() : programState->ssaoMaxSamples);
+                ssaoShader.setFloat("radius", programState->ssaoRadius);
+                ssaoShader.setFloat("bias", programState->ssaoBias);
+                ssaoShader.setFloat("intensity", programState->ssaoIntensity);
+                ssaoShader.setInt("frame", programState->ssaoTemporal ? (int) (ambientOcclusion.frame() % 64) : 0);
+                renderQuad();
+            }).read(sceneDepth).sideEffect();
+
+            renderGraph.addPass("ssaoUpsample", [&, sceneDepth]() {
+                Shader &upsampleShader = shaderLibrary.get(ssaoUpsampleProgram);
+                upsampleShader.use();
+                upsampleShader.setInt("sceneDepth", 0);
+                upsampleShader.setInt("occlusion", 1);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderGraph.texture(sceneDepth));
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, ambientOcclusion.texture());
+                glActiveTexture(GL_TEXTURE0);
+                glUniform2i(glGetUniformLocation(upsampleShader.ID, "occlusionSize"), ambientOcclusion.width(), ambientOcclusion.height());
+                upsampleShader.setVec2("renderSize", renderTargets.renderWidth(), renderTargets.renderHeight());
+                upsampleShader.setMat4("inverseProjection", glm::inverse(projection));
+                renderQuad();
+            }).read(sceneDepth).write(occlusion);
+        };
+
+        if (programState->deferred) {
+            // =====================deferred: G-buffer, pa osvetljenje u prostoru ekrana============================================
+            // gbuffer pise svaki piksel sa geometrijom, ostali se ne citaju (dubina 1), pa nema brisanja
+            RenderGraph::TextureDesc gbufferDesc;
+            RenderGraph::Resource gAlbedoSpec = renderGraph.createTexture("gAlbedoSpec", gbufferDesc);
+            RenderGraph::Resource gNormal = renderGraph.createTexture("gNormal", gbufferDesc);
+
+            renderGraph.addPass("gbuffer", [&]() {
+                if (programState->UsesDepthPrepass()) {
+                    glDepthFunc(GL_EQUAL);
+                    glDepthMask(GL_FALSE);
+                }
+                Shader &gbufferShader = shaderLibrary.get(gbufferProgram);
+                gbufferShader.use();
+                gbufferShader.setMat4("projection", projection);
+                gbufferShader.setMat4("view", view);
+                entities.each<Renderable>([&](const Renderable &object) {
+                    if (!object.transparent)
+                        DrawSceneObject(object, sceneGraph, gbufferShader);
+                });
+                glDepthFunc(GL_LESS);
+                glDepthMask(GL_TRUE);
+            }).write(gAlbedoSpec).write(gNormal).depth(sceneDepth);
+            if (programState->ssao)
+                addAmbientOcclusionPasses();
+
+            // svetla ne zavise od broja objekata: usmereno i lampa preko ekrana, point svetla samo u svojoj zapremini
+            RenderGraph::PassBuilder lightingPass = renderGraph.addPass("deferredLighting", [&, gAlbedoSpec, gNormal, sceneDepth, occlusion]() {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderGraph.texture(gAlbedoSpec));
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, renderGraph.texture(gNormal));
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, renderGraph.texture(sceneDepth));
+                glActiveTexture(GL_TEXTURE0);
+                glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+                auto setGBufferUniforms = [&](Shader &shader) {
+                    shader.setInt("gAlbedoSpec", 0);
+                    shader.setInt("gNormal", 1);
+                    shader.setInt("gDepth", 2);
+                    shader.setVec2("renderSize", renderTargets.renderWidth(), renderTargets.renderHeight());
+                    shader.setMat4("inverseViewProjection", inverseViewProjection);
+                    shader.setVec3("viewPosition", programState->camera.Position);
+                    shader.setFloat("shininess", 32.0f);
+                };
+
+                //=============================dirlight i flashlight=========================================================
+                unsigned int directionalVariant = (spotlightOn ? shaderLibrary.keyBit(deferredDirectionalProgram, "SPOTLIGHT") : 0)
+                                                  | (programState->shadows ? shaderLibrary.keyBit(deferredDirectionalProgram, "SHADOWS") : 0)
+                                                  | (programState->ssao ? shaderLibrary.keyBit(deferredDirectionalProgram, "SSAO") : 0);
+                Shader &directionalShader = shaderLibrary.get(deferredDirectionalProgram, directionalVariant);
+                directionalShader.use();
+                setGBufferUniforms(directionalShader);
+                setShadowUniforms(directionalShader);
+                setAmbientOcclusionUniforms(directionalShader, renderGraph.texture(occlusion));
+                directionalShader.setVec3("dirLight.direction", programState->dirLightDir);
+                directionalShader.setVec3("dirLight.ambient", glm::vec3(programState->dirLightAmbDiffSpec.x));
+                directionalShader.setVec3("dirLight.diffuse", glm::vec3(programState->dirLightAmbDiffSpec.y));
+                directionalShader.setVec3("dirLight.specular", glm::vec3(programState->dirLightAmbDiffSpec.z));
+                if (spotlightOn) {
+                    directionalShader.setVec3("spotLight.position", programState->camera.Position);
+                    directionalShader.setVec3("spotLight.direction", programState->camera.Front);
+                    directionalShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
+                    directionalShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
+                    directionalShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
+                    directionalShader.setFloat("spotLight.constant", 1.0f);
+                    directionalShader.setFloat("spotLight.linear", 0.09);
+                    directionalShader.setFloat("spotLight.quadratic", 0.032);
+                    directionalShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+                    directionalShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+                }
+                renderQuad();
+
+                //=============================pointlights: zapremine od ball.obj=============================================
+                unsigned int pointVariant = (programState->pointShadows ? shaderLibrary.keyBit(deferredPointProgram, "POINT_SHADOWS") : 0)
+                                            | (programState->ssao ? shaderLibrary.keyBit(deferredPointProgram, "SSAO") : 0);
+                Shader &pointShader = shaderLibrary.get(deferredPointProgram, pointVariant);
+                pointShader.use();
+                setGBufferUniforms(pointShader);
+                setPointShadowUniforms(pointShader);
+                setAmbientOcclusionUniforms(pointShader, renderGraph.texture(occlusion));
+                pointShader.setMat4("projection", projection);
+                pointShader.setMat4("view", view);
+                pointShader.setVec3("light.ambient", pointLight.ambient);
+                pointShader.setVec3("light.diffuse", pointLight.diffuse);
+                pointShader.setVec3("light.specular", pointLight.specular);
+                pointShader.setFloat("light.constant", pointLight.constant);
+                pointShader.setFloat("light.linear", pointLight.linear);
+                pointShader.setFloat("light.quadratic", pointLight.quadratic);
+                float radius = PointLightRadius(pointLight);
+                pointShader.setFloat("radius", radius);
+                // doprinosi svetala se sabiraju; crtaju se unutrasnje strane, pa radi i kad je kamera u zapremini
+                glBlendFunc(GL_ONE, GL_ONE);
+                glCullFace(GL_BACK);
+                for (int light = 0; light < 2; light++) {
+                    const glm::vec3 &position = pointLightPositions[light];
+                    glm::mat4 modelVolume = glm::mat4(1.0f);
+                    modelVolume = glm::translate(modelVolume, position);
+                    // temena ball.obj leze na sferi, stranice malo unutar nje
+                    modelVolume = glm::scale(modelVolume, glm::vec3(radius * 1.05f / lightModelRadius));
+                    pointShader.setMat4("model", modelVolume);
+                    pointShader.setVec3("light.position", position);
+                    pointShader.setInt("lightIndex", light);
+                    lightModel.DrawDepth();
+                }
+                glCullFace(GL_FRONT);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            });
+            lightingPass.read(gAlbedoSpec).read(gNormal).read(sceneDepth).write(hdrColor);
+            if (programState->ssao)
+                lightingPass.read(occlusion);
+
+            // forward shader pise svetle delove sam, ovde se izdvajaju iz osvetljene scene (pre neba, kao i u forward-u)
+            if (bloom) {
+                renderGraph.addPass("deferredBright", [&]() {
+                    Shader &brightShader = shaderLibrary.get(brightProgram);
+                    brightShader.use();
+                    brightShader.setInt("scene", 0);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, renderGraph.texture(hdrColor));
+                    renderQuad();
+                }).read(hdrColor).write(brightColor);
+            }
+        } else {
+            if (programState->ssao)
+                addAmbientOcclusionPasses();
+            // =====================render scene into floating point framebuffer============================================
+            RenderGraph::PassBuilder scenePass = renderGraph.addPass("scene", [&, occlusion]() {
+                // shader variants without the bright output when bloom is off and without the spotlight when it is off
+                unsigned int lightingVariant = (bloom ? shaderLibrary.keyBit(lightingProgram, "BLOOM") : 0)
+                                               | (spotlightOn ? shaderLibrary.keyBit(lightingProgram, "SPOTLIGHT") : 0)
+                                               | (programState->shadows ? shaderLibrary.keyBit(lightingProgram, "SHADOWS") : 0)
+                                               | (programState->pointShadows ? shaderLibrary.keyBit(lightingProgram, "POINT_SHADOWS") : 0)
+                                               | (programState->ssao ? shaderLibrary.keyBit(lightingProgram, "SSAO") : 0);
+                Shader &ourShader = shaderLibrary.get(lightingProgram, lightingVariant);
+                // don't forget to enable shader before setting uniforms
+                ourShader.use();
+                ourShader.setMat4("projection", projection);
+                ourShader.setMat4("view", view);
+
+                ourShader.setVec3("viewPosition", programState->camera.Position);
+                ourShader.setFloat("material.shininess", 32.0f);
+                setShadowUniforms(ourShader);
+                setPointShadowUniforms(ourShader);
+                setAmbientOcclusionUniforms(ourShader, renderGraph.texture(occlusion));
+
+                //=============================dirlight=========================================================================
+                ourShader.setVec3("dirLight.direction", programState->dirLightDir);
+                ourShader.setVec3("dirLight.ambient", glm::vec3(programState->dirLightAmbDiffSpec.x));
+                ourShader.setVec3("dirLight.diffuse", glm::vec3(programState->dirLightAmbDiffSpec.y));
+                ourShader.setVec3("dirLight.specular", glm::vec3(programState->dirLightAmbDiffSpec.z));
+                //=============================pointlight 1=========================================================================
+                ourShader.setVec3("pointLights[0].position", pointLightPositions[0]);
+                ourShader.setVec3("pointLights[0].ambient", pointLight.ambient);
+                ourShader.setVec3("pointLights[0].diffuse", pointLight.diffuse);
+                ourShader.setVec3("pointLights[0].specular", pointLight.specular);
+                ourShader.setFloat("pointLights[0].constant", pointLight.constant);
+                ourShader.setFloat("pointLights[0].linear", pointLight.linear);
+                ourShader.setFloat("pointLights[0].quadratic", pointLight.quadratic);
+                //=============================pointlight 2=========================================================================
+                ourShader.setVec3("pointLights[1].position", pointLightPositions[1]);
+                ourShader.setVec3("pointLights[1].ambient", pointLight.ambient);
+                ourShader.setVec3("pointLights[1].diffuse", pointLight.diffuse);
+                ourShader.setVec3("pointLights[1].specular", pointLight.specular);
+                ourShader.setFloat("pointLights[1].constant", pointLight.constant);
+                ourShader.setFloat("pointLights[1].linear", pointLight.linear);
+                ourShader.setFloat("pointLights[1].quadratic", pointLight.quadratic);
+                //=============================flashlight=========================================================================
+                if (spotlightOn) {
+                    ourShader.setVec3("spotLight.position", programState->camera.Position);
+                    ourShader.setVec3("spotLight.direction", programState->camera.Front);
+                    ourShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
+                    ourShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
+                    ourShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
+                    ourShader.setFloat("spotLight.constant", 1.0f);
+                    ourShader.setFloat("spotLight.linear", 0.09);
+                    ourShader.setFloat("spotLight.quadratic", 0.032);
+                    ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+                    ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+                }
+
+                //==================================================================RENDEROVANJE MODELA===========================================
+                // posle depth pre-pass-a dubina je vec upisana: sejduje se samo vidljivi fragment svakog piksela
+                if (programState->UsesDepthPrepass()) {
+                    glDepthFunc(GL_EQUAL);
+                    glDepthMask(GL_FALSE);
+                }
+                Shader &modelShader = programState->overdrawView ? overdrawShader : ourShader;
+                if (programState->overdrawView) {
+                    // broji sejdovane fragmente u hdrColor (obrisan na 0) i preko occlusion query-ja
+                    overdrawShader.use();
+                    overdrawShader.setMat4("projection", projection);
+                    overdrawShader.setMat4("view", view);
+                    glBlendFunc(GL_ONE, GL_ONE);
+                    overdrawCounter.begin();
+                }
+                entities.each<Renderable>([&](const Renderable &object) {
+                    if (!object.transparent)
+                        DrawSceneObject(object, sceneGraph, modelShader);
+                });
+                if (programState->overdrawView) {
+                    overdrawCounter.end();
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                }
+                glDepthFunc(GL_LESS);
+                glDepthMask(GL_TRUE);
+            });
+            scenePass.write(hdrColor).depth(sceneDepth);
+            if (programState->ssao)
+                scenePass.read(occlusion);
+            // single attachment framebuffer without bloom; nothing then writes brightColor and the blur chain reading it is culled
+            if (bloom)
+                scenePass.write(brightColor);
+        }
 
-    programState->cubemapTexture = loadCubemap(programState->faces);
+        // =====================Hi-Z: najdalja dubina neprovidne scene ide nazad na CPU za occlusion test narednih frejmova
+        if (programState->occlusionCulling && !programState->occlusionCpuRaster) {
+            RenderGraph::TextureDesc hizDesc; // upisuje se samo HIZ_WIDTH x HIZ_HEIGHT ugao, a samo se on i cita
+            hizDesc.internalFormat = GL_R32F;
+            RenderGraph::Resource hizDepth = renderGraph.createTexture("hizDepth", hizDesc);
+            renderGraph.addPass("hizDownsample", [&, sceneDepth]() {
+                Shader &hizShader = shaderLibrary.get(hizDownsampleProgram);
+                hizShader.use();
+                hizShader.setInt("depth", 0);
+                hizShader.setVec2("scale", (float) renderTargets.renderWidth() / HIZ_WIDTH,
+                                  (float) renderTargets.renderHeight() / HIZ_HEIGHT);
+                glViewport(0, 0, HIZ_WIDTH, HIZ_HEIGHT);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderGraph.texture(sceneDepth));
+                renderQuad();
+                // stize posle frejm-dva, bez cekanja GPU
+                depthReadback.read(HIZ_WIDTH, HIZ_HEIGHT, projection * view);
+            }).read(sceneDepth).write(hizDepth).sideEffect();
+        }
 
-    skyboxShader.use();
-    skyboxShader.setInt("skybox", 0);
+        renderGraph.addPass("skybox", [&]() {
+            //==================================CRTANJE SKYBOXA=============================================================
+            if (programState->overdrawView)
+                return;
+            glDepthFunc(GL_LEQUAL);
+            skyboxShader.use();
+            // sampleri se postavljaju svaki frejm jer ponovo ucitan program krece od podrazumevanih vrednosti
+            skyboxShader.setInt("skybox", 0);
+            skyboxShader.setMat4("view", glm::mat4(glm::mat3(view)));
+            skyboxShader.setMat4("projection", projection);
+            // skybox cube
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, programState->cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS); // set depth function back to default
+        }).write(hdrColor).depth(sceneDepth);
+
+        // =====================providni objekti: weighted blended OIT============================================
+        // bez sortiranja: slojevi se sabiraju u oitAccum/oitWeight (depth test protiv scene, bez upisa dubine),
+        // pa ih oitResolve sklapa preko hdrColor pre bloom-a
+        RenderGraph::TextureDesc accumDesc;
+        accumDesc.clear = true;
+        accumDesc.clearValue = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // alfa = revealage, 1 dok nista nije nacrtano
+        RenderGraph::Resource oitAccum = renderGraph.createTexture("oitAccum", accumDesc);
+        RenderGraph::TextureDesc weightDesc;
+        weightDesc.internalFormat = GL_R16F;
+        weightDesc.clear = true;
+        RenderGraph::Resource oitWeight = renderGraph.createTexture("oitWeight", weightDesc);
+
+        renderGraph.addPass("transparent", [&]() {
+            if (programState->overdrawView)
+                return;
+            Shader &transparentShader = shaderLibrary.get(transparentProgram);
+            // GL 3.3 nema blend po attachment-u: rgb se sabira u oba cilja, alfa akumulacije mnozi (1 - alfa)
+            glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+            //Podesavamo shader za providnost, moramo da imamo svetla koja zalimo da uticu na providne objekte
+            transparentShader.use();
+            transparentShader.setMat4("projection", projection);
+            transparentShader.setMat4("view", view);
+            transparentShader.setVec3("viewPosition", programState->camera.Position);
+            transparentShader.setFloat("material.shininess", 32.0f);
+            //=============================dirlight=========================================================================
+            transparentShader.setVec3("dirLight.direction", programState->dirLightDir);
+            transparentShader.setVec3("dirLight.ambient", glm::vec3(programState->dirLightAmbDiffSpec.x));
+            transparentShader.setVec3("dirLight.diffuse", glm::vec3(programState->dirLightAmbDiffSpec.y));
+            transparentShader.setVec3("dirLight.specular", glm::vec3(programState->dirLightAmbDiffSpec.z));
+            //=============================pointlight 1=========================================================================
+            transparentShader.setVec3("pointLights[0].position", pointLightPositions[0]);
+            transparentShader.setVec3("pointLights[0].ambient", pointLight.ambient);
+            transparentShader.setVec3("pointLights[0].diffuse", pointLight.diffuse);
+            transparentShader.setVec3("pointLights[0].specular", pointLight.specular);
+            transparentShader.setFloat("pointLights[0].constant", pointLight.constant);
+            transparentShader.setFloat("pointLights[0].linear", pointLight.linear);
+            transparentShader.setFloat("pointLights[0].quadratic", pointLight.quadratic);
+            //=============================pointlight 2=========================================================================
+            transparentShader.setVec3("pointLights[1].position", pointLightPositions[1]);
+            transparentShader.setVec3("pointLights[1].ambient", pointLight.ambient);
+            transparentShader.setVec3("pointLights[1].diffuse", pointLight.diffuse);
+            transparentShader.setVec3("pointLights[1].specular", pointLight.specular);
+            transparentShader.setFloat("pointLights[1].constant", pointLight.constant);
+            transparentShader.setFloat("pointLights[1].linear", pointLight.linear);
+            transparentShader.setFloat("pointLights[1].quadratic", pointLight.quadratic);
+            //render light balls
+            entities.each<Renderable>([&](const Renderable &object) {
+                if (object.transparent)
+                    DrawSceneObject(object, sceneGraph, transparentShader);
+            });
+            glDepthMask(GL_TRUE);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }).write(oitAccum).write(oitWeight).depth(sceneDepth);
+
+        RenderGraph::PassBuilder oitResolve = renderGraph.addPass("oitResolve", [&, oitAccum, oitWeight]() {
+            Shader &oitResolveShader = shaderLibrary.get(oitResolveProgram, bloom ? shaderLibrary.keyBit(oitResolveProgram, "BLOOM") : 0);
+            oitResolveShader.use();
+            oitResolveShader.setInt("accum", 0);
+            oitResolveShader.setInt("weight", 1);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, renderGraph.texture(oitAccum));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, renderGraph.texture(oitWeight));
+            glActiveTexture(GL_TEXTURE0);
+            renderQuad();
+        });
+        oitResolve.read(oitAccum).read(oitWeight).write(hdrColor);
+        if (bloom)
+            oitResolve.write(brightColor);
 
-    //==============================================point light=========================================================
-    PointLight& pointLight = programState->pointLight;
-    pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
-    pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
-    pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-
-    pointLight.constant = 0.3f;
-    pointLight.linear = 0.8f;
-    pointLight.quadratic = 0.4f;
-
-    // =========================Podesavanje shadera=====================================================================
-    ourShader.use();
-    ourShader.setInt("diffuseTexture", 0);
-    blurShader.use();
-    blurShader.setInt("image", 0);
-    bloomFinalShader.use();
-    bloomFinalShader.setInt("scene", 0);
-    bloomFinalShader.setInt("bloomBlur", 1);
+        // =========================blur bright fragments with two-pass Gaussian Blur========================================
+        // every iteration gets its own resource, the graph aliases them onto two ping-pong textures
+        RenderGraph::TextureDesc blurDesc; // fullscreen quad overwrites everything, no clear
+        RenderGraph::Resource blurInput = brightColor;
+        for (unsigned int i = 0; i < blurAmount; i++) {
+            RenderGraph::Resource blurOutput = renderGraph.createTexture("bloomBlur" + std::to_string(i), blurDesc);
+            bool horizontal = i % 2 == 0;
+            renderGraph.addPass("blur" + std::to_string(i), [&, horizontal, blurInput]() {
+                blurShader.use();
+                blurShader.setInt("image", 0);
+                blurShader.setVec2("uvScale", renderTargets.uvScaleX(), renderTargets.uvScaleY());
+                blurShader.setInt("horizontal", horizontal);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, renderGraph.texture(blurInput));
+                renderQuad();
+            }).read(blurInput).write(blurOutput);
+            blurInput = blurOutput;
+        }
+        RenderGraph::Resource bloomBlur = blurInput;
+
+        // now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
+        //____________________________________________________________________________________________________
+        RenderGraph::PassBuilder composite = renderGraph.addPass("composite", [&, bloomBlur]() {
+            Shader &bloomFinalShader = shaderLibrary.get(bloomFinalProgram, programState->overdrawView ? shaderLibrary.keyBit(bloomFinalProgram, "OVERDRAW") : 0);
+            bloomFinalShader.use();
+            bloomFinalShader.setInt("scene", 0);
+            bloomFinalShader.setInt("bloomBlur", 1);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, renderGraph.texture(hdrColor));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, bloom ? renderGraph.texture(bloomBlur) : 0);
+            glActiveTexture(GL_TEXTURE0);
+            bloomFinalShader.setInt("bloom", bloom);
+            bloomFinalShader.setFloat("exposure", exposure);
+            // the scene only covers renderScale of the targets, sampling that region upscales it to the window
+            bloomFinalShader.setVec2("uvScale", renderTargets.uvScaleX(), renderTargets.uvScaleY());
+            renderQuad();
+        });
+        composite.read(hdrColor).write(backbuffer).fullResolution();
+        // without bloom nothing reads the blur chain, so compile() culls it and drops the bright attachment
+        if (bloom)
+            composite.read(bloomBlur);
+
+        renderGraph.compile();
+        graphBloom = bloom;
+        graphDepthPrepass = programState->UsesDepthPrepass();
+        graphDeferred = programState->deferred;
+        graphSsao = programState->ssao;
+        graphGpuOcclusion = programState->occlusionCulling && !programState->occlusionCpuRaster;
+        programState->graphPasses = renderGraph.passCount();
+        programState->graphCulledPasses = renderGraph.culledPassCount();
+        programState->graphTextures = renderGraph.physicalTextureCount();
+    };
+
+    // ==============================================SIMULACIJA======================================================
+    // fiksni korak na svojoj niti: dok se ovaj frejm renderuje, simuliraju se koraci za sledeci.
+    // Simulacija pise samo Transform, PreviousTransform i simulationState; render cita Renderable, PointLight i
+    // graf scene, a interpolirano stanje preuzima na pocetku frejma, posle wait()
+    FixedTimestep timestep(SIMULATION_STEP);
+    SimulationThread simulation;
+    JobSystem simulationJobs(1);
+    SimulationState simulationState;
+    simulationState.cameraPosition = programState->camera.Position;
+    simulationState.previousCameraPosition = programState->camera.Position;
+    simulationState.exposure = exposure;
+    SimulationTask simulationTask;
+    simulationTask.entities = &entities;
+    simulationTask.jobs = &simulationJobs;
+    simulationTask.state = &simulationState;
+    unsigned int frameIndex = 0;
+    lastFrame = glfwGetTime();
 
     // render loop
     // -----------
@@ -356,200 +1656,210 @@ int main() {
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-        float time = currentFrame;
+        time = currentFrame;
+        frameArena.reset();
+        AllocationCounter::Snapshot frameStart = AllocationCounter::snapshot();
+
+        // stanje izmedju poslednja dva koraka, pomereni modeli u graf scene i lampe u svetla
+        simulation.wait();
+        float alpha = timestep.alpha();
+        programState->entityUpdateMs = simulationState.updateMs;
+        programState->camera.Position = glm::mix(simulationState.previousCameraPosition, simulationState.cameraPosition, alpha);
+        exposure = simulationState.exposure;
+        entities.each<Transform, PreviousTransform, Renderable>([&](const Transform &transform, const PreviousTransform &previous, const Renderable &object) {
+            Transform blended = transform;
+            blended.position = glm::mix(previous.position, transform.position, alpha);
+            blended.rotation = glm::mix(previous.rotation, transform.rotation, alpha);
+            sceneGraph.setLocal(object.node, ComposeTransform(blended));
+        });
+        unsigned int lightCount = 0;
+        entities.each<Transform, PreviousTransform, PointLight>([&](const Transform &transform, const PreviousTransform &previous, PointLight &light) {
+            light = programState->pointLight;
+            light.position = glm::mix(previous.position, transform.position, alpha);
+            if (lightCount < 2)
+                pointLightPositions[lightCount++] = light.position;
+        });
+        programState->sceneNodesUpdated = sceneGraph.update();
+        entities.each<Renderable>([&](Renderable &object) {
+            if (!object.dynamic)
+                return;
+            for (unsigned int i = 0; i < object.localBounds.size(); i++)
+                object.meshBounds[i] = object.localBounds[i].transformed(sceneGraph.world(object.meshNodes[i]));
+        });
 
         // input
         // -----
-        processInput(window);
-
-
-        // render
-        // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // =====================render scene into floating point framebuffer============================================
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        simulationTask.input = processInput(window);
+        // snimak za poredjenje ostaje na pocetnom stanju scene, kao sto ga vidi path tracer
+        simulationTask.steps = timestep.advance(capturing ? 0.0 : deltaTime);
+        simulationTask.firstTick = timestep.tick() - simulationTask.steps + 1;
+        simulation.run([&simulationTask]() {
+            const SimulationTask &task = simulationTask;
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < task.steps; i++)
+                SimulateStep(*task.entities, *task.jobs, *task.state, task.input, task.firstTick + i);
+            task.state->steps = task.steps;
+            task.state->updateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        });
+
+        // shaders that finished compiling in the background are swapped in before the frame starts
+        shaderReloader.update();
+        programState->shaderReloads = shaderReloader.reloadCount();
+        programState->shaderError = shaderReloader.lastError();
+
+        // render scale for this frame: follows the frame-time budget when dynamic resolution is on
+        if (profiler->hasFrameResult())
+            programState->gpuFrameMs = profiler->frameGpuMs();
+        programState->renderScale = programState->dynamicResolution.update(programState->gpuFrameMs, programState->renderScale);
+        renderTargets.renderScale = programState->renderScale;
+        if (renderTargets.resize(windowWidth, windowHeight) || !renderGraph.compiled() || graphBloom != bloom
+            || graphDepthPrepass != programState->UsesDepthPrepass() || graphDeferred != programState->deferred
+            || graphSsao != programState->ssao
+            || graphGpuOcclusion != (programState->occlusionCulling && !programState->occlusionCpuRaster)) {
+            // dubina starog izvora ne vazi za novi
+            hiz.invalidate();
+            buildRenderGraph();
+        }
+        // SSAO ciljevi prate prozor; broj uzoraka se podesava prema izmerenom vremenu oba prolaza
+        if (programState->ssao) {
+            {
+                AllocationScope scope(MEMORY_RENDER_TARGETS);
+                ambientOcclusion.resize(renderTargets.width(), renderTargets.height());
+            }
+            if (programState->ssaoTemporal)
+                ambientOcclusion.updateBudget(profiler->scopeGpuMs("ssao") + profiler->scopeGpuMs("ssaoUpsample"),
+                                              programState->ssaoBudgetMs, programState->ssaoMaxSamples);
+            programState->ssaoSamples = programState->ssaoTemporal ? ambientOcclusion.sampleCount() : programState->ssaoMaxSamples;
+            programState->ssaoMs = ambientOcclusion.averageMs();
+        }
+        // overdraw prikaz broji od nule
+        renderGraph.setClearValue(hdrColor, programState->overdrawView ? glm::vec4(0.0f) : glm::vec4(programState->clearColor, 1.0f));
+        if (programState->overdrawView && overdrawCounter.hasResult())
+            programState->overdraw = (float) overdrawCounter.lastCount() / (renderTargets.renderWidth() * renderTargets.renderHeight());
 
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-
-        //=============================dirlight=========================================================================
-        ourShader.setVec3("dirLight.direction", programState->dirLightDir);
-        ourShader.setVec3("dirLight.ambient", glm::vec3(programState->dirLightAmbDiffSpec.x));
-        ourShader.setVec3("dirLight.diffuse", glm::vec3(programState->dirLightAmbDiffSpec.y));
-        ourShader.setVec3("dirLight.specular", glm::vec3(programState->dirLightAmbDiffSpec.z));
-        //=============================pointlight 1=========================================================================
-        ourShader.setVec3("pointLights[0].position", glm::vec3(-1.75f ,sin(time)*0.3f+0.6f, 0.9f));
-        ourShader.setVec3("pointLights[0].ambient", pointLight.ambient);
-        ourShader.setVec3("pointLights[0].diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLights[0].specular", pointLight.specular);
-        ourShader.setFloat("pointLights[0].constant", pointLight.constant);
-        ourShader.setFloat("pointLights[0].linear", pointLight.linear);
-        ourShader.setFloat("pointLights[0].quadratic", pointLight.quadratic);
-        //=============================pointlight 2=========================================================================
-        ourShader.setVec3("pointLights[1].position", glm::vec3(4.35f ,sin(time)*0.2f+0.6f, 1.1f));
-        ourShader.setVec3("pointLights[1].ambient", pointLight.ambient);
-        ourShader.setVec3("pointLights[1].diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLights[1].specular", pointLight.specular);
-        ourShader.setFloat("pointLights[1].constant", pointLight.constant);
-        ourShader.setFloat("pointLights[1].linear", pointLight.linear);
-        ourShader.setFloat("pointLights[1].quadratic", pointLight.quadratic);
-        //=============================flashlight=========================================================================
-        if (spotlightOn) {
-            ourShader.setVec3("spotLight.position", programState->camera.Position);
-            ourShader.setVec3("spotLight.direction", programState->camera.Front);
-            ourShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-            ourShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-            ourShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-            ourShader.setFloat("spotLight.constant", 1.0f);
-            ourShader.setFloat("spotLight.linear", 0.09);
-            ourShader.setFloat("spotLight.quadratic", 0.032);
-            ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-            ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-        }else{
-            ourShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-            ourShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
-        }
-
-        //==================================================================RENDEROVANJE MODELA===========================================
-        //render sobe
-        glm::mat4 modelRooms = glm::mat4(1.0f);
-        modelRooms = glm::translate(modelRooms,glm::vec3(0.0f,-0.5f,0.0f));
-        modelRooms = glm::scale(modelRooms, glm::vec3(0.25f));
-        ourShader.setMat4("model", modelRooms);
-        roomsModel.Draw(ourShader);
-        //render skulptura
-        glm::mat4 modelSk = glm::mat4(1.0f);
-        modelSk = glm::translate(modelSk,glm::vec3(0.5f,-0.7f,2.15f));
-        modelSk = glm::scale(modelSk, glm::vec3(1.1));
-        modelSk = glm::rotate(modelSk,glm::radians(-90.0f), glm::vec3(1.0f ,0.0f, 0.0f));
-        modelSk = glm::rotate(modelSk,glm::radians(60.0f), glm::vec3(0.0f ,0.0f, 1.0f));
-        ourShader.setMat4("model", modelSk);
-        skModel.Draw(ourShader);
-        //render grave
-        glm::mat4 modelGrave = glm::mat4(1.0f);
-        modelGrave = glm::translate(modelGrave,glm::vec3(4.5f,-0.45f,1.15f));
-        modelGrave = glm::scale(modelGrave, glm::vec3(0.25f));
-        modelGrave = glm::rotate(modelGrave,glm::radians(-105.0f), glm::vec3(0.0f ,1.0f, 0.0f));
-        ourShader.setMat4("model", modelGrave);
-        graveModel.Draw(ourShader);
-        //render pecurka
-        glm::mat4 modelPecurka = glm::mat4(1.0f);
-        modelPecurka = glm::translate(modelPecurka,glm::vec3(-1.65f,-0.35f,0.95f));
-        modelPecurka = glm::scale(modelPecurka, glm::vec3(0.1));
-        modelPecurka = glm::rotate(modelPecurka,glm::radians(-45.0f), glm::vec3(0.0f ,1.0f, 0.0f));
-        ourShader.setMat4("model", modelPecurka);
-        pecurkaModel.Draw(ourShader);
-        
-        //Podesavamo shader za providnost, moramo da imamo svetla koja zalimo da uticu na providne objekte
-        transparentShader.use();
-        transparentShader.setMat4("projection", projection);
-        transparentShader.setMat4("view", view);
-        transparentShader.setVec3("viewPosition", programState->camera.Position);
-        transparentShader.setFloat("material.shininess", 32.0f);
-        //=============================dirlight=========================================================================
-        transparentShader.setVec3("dirLight.direction", programState->dirLightDir);
-        transparentShader.setVec3("dirLight.ambient", glm::vec3(programState->dirLightAmbDiffSpec.x));
-        transparentShader.setVec3("dirLight.diffuse", glm::vec3(programState->dirLightAmbDiffSpec.y));
-        transparentShader.setVec3("dirLight.specular", glm::vec3(programState->dirLightAmbDiffSpec.z));
-        //=============================pointlight 1=========================================================================
-        transparentShader.setVec3("pointLights[0].position", glm::vec3(-1.75f ,sin(time)*0.3f+0.6f, 0.9f));
-        transparentShader.setVec3("pointLights[0].ambient", pointLight.ambient);
-        transparentShader.setVec3("pointLights[0].diffuse", pointLight.diffuse);
-        transparentShader.setVec3("pointLights[0].specular", pointLight.specular);
-        transparentShader.setFloat("pointLights[0].constant", pointLight.constant);
-        transparentShader.setFloat("pointLights[0].linear", pointLight.linear);
-        transparentShader.setFloat("pointLights[0].quadratic", pointLight.quadratic);
-        //=============================pointlight 2=========================================================================
-        transparentShader.setVec3("pointLights[1].position", glm::vec3(4.35f ,sin(time)*0.2f+0.6f, 1.1f));
-        transparentShader.setVec3("pointLights[1].ambient", pointLight.ambient);
-        transparentShader.setVec3("pointLights[1].diffuse", pointLight.diffuse);
-        transparentShader.setVec3("pointLights[1].specular", pointLight.specular);
-        transparentShader.setFloat("pointLights[1].constant", pointLight.constant);
-        transparentShader.setFloat("pointLights[1].linear", pointLight.linear);
-        transparentShader.setFloat("pointLights[1].quadratic", pointLight.quadratic);
-        
-        //render light ball 1
-        glm::mat4 modelLight = glm::mat4(1.0f);
-        modelLight = glm::translate(modelLight,glm::vec3(-1.75f ,sin(time)*0.3f+0.6f, 0.9f));
-        modelLight = glm::scale(modelLight, glm::vec3(0.095));
-        modelLight = glm::rotate(modelLight,glm::radians(time*60.0f), glm::vec3(1.0f ,0.0f, 0.0f));
-        modelLight = glm::rotate(modelLight,glm::radians(time*80.0f), glm::vec3(0.0f ,1.0f, 0.0f));
-        modelLight = glm::rotate(modelLight,glm::radians(time*100.0f), glm::vec3(0.0f ,0.0f, 1.0f));
-        ourShader.setMat4("model", modelLight);
-        lightModel.Draw(ourShader);
-        //render light ball 2
-        modelLight = glm::mat4(1.0f);
-        modelLight = glm::translate(modelLight,glm::vec3(4.35f ,sin(time)*0.2f+0.6f, 1.1f));
-        modelLight = glm::scale(modelLight, glm::vec3(0.05f));
-        ourShader.setMat4("model", modelLight);
-        lightModel.Draw(ourShader);
-
-        //==================================CRTANJE SKYBOXA=============================================================
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, programState->cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
+        projection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                      (float) renderTargets.width() / (float) renderTargets.height(), 0.1f, 100.0f);
+        view = programState->camera.GetViewMatrix();
+        // kaskade se namestaju na deo pogleda do shadowDistance; tekstura se pravi ponovo samo kad se promeni kvalitet
+        if (programState->shadows) {
+            AllocationScope scope(MEMORY_SHADOWS);
+            shadowMap.resize(programState->shadowResolution, programState->shadowCascades);
+            shadowMap.fit(view, glm::radians(programState->camera.Zoom), (float) renderTargets.width() / (float) renderTargets.height(),
+                          0.1f, std::min(programState->shadowDistance, 100.0f), programState->shadowSplitLambda,
+                          programState->dirLightDir, shadowCasterBounds);
+        }
+        // svetla dobijaju strane u atlasu; sta se zaista crta ponovo odlucuje kes u prolazu pointShadows
+        if (programState->pointShadows) {
+            AllocationScope scope(MEMORY_SHADOWS);
+            pointShadows.resize(programState->pointShadowAtlasSize);
+            pointShadows.setLights(pointLightPositions, (int) lightCount, PointLightRadius(programState->pointLight),
+                                   programState->pointShadowResolution);
+        }
 
-        // =========================blur bright fragments with two-pass Gaussian Blur========================================
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 5;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        // biranje misem: zrak kroz kursor, od bliske do daleke ravni
+        if (programState->pickRequested) {
+            programState->pickRequested = false;
+            auto pickStart = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < pickTargets.size(); i++)
+                sceneBVH.setTransform(i, sceneGraph.world(pickTargets[i].meshNode));
+            sceneBVH.build();
+            glm::vec2 ndc(programState->pickPosition.x * 2.0f - 1.0f, 1.0f - programState->pickPosition.y * 2.0f);
+            glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+            glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+            glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+            glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+            glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+            RayHit hit;
+            programState->pickedName = nullptr;
+            if (sceneBVH.intersect(Ray(origin, direction), hit)) {
+                const PickTarget &target = pickTargets[hit.instance];
+                programState->pickedName = sceneGraph.name(target.node).c_str();
+                programState->pickedMesh = target.mesh;
+                programState->pickedTriangle = hit.triangle;
+                programState->pickedDistance = hit.t;
+            }
+            programState->pickMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pickStart).count();
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
-        //____________________________________________________________________________________________________
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        bloomFinalShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        bloomFinalShader.setInt("bloom", bloom);
-        bloomFinalShader.setFloat("exposure", exposure);
-        renderQuad();
+        // render
+        // ------
+        profiler->setMode("Bloom", bloom);
+        profiler->setMode("Depth pre-pass", programState->UsesDepthPrepass());
+        profiler->setMode("Deferred", programState->deferred);
+        profiler->setMode("SSAO", programState->ssao);
+        profiler->beginFrame();
+        profiler->begin("occlusionCull");
+        cullOpaqueObjects();
+        profiler->end("occlusionCull");
+        renderGraph.execute();
+        profiler->endFrame();
 
         if (programState->ImGuiEnabled)
             DrawImGui(programState);
+        // brojanje staje pre autosave-a: snimak stanja alocira, ali samo na svakih autosaveInterval sekundi
+        AllocationCounter::Snapshot frameAllocations = AllocationCounter::since(frameStart);
+        programState->frameAllocations = (unsigned int) frameAllocations.allocations;
+        programState->frameAllocatedBytes = (unsigned int) frameAllocations.bytes;
+        programState->frameArenaBytes = frameArena.bytesUsed();
+        if (++frameIndex > ALLOCATION_WARMUP_FRAMES && frameAllocations.allocations > 0) {
+            if (programState->allocatingFrames++ == 0)
+                std::cout << "WARNING: frame " << frameIndex << " made " << frameAllocations.allocations
+                          << " heap allocations (" << frameAllocations.bytes << " bytes)" << std::endl;
+        }
+        if (capturing && frameIndex == captureFrame) {
+            if (CaptureBackbuffer(capturePath, windowWidth, windowHeight))
+                std::cout << "Captured frame " << frameIndex << " to " << capturePath << std::endl;
+            glfwSetWindowShouldClose(window, true);
+        }
+        // snimak stanja se pravi ovde, a upisuje na disk u pozadini
+        if (programState->autosave && time - lastAutosave >= programState->autosaveInterval) {
+            stateAutosave.submit(statePath, programState->Serialize());
+            lastAutosave = time;
+        }
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    simulation.wait();
+    // stanje memorije na izlasku, pre ciscenja
+    {
+        std::ofstream memoryJson(memoryJsonPath);
+        MemoryTracker::writeJson(memoryJson);
+    }
 
     glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteBuffers(1, &skyboxVAO);
-
-    programState->SaveToFile("resources/program_state.txt");
+    glDeleteBuffers(1, &skyboxVBO);
+    MemoryTracker::untrack(MemoryTracker::VERTEX_ARRAY, skyboxVAO);
+    MemoryTracker::untrack(MemoryTracker::BUFFER, skyboxVBO);
+    if (programState->cubemapTexture != 0) {
+        glDeleteTextures(1, &programState->cubemapTexture);
+        MemoryTracker::untrack(MemoryTracker::TEXTURE, programState->cubemapTexture);
+    }
+    for (Model &model: sceneModels)
+        model.Destroy();
+    lightModel.Destroy();
+    destroyQuad();
+    shaderReloader.stop();
+    overdrawCounter.destroy();
+    depthReadback.destroy();
+    shadowMap.destroy();
+    pointShadows.destroy();
+    ambientOcclusion.destroy();
+    renderGraph.reset();
+    renderTargets.destroy();
+    shaderLibrary.destroy();
+    profiler->destroy();
+    delete profiler;
+    // sve sto je i dalje prijavljeno nije obrisano
+    unsigned int leaks = MemoryTracker::reportLeaks(std::cout);
+    if (leaks == 0)
+        std::cout << "No GL objects leaked" << std::endl;
+
+    stateAutosave.stop();
+    if (!capturing)
+        programState->SaveToFile(statePath);
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -563,6 +1873,536 @@ int main() {
 // __________________________________________________________________________________________
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
+// rasterizes every scene model, whole and simplified, from a ring of viewpoints at the Hi-Z resolution,
+// on one thread and on the whole job system, and prints the throughput in triangles per millisecond
+int RunOcclusionBenchmark() {
+    const char *files[] = {"resources/objects/rooms/model.obj",
+                           "resources/objects/skulptura/Colossal_Bust_Rameses_II.obj",
+                           "resources/objects/grave/churchyard_grave_20k_edit.obj",
+                           "resources/objects/pecurka/mushroom-2.obj"};
+    const int VIEWS = 64;
+    const int ROUNDS = 4;
+    JobSystem jobs;
+    DepthRasterizer rasterizer;
+    rasterizer.resize(HIZ_WIDTH, HIZ_HEIGHT);
+    std::cout << "occlusion raster benchmark: " << HIZ_WIDTH << "x" << HIZ_HEIGHT << ", "
+              << DepthRasterizer::instructionSet() << ", " << jobs.threadCount() << " threads" << std::endl;
+    for (const char *file: files) {
+        OccluderMesh full = OccluderMesh::fromFile(file, glm::mat4(1.0f));
+        if (full.triangleCount() == 0)
+            continue;
+        OccluderMesh simplified = full;
+        simplified.simplify(OCCLUDER_TRIANGLES);
+        glm::vec3 center = (full.bounds.min + full.bounds.max) * 0.5f;
+        float radius = glm::length(full.bounds.max - full.bounds.min) * 0.5f;
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float) HIZ_WIDTH / HIZ_HEIGHT,
+                                                radius * 0.05f, radius * 10.0f);
+        const OccluderMesh *meshes[] = {&full, &simplified};
+        for (const OccluderMesh *mesh: meshes) {
+            for (JobSystem *threads: {(JobSystem *) nullptr, &jobs}) {
+                unsigned int triangles = 0;
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < VIEWS * ROUNDS; i++) {
+                    float angle = glm::radians(360.0f * i / VIEWS);
+                    glm::vec3 eye = center + glm::vec3(std::cos(angle), 0.3f, std::sin(angle)) * radius * 1.5f;
+                    rasterizer.clear();
+                    rasterizer.addOccluder(*mesh, projection * glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f)));
+                    rasterizer.render(threads);
+                    triangles += rasterizer.submittedTriangles();
+                }
+                float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::cout << file << (mesh == &full ? " full " : " simplified ") << mesh->triangleCount()
+                          << " triangles, " << (threads ? jobs.threadCount() : 1) << " thread(s): "
+                          << triangles / ms << " triangles/ms, " << ms / (VIEWS * ROUNDS) << " ms/view" << std::endl;
+            }
+        }
+    }
+    return 0;
+}
+
+// VIEWS x RAYS x RAYS primarnih zraka iz prstena tacaka oko granica, na jednoj niti i na svim;
+// trace(ray) vraca da li je zrak nesto pogodio
+template<class Trace>
+void BenchmarkRays(const std::string &label, const AABB &bounds, JobSystem &jobs, const Trace &trace) {
+    const int VIEWS = 16;
+    const unsigned int RAYS = 256;
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    float tanHalfFov = std::tan(glm::radians(22.5f));
+    for (JobSystem *threads: {(JobSystem *) nullptr, &jobs}) {
+        std::atomic<unsigned int> hits(0);
+        auto start = std::chrono::steady_clock::now();
+        for (int view = 0; view < VIEWS; view++) {
+            float angle = glm::radians(360.0f * view / VIEWS);
+            glm::vec3 eye = center + glm::vec3(std::cos(angle), 0.3f, std::sin(angle)) * radius * 1.5f;
+            glm::vec3 forward = glm::normalize(center - eye);
+            glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+            glm::vec3 up = glm::cross(right, forward);
+            auto traceRow = [&](unsigned int row, unsigned int) {
+                unsigned int rowHits = 0;
+                float y = ((row + 0.5f) / RAYS * 2.0f - 1.0f) * tanHalfFov;
+                for (unsigned int column = 0; column < RAYS; column++) {
+                    float x = ((column + 0.5f) / RAYS * 2.0f - 1.0f) * tanHalfFov;
+                    rowHits += trace(Ray(eye, forward + right * x + up * y)) ? 1 : 0;
+                }
+                hits += rowHits;
+            };
+            if (threads)
+                threads->parallelFor(RAYS, traceRow);
+            else
+                for (unsigned int row = 0; row < RAYS; row++)
+                    traceRow(row, 0);
+        }
+        float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+        unsigned int rays = VIEWS * RAYS * RAYS;
+        std::cout << label << ", " << (threads ? jobs.threadCount() : 1) << " thread(s): " << rays / seconds / 1e6f
+                  << " Mrays/s, " << 100.0f * hits / rays << "% hit" << std::endl;
+    }
+}
+
+// BVH svakog modela: gradnja, ucitavanje iz kesa i milioni zraka u sekundi (najblizi pogodak i bilo koji pogodak),
+// pa isto kroz TLAS nad svim objektima glavne scene
+int RunBvhBenchmark() {
+    const char *files[] = {"resources/objects/rooms/model.obj",
+                           "resources/objects/skulptura/Colossal_Bust_Rameses_II.obj",
+                           "resources/objects/grave/churchyard_grave_20k_edit.obj",
+                           "resources/objects/pecurka/mushroom-2.obj"};
+    JobSystem jobs;
+    std::cout << "BVH benchmark: " << MeshBVH::instructionSet() << ", " << jobs.threadCount() << " threads" << std::endl;
+    mkdir(BVH_CACHE_DIRECTORY, 0755);
+    std::string cachePath = std::string(BVH_CACHE_DIRECTORY) + "/benchmark.bvh";
+    for (const char *file: files) {
+        OccluderMesh mesh = OccluderMesh::fromFile(file, glm::mat4(1.0f));
+        if (mesh.triangleCount() == 0)
+            continue;
+        MeshBVH bvh;
+        auto start = std::chrono::steady_clock::now();
+        bvh.build(mesh.positions.data(), mesh.indices.data(), mesh.indices.size());
+        float buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::uint64_t key = MeshBVH::hash(mesh.positions.data(), mesh.positions.size(), mesh.indices.data(), mesh.indices.size());
+        bvh.save(cachePath, key);
+        start = std::chrono::steady_clock::now();
+        bool loaded = bvh.load(cachePath, key);
+        float loadMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << file << ": " << mesh.triangleCount() << " triangles, " << bvh.nodeCount() << " nodes, "
+                  << bvh.bytes() / 1024 << " KiB, build " << buildMs << " ms, cache load "
+                  << (loaded ? loadMs : -1.0f) << " ms" << std::endl;
+        BenchmarkRays(std::string(file) + " closest hit", bvh.bounds(), jobs, [&bvh](const Ray &ray) {
+            RayHit hit;
+            return bvh.intersect(ray, hit);
+        });
+        BenchmarkRays(std::string(file) + " any hit", bvh.bounds(), jobs, [&bvh](const Ray &ray) {
+            return bvh.occluded(ray);
+        });
+    }
+    std::remove(cachePath.c_str());
+
+    SceneFile scene;
+    std::string error;
+    if (!scene.load("resources/scenes/main.scene", &error)) {
+        std::cout << "ERROR::SCENE " << error << std::endl;
+        return -1;
+    }
+    std::vector<MeshBVH> modelBVHs(scene.models().size());
+    for (unsigned int i = 0; i < modelBVHs.size(); i++) {
+        OccluderMesh mesh = OccluderMesh::fromFile(scene.string(scene.models()[i].path), glm::mat4(1.0f));
+        modelBVHs[i].build(mesh.positions.data(), mesh.indices.data(), mesh.indices.size());
+    }
+    SceneBVH sceneBVH;
+    AABB sceneBounds;
+    for (const SceneFile::Object &object: scene.objects()) {
+        Transform transform;
+        transform.position = object.position;
+        transform.rotation = object.rotation;
+        transform.scale = object.scale;
+        glm::mat4 matrix = ComposeTransform(transform);
+        sceneBVH.add(modelBVHs[object.model], matrix, sceneBVH.instanceCount());
+        sceneBounds.expand(modelBVHs[object.model].bounds().transformed(matrix));
+    }
+    auto start = std::chrono::steady_clock::now();
+    sceneBVH.build();
+    float buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "scene: " << sceneBVH.instanceCount() << " instances, TLAS build " << buildMs << " ms" << std::endl;
+    BenchmarkRays("scene closest hit", sceneBounds, jobs, [&sceneBVH](const Ray &ray) {
+        RayHit hit;
+        return sceneBVH.intersect(ray, hit);
+    });
+    BenchmarkRays("scene any hit", sceneBounds, jobs, [&sceneBVH](const Ray &ray) {
+        return sceneBVH.occluded(ray);
+    });
+    return 0;
+}
+
+// --path-trace: scena na CPU, bez prozora i GL-a, sa kamerom i svetlima iz sacuvanog stanja i objektima na pocetnim
+// polozajima (kao --capture); lampe su samo izvori svetla, providni objekti se ne prate
+int RunPathTracer(const SceneFile &sceneFile, const std::string &statePath, const PathTracer::Settings &settings,
+                  const std::string &outPath) {
+    ProgramState state;
+    ApplySceneSettings(state, sceneFile);
+    state.LoadFromFile(statePath);
+    JobSystem jobs;
+    auto loadStart = std::chrono::steady_clock::now();
+    std::vector<Model> models(sceneFile.models().size());
+    jobs.parallelFor(models.size(), [&](unsigned int index, unsigned int) {
+        AllocationScope scope(MEMORY_MESHES);
+        models[index].Import(sceneFile.string(sceneFile.models()[index].path));
+    });
+    std::vector<std::vector<MeshBVH>> meshBVHs = BuildMeshBVHs(models, jobs);
+
+    // teksture modela redom, id teksture mreze je indeks u slike svog modela
+    PathTracer tracer;
+    std::vector<unsigned int> firstTexture(models.size());
+    unsigned int textureCount = 0;
+    for (unsigned int m = 0; m < models.size(); m++) {
+        firstTexture[m] = textureCount;
+        for (const TextureImage &image: models[m].PendingImages()) {
+            PathTracer::Texture texture;
+            texture.data = image.data;
+            texture.width = image.width;
+            texture.height = image.height;
+            texture.components = image.components;
+            textureCount = tracer.addTexture(texture) + 1;
+        }
+    }
+    unsigned char *skyboxImages[6] = {};
+    if (sceneFile.hasSkybox()) {
+        PathTracer::Texture faces[6];
+        for (unsigned int i = 0; i < 6; i++) {
+            std::string path = FileSystem::getPath(sceneFile.string(sceneFile.settings().skybox[i]));
+            skyboxImages[i] = stbi_load(path.c_str(), &faces[i].width, &faces[i].height, &faces[i].components, 0);
+            if (skyboxImages[i] == nullptr)
+                std::cout << "Cubemap texture failed to load at path: " << path << std::endl;
+            faces[i].data = skyboxImages[i];
+        }
+        tracer.setSkybox(faces);
+    }
+
+    // svetla kao u glavnom prolazu: usmereno, prve dve lampe i baterijska lampa iz kamere
+    PathTracer::Lights lights;
+    lights.dir.direction = state.dirLightDir;
+    lights.dir.ambient = glm::vec3(state.dirLightAmbDiffSpec.x);
+    lights.dir.diffuse = glm::vec3(state.dirLightAmbDiffSpec.y);
+    lights.dir.specular = glm::vec3(state.dirLightAmbDiffSpec.z);
+    lights.spotEnabled = spotlightOn;
+    lights.spot.position = state.camera.Position;
+    lights.spot.direction = state.camera.Front;
+    lights.spot.ambient = glm::vec3(0.0f);
+    lights.spot.diffuse = glm::vec3(1.0f);
+    lights.spot.specular = glm::vec3(1.0f);
+    lights.spot.constant = 1.0f;
+    lights.spot.linear = 0.09f;
+    lights.spot.quadratic = 0.032f;
+    lights.spot.cutOff = glm::cos(glm::radians(12.5f));
+    lights.spot.outerCutOff = glm::cos(glm::radians(15.0f));
+
+    SceneGraph sceneGraph;
+    std::vector<std::pair<unsigned int, std::vector<unsigned int>>> tracedObjects;
+    for (const SceneFile::Object &description: sceneFile.objects()) {
+        Transform transform;
+        transform.position = description.position;
+        transform.rotation = description.rotation;
+        transform.scale = description.scale;
+        if (description.flags & SceneFile::OBJECT_LAMP) {
+            if (lights.points.size() < 2) {
+                PathTracer::PointLight light;
+                light.position = description.position;
+                light.ambient = state.pointLight.ambient;
+                light.diffuse = state.pointLight.diffuse;
+                light.specular = state.pointLight.specular;
+                light.constant = state.pointLight.constant;
+                light.linear = state.pointLight.linear;
+                light.quadratic = state.pointLight.quadratic;
+                lights.points.push_back(light);
+            }
+            continue;
+        }
+        // prate se samo neprovidne povrsine
+        if (description.flags & SceneFile::OBJECT_TRANSPARENT)
+            continue;
+        tracedObjects.emplace_back(description.model, std::vector<unsigned int>());
+        sceneGraph.addModel(sceneFile.string(description.name), models[description.model], ComposeTransform(transform),
+                            SceneGraph::NONE, tracedObjects.back().second);
+    }
+    sceneGraph.update();
+    for (const auto &object: tracedObjects) {
+        const Model &model = models[object.first];
+        for (unsigned int i = 0; i < model.meshes.size(); i++) {
+            // prva difuzna i spekularna tekstura, kao material.texture_diffuse1 i texture_specular1
+            int diffuse = -1, specular = -1;
+            for (const Texture &texture: model.meshes[i].textures) {
+                if (texture.type == "texture_diffuse" && diffuse < 0)
+                    diffuse = firstTexture[object.first] + texture.id;
+                else if (texture.type == "texture_specular" && specular < 0)
+                    specular = firstTexture[object.first] + texture.id;
+            }
+            tracer.addInstance(meshBVHs[object.first][i], model.meshes[i], sceneGraph.world(object.second[i]), diffuse, specular);
+        }
+    }
+    tracer.build();
+    float loadSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - loadStart).count();
+
+    PathTracer::Settings traceSettings = settings;
+    traceSettings.background = state.clearColor;
+    glm::mat4 projection = glm::perspective(glm::radians(state.camera.Zoom),
+                                            (float) settings.width / (float) settings.height, 0.1f, 100.0f);
+    glm::mat4 inverseViewProjection = glm::inverse(projection * state.camera.GetViewMatrix());
+    std::vector<glm::vec3> hdr;
+    auto renderStart = std::chrono::steady_clock::now();
+    tracer.render(jobs, inverseViewProjection, lights, traceSettings, hdr);
+    float renderSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - renderStart).count();
+    Image image;
+    PathTracer::toneMap(hdr, settings.width, settings.height, bloom, exposure, image);
+    bool saved = image.savePpm(outPath);
+    std::cout << "Path tracer: " << settings.width << "x" << settings.height << ", " << settings.samples
+              << " samples, " << settings.bounces << " bounces, " << jobs.threadCount() << " threads, load "
+              << loadSeconds << " s, render " << renderSeconds << " s, " << tracer.rayCount() / renderSeconds / 1e6f
+              << " Mrays/s" << std::endl;
+    if (!saved)
+        std::cout << "ERROR::PATH_TRACER cannot write " << outPath << std::endl;
+
+    for (Model &model: models)
+        model.FreePendingImages();
+    for (unsigned char *face: skyboxImages)
+        stbi_image_free(face);
+    return saved ? 0 : -1;
+}
+
+// --image-diff: RMSE, PSNR i pikseli koji se razlikuju izmedju dve PPM slike; slika razlike je opciona
+int DiffImages(const char *firstPath, const char *secondPath, const char *diffPath) {
+    Image first, second;
+    if (!first.loadPpm(firstPath) || !second.loadPpm(secondPath)) {
+        std::cout << "ERROR::IMAGE cannot read " << firstPath << " or " << secondPath << std::endl;
+        return -1;
+    }
+    Image::Difference difference;
+    Image diff;
+    if (!Image::compare(first, second, difference, diffPath ? &diff : nullptr)) {
+        std::cout << "ERROR::IMAGE sizes differ: " << first.width << "x" << first.height << " and "
+                  << second.width << "x" << second.height << std::endl;
+        return -1;
+    }
+    std::cout << "RMSE " << difference.rmse << ", PSNR " << difference.psnr << " dB, max error " << difference.maxError
+              << ", " << difference.differingPixels << " of " << first.width * first.height << " pixels differ"
+              << std::endl;
+    if (diffPath && !diff.savePpm(diffPath))
+        std::cout << "ERROR::IMAGE cannot write " << diffPath << std::endl;
+    return 0;
+}
+
+// back buffer ovog frejma (pre glfwSwapBuffers) u PPM; GL cita redove odozdo, slika ih ima odozgo
+bool CaptureBackbuffer(const std::string &path, int width, int height) {
+    Image image;
+    image.resize(width, height);
+    std::vector<unsigned char> rows(image.pixels.size());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    std::size_t rowBytes = (std::size_t) width * 3;
+    for (int y = 0; y < height; y++)
+        memcpy(image.pixel(0, y), &rows[(std::size_t) (height - 1 - y) * rowBytes], rowBytes);
+    if (!image.savePpm(path)) {
+        std::cout << "ERROR::CAPTURE cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 100k entiteta sa Transform i Animated: sistem animacije na jednoj niti i na svim, u ms po frejmu
+int RunEntityBenchmark() {
+    const unsigned int ENTITIES = 100000;
+    const int FRAMES = 100;
+    EntityWorld entities;
+    for (unsigned int i = 0; i < ENTITIES; i++) {
+        float t = (float) i / ENTITIES;
+        Transform transform;
+        transform.scale = glm::vec3(0.1f + t);
+        Animated animated;
+        animated.basePosition = glm::vec3(std::cos(t * 628.0f), t, std::sin(t * 628.0f)) * 50.0f;
+        animated.bobAmplitude = glm::vec3(0.0f, 0.5f + t, 0.0f);
+        animated.bobSpeed = 1.0f + t;
+        animated.spin = glm::vec3(30.0f, 60.0f * t, 90.0f);
+        entities.create(transform, animated);
+    }
+    JobSystem serial(0);
+    JobSystem parallel;
+    JobSystem *systems[] = {&serial, &parallel};
+    for (JobSystem *jobs: systems) {
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < FRAMES; frame++)
+            AnimateEntities(entities, *jobs, frame / 60.0f);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << ENTITIES << " animated entities, " << jobs->threadCount() << " thread(s): "
+                  << ms / FRAMES << " ms/frame" << std::endl;
+    }
+    return 0;
+}
+
+// tekstualna scena u binarni oblik; ucitava se istim load() i preskace parsiranje
+int CompileScene(const char *textPath, const char *binaryPath) {
+    SceneFile scene;
+    std::string error;
+    if (!scene.load(textPath, &error) || !scene.save(binaryPath, &error)) {
+        std::cout << "ERROR::SCENE " << error << std::endl;
+        return -1;
+    }
+    std::cout << textPath << " -> " << binaryPath << ": " << scene.models().size() << " models, "
+              << scene.objects().size() << " objects" << std::endl;
+    return 0;
+}
+
+// 50k kocki sa frustum culling-om, sortiranjem po VAO i pakovanjem model matrice, svakog frejma:
+// direktno na jednoj niti (uniform po imenu) i zapisano paralelno u command buffere pa izvrseno na GL niti
+int RunCommandBenchmark() {
+    const unsigned int ITEMS = 50000;
+    const unsigned int ITEMS_PER_BUFFER = 1024;
+    const unsigned int MESHES = 4;
+    const int FRAMES = 20;
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    GLFWwindow *window = glfwCreateWindow(256, 256, "command benchmark", NULL, NULL);
+    if (window == NULL || (glfwMakeContextCurrent(window), !gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))) {
+        std::cout << "command benchmark needs an OpenGL 3.3 context" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    Shader shader("resources/shaders/depth.vs", "resources/shaders/depth.fs");
+
+    // kocke nekoliko velicina, svaka u svom VAO
+    const float cube[] = {-1, -1, -1, 1, -1, -1, -1, 1, -1, 1, 1, -1, -1, -1, 1, 1, -1, 1, -1, 1, 1, 1, 1, 1};
+    const unsigned int cubeIndices[] = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                        2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    unsigned int vertexArrays[MESHES], buffers[2 * MESHES];
+    glGenVertexArrays(MESHES, vertexArrays);
+    glGenBuffers(2 * MESHES, buffers);
+    for (unsigned int i = 0; i < MESHES; i++) {
+        float vertices[24];
+        for (int k = 0; k < 24; k++)
+            vertices[k] = cube[k] * (0.5f + 0.25f * i);
+        glBindVertexArray(vertexArrays[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[2 * i]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[2 * i + 1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *) 0);
+    }
+    glBindVertexArray(0);
+
+    struct Item {
+        glm::vec3 position;
+        float scale;
+        unsigned int mesh;
+        AABB bounds;
+    };
+    std::vector<Item> items(ITEMS);
+    unsigned int seed = 12345;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    for (Item &item: items) {
+        item.position = glm::vec3(random() - 0.5f, random() - 0.5f, random() - 0.5f) * 200.0f;
+        item.scale = 0.2f + random();
+        item.mesh = (unsigned int) (random() * MESHES) % MESHES;
+        float extent = item.scale * (0.5f + 0.25f * item.mesh);
+        item.bounds.min = item.position - glm::vec3(extent);
+        item.bounds.max = item.position + glm::vec3(extent);
+    }
+    auto itemMatrix = [](const Item &item) {
+        glm::mat4 model(item.scale);
+        model[3] = glm::vec4(item.position, 1.0f);
+        return model;
+    };
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 300.0f);
+
+    JobSystem jobs;
+    CommandQueue queue;
+    unsigned int bufferCount = (ITEMS + ITEMS_PER_BUFFER - 1) / ITEMS_PER_BUFFER;
+    std::vector<std::vector<unsigned int>> visibleLists(bufferCount);
+    std::vector<unsigned int> visible;
+    float directMs = 0.0f, recordMs = 0.0f, executeMs = 0.0f;
+    unsigned int directDraws = 0, recordedDraws = 0;
+    shader.use();
+    shader.setMat4("projection", projection);
+    for (int frame = 0; frame < FRAMES; frame++) {
+        float angle = glm::radians(360.0f * frame / FRAMES);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(std::cos(angle), 0.0f, std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+        shader.setMat4("view", view);
+        Frustum frustum(projection * view);
+        auto byMesh = [&items](unsigned int a, unsigned int b) { return items[a].mesh < items[b].mesh; };
+
+        // sve na GL niti, kao DrawSceneObject
+        auto start = std::chrono::steady_clock::now();
+        visible.clear();
+        for (unsigned int i = 0; i < ITEMS; i++) {
+            if (frustum.intersects(items[i].bounds))
+                visible.push_back(i);
+        }
+        std::sort(visible.begin(), visible.end(), byMesh);
+        unsigned int bound = ~0u;
+        for (unsigned int i: visible) {
+            shader.setMat4("model", itemMatrix(items[i]));
+            if (items[i].mesh != bound) {
+                bound = items[i].mesh;
+                glBindVertexArray(vertexArrays[bound]);
+            }
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        }
+        glBindVertexArray(0);
+        directDraws += visible.size();
+        directMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        glFinish();
+
+        // culling, sortiranje i pakovanje paralelno po komadima, GL samo izvrsava
+        start = std::chrono::steady_clock::now();
+        int modelLocation = glGetUniformLocation(shader.ID, "model");
+        queue.reset();
+        queue.record(jobs, bufferCount, [&](CommandBuffer &commands, unsigned int index) {
+            std::vector<unsigned int> &list = visibleLists[index];
+            list.clear();
+            unsigned int end = std::min(ITEMS, (index + 1) * ITEMS_PER_BUFFER);
+            for (unsigned int i = index * ITEMS_PER_BUFFER; i < end; i++) {
+                if (frustum.intersects(items[i].bounds))
+                    list.push_back(i);
+            }
+            std::sort(list.begin(), list.end(), byMesh);
+            for (unsigned int i: list) {
+                commands.uniform(modelLocation, itemMatrix(items[i]));
+                commands.bindVertexArray(vertexArrays[items[i].mesh]);
+                commands.drawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT);
+            }
+        });
+        auto recorded = std::chrono::steady_clock::now();
+        queue.execute();
+        auto executed = std::chrono::steady_clock::now();
+        recordedDraws += queue.drawCount();
+        recordMs += std::chrono::duration<float, std::milli>(recorded - start).count();
+        executeMs += std::chrono::duration<float, std::milli>(executed - recorded).count();
+        glFinish();
+    }
+    std::cout << ITEMS << " items, " << directDraws / FRAMES << " visible draws per frame" << std::endl;
+    std::cout << "direct, 1 thread: " << directMs / FRAMES << " ms/frame" << std::endl;
+    std::cout << "command buffers, " << jobs.threadCount() << " thread(s): record " << recordMs / FRAMES
+              << " ms + execute " << executeMs / FRAMES << " ms/frame, " << queue.commandCount() << " commands, "
+              << queue.bytesUsed() / 1024 << " KB" << std::endl;
+    if (recordedDraws != directDraws)
+        std::cout << "ERROR: command buffers recorded " << recordedDraws << " draws, direct path " << directDraws << std::endl;
+
+    glDeleteVertexArrays(MESHES, vertexArrays);
+    glDeleteBuffers(2 * MESHES, buffers);
+    glDeleteProgram(shader.ID);
+    glfwTerminate();
+    return recordedDraws == directDraws ? 0 : 1;
+}
+
 void renderQuad()
 {
     if (quadVAO == 0)
@@ -584,26 +2424,43 @@ void renderQuad()
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+        MemoryTracker::track(MemoryTracker::VERTEX_ARRAY, quadVAO, 0, MEMORY_GENERAL, "fullscreen quad");
+        MemoryTracker::track(MemoryTracker::BUFFER, quadVBO, sizeof(quadVertices), MEMORY_GENERAL, "fullscreen quad");
     }
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     glBindVertexArray(0);
 }
 
+void destroyQuad()
+{
+    if (quadVAO == 0)
+        return;
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+    MemoryTracker::untrack(MemoryTracker::VERTEX_ARRAY, quadVAO);
+    MemoryTracker::untrack(MemoryTracker::BUFFER, quadVBO);
+    quadVAO = 0;
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window) {
+// kretanje i ekspozicija se ne menjaju ovde nego u koracima simulacije, nezavisno od broja frejmova
+SimulationInput processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(RIGHT, deltaTime);
+    SimulationInput input;
+    input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.backward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    input.exposureDown = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+    input.exposureUp = !input.exposureDown && glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+    input.cameraFront = programState->camera.Front;
+    input.cameraRight = programState->camera.Right;
+    input.cameraSpeed = programState->camera.MovementSpeed;
+    return input;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -612,6 +2469,9 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    // render targets follow on the next frame (skipped while minimized)
+    windowWidth = width;
+    windowHeight = height;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -633,6 +2493,21 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
         programState->camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
+// levi klik bira objekt ispod kursora; samo kad je kursor slobodan (ImGui ukljucen) i nije iznad ImGui prozora
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS || !programState->ImGuiEnabled
+        || ImGui::GetIO().WantCaptureMouse)
+        return;
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0)
+        return;
+    programState->pickRequested = true;
+    programState->pickPosition = glm::vec2((float) (x / width), (float) (y / height));
+}
+
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
@@ -654,6 +2529,137 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.005, 0.0001, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.005, 0.0001, 1.0);
 
+        ImGui::Text("Resolution:");
+        DynamicResolution& dr = programState->dynamicResolution;
+        ImGui::Checkbox("Dynamic resolution", &dr.enabled);
+        ImGui::DragFloat("Frame budget (ms)", &dr.budgetMs, 0.1, 4.0, 50.0);
+        ImGui::DragFloat("Min render scale", &dr.minScale, 0.01, 0.25, 1.0);
+        if (!dr.enabled)
+            ImGui::SliderFloat("Render scale", &dr.maxScale, dr.minScale, 1.0);
+        ImGui::Text("GPU frame: %.2f ms, render scale: %.2f", programState->gpuFrameMs, programState->renderScale);
+        ImGui::Text("Render graph: %u passes (%u culled), %u textures", programState->graphPasses,
+                    programState->graphCulledPasses, programState->graphTextures);
+        ImGui::Text("Opaque pass:");
+        ImGui::Checkbox("Deferred shading", &programState->deferred);
+        ImGui::Checkbox("Depth pre-pass", &programState->depthPrepass);
+        // overdraw prikaz broji sejdovanje forward osvetljenja
+        if (programState->deferred)
+            programState->overdrawView = false;
+        else
+            ImGui::Checkbox("Overdraw view", &programState->overdrawView);
+        if (programState->overdrawView)
+            ImGui::Text("Shaded fragments per pixel: %.2f", programState->overdraw);
+        ImGui::Checkbox("Occlusion culling (Hi-Z)", &programState->occlusionCulling);
+        if (programState->occlusionCulling) {
+            ImGui::Checkbox("CPU occluder raster", &programState->occlusionCpuRaster);
+            if (programState->occlusionCpuRaster)
+                ImGui::Text("Occluders: %u triangles, %.3f ms (%s)", programState->occluderTriangles,
+                            programState->occluderRasterMs, DepthRasterizer::instructionSet());
+            ImGui::Text("Meshes culled: %u / %u", programState->culledMeshes, programState->testedMeshes);
+        }
+        ImGui::Checkbox("Directional shadows", &programState->shadows);
+        if (programState->shadows) {
+            int resolutionIndex = 0;
+            while (resolutionIndex < 3 && (512 << resolutionIndex) < programState->shadowResolution)
+                resolutionIndex++;
+            if (ImGui::Combo("Shadow map size", &resolutionIndex, "512\0" "1024\0" "2048\0" "4096\0"))
+                programState->shadowResolution = 512 << resolutionIndex;
+            ImGui::SliderInt("Cascades", &programState->shadowCascades, 1, CascadedShadowMap::MAX_CASCADES);
+            ImGui::DragFloat("Shadow distance", &programState->shadowDistance, 0.5, 5.0, 100.0);
+            ImGui::DragFloat("Split lambda", &programState->shadowSplitLambda, 0.01, 0.0, 1.0);
+            ImGui::Text("Shadow casters drawn: %u (all cascades)", programState->shadowCasters);
+        }
+        ImGui::Checkbox("SSAO", &programState->ssao);
+        if (programState->ssao) {
+            ImGui::DragFloat("AO radius", &programState->ssaoRadius, 0.01, 0.05, 2.0);
+            ImGui::DragFloat("AO bias", &programState->ssaoBias, 0.001, 0.0, 0.2);
+            ImGui::DragFloat("AO intensity", &programState->ssaoIntensity, 0.05, 0.5, 4.0);
+            ImGui::SliderInt("AO max samples", &programState->ssaoMaxSamples, AmbientOcclusion::MIN_SAMPLES, AmbientOcclusion::MAX_SAMPLES);
+            ImGui::Checkbox("AO temporal accumulation", &programState->ssaoTemporal);
+            if (programState->ssaoTemporal) {
+                ImGui::DragFloat("AO budget (ms)", &programState->ssaoBudgetMs, 0.05, 0.1, 5.0);
+                ImGui::Text("AO: %d samples, %.3f ms (half resolution)", programState->ssaoSamples, programState->ssaoMs);
+            }
+            if (!programState->deferred && !programState->depthPrepass)
+                ImGui::Text("SSAO keeps the depth pre-pass on");
+        }
+        ImGui::Checkbox("Point light shadows", &programState->pointShadows);
+        if (programState->pointShadows) {
+            int atlasIndex = 0;
+            while (atlasIndex < 2 && (1024 << atlasIndex) < programState->pointShadowAtlasSize)
+                atlasIndex++;
+            if (ImGui::Combo("Atlas size", &atlasIndex, "1024\0" "2048\0" "4096\0"))
+                programState->pointShadowAtlasSize = 1024 << atlasIndex;
+            int faceIndex = 0;
+            while (faceIndex < 3 && (128 << faceIndex) < programState->pointShadowResolution)
+                faceIndex++;
+            if (ImGui::Combo("Face size", &faceIndex, "128\0" "256\0" "512\0" "1024\0"))
+                programState->pointShadowResolution = 128 << faceIndex;
+            ImGui::SliderInt("Faces per frame", &programState->pointShadowBudget, PointShadowMaps::FACES, 8 * PointShadowMaps::FACES);
+            ImGui::DragFloat("Move tolerance", &programState->pointShadowTolerance, 0.005, 0.0, 1.0);
+            const PointShadowMaps::Stats &stats = programState->pointShadowStats;
+            ImGui::Text("Faces: %u static, %u dynamic, %u cached; %u casters drawn", stats.staticFaces,
+                        stats.dynamicFaces, stats.cachedFaces, programState->pointShadowCasters);
+            ImGui::Text("Lights waiting: %u, without tile: %u, atlas %.0f%% used", stats.staleLights,
+                        stats.lightsWithoutTile, programState->pointShadowAtlasUsage * 100.0f);
+        }
+        ImGui::Text("Scene graph: %u nodes, %u updated", programState->sceneNodes, programState->sceneNodesUpdated);
+        ImGui::Text("Entities: %u in %u archetypes, simulation %.3f ms", programState->entityCount,
+                    programState->archetypeCount, programState->entityUpdateMs);
+        ImGui::Text("Shaders reloaded: %u", programState->shaderReloads);
+        if (programState->pickedName)
+            ImGui::Text("Picked: %s, mesh %u, triangle %u, %.2f away (%.3f ms)", programState->pickedName,
+                        programState->pickedMesh, programState->pickedTriangle, programState->pickedDistance,
+                        programState->pickMs);
+        else
+            ImGui::Text("Picked: nothing (left click with the cursor free)");
+        ImGui::Text("Heap allocations last frame: %u (%u bytes), frames that allocated: %u",
+                    programState->frameAllocations, programState->frameAllocatedBytes, programState->allocatingFrames);
+        ImGui::Text("Frame arena: %u bytes", programState->frameArenaBytes);
+        if (!programState->shaderError.empty())
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Last reload failed, old shader kept:\n%s",
+                               programState->shaderError.c_str());
+
+        ImGui::End();
+    }
+    profiler->drawOverlay();
+    {
+        // geometrija modela: sta je ostalo u RAM-u prema residency i koliko je to manje od cele kopije
+        const double MiB = 1024.0 * 1024.0;
+        static const char *residencyNames[] = {"keep", "positions", "discard"};
+        ImGui::Begin("Memory");
+        ImGui::Text("Loading heap peak: %.1f MiB, heap now: %.1f MiB", programState->loadPeakBytes / MiB,
+                    AllocationCounter::liveBytes() / MiB);
+        ImGui::Separator();
+        size_t cpuTotal = 0, fullTotal = 0, gpuTotal = 0;
+        for (const ModelMemory &memory: programState->modelMemory) {
+            size_t cpu = memory.model->CpuBytes();
+            size_t full = std::max(memory.model->FullCpuBytes(), cpu);
+            size_t gpu = memory.model->GpuBytes();
+            MeshResidency residency = memory.model->meshes.empty() ? MESH_KEEP : memory.model->meshes[0].residency;
+            ImGui::Text("%-10s %-9s RAM %7.2f MiB (saved %7.2f)  GPU %7.2f MiB", memory.name,
+                        residencyNames[residency], cpu / MiB, (full - cpu) / MiB, gpu / MiB);
+            cpuTotal += cpu;
+            fullTotal += full;
+            gpuTotal += gpu;
+        }
+        ImGui::Separator();
+        ImGui::Text("Mesh data in RAM: %.2f of %.2f MiB, saved %.2f MiB; on GPU: %.2f MiB", cpuTotal / MiB,
+                    fullTotal / MiB, (fullTotal - cpuTotal) / MiB, gpuTotal / MiB);
+        // po podsistemima: CPU su zive alokacije (operator new), GPU procena iz prijavljenih GL objekata
+        ImGui::Separator();
+        MemoryTracker::Totals gpu = MemoryTracker::totals();
+        for (unsigned int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++)
+            ImGui::Text("%-14s CPU %8.2f MiB  GPU %8.2f MiB (%u objects)", MemorySubsystemName(i),
+                        AllocationCounter::liveBytes(i) / MiB, gpu.bytes[i] / MiB, gpu.objects[i]);
+        ImGui::Text("%-14s CPU %8.2f MiB  GPU %8.2f MiB (%u objects)", "total", AllocationCounter::liveBytes() / MiB,
+                    gpu.totalBytes / MiB, gpu.totalObjects);
+        if (ImGui::Button("Write JSON")) {
+            std::ofstream memoryJson(programState->memoryJsonPath);
+            MemoryTracker::writeJson(memoryJson);
+        }
+        ImGui::SameLine();
+        ImGui::Text("%s", programState->memoryJsonPath.c_str());
         ImGui::End();
     }
     {
@@ -663,6 +2669,9 @@ void DrawImGui(ProgramState *programState) {
         ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
         ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
         ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
+        ImGui::Checkbox("Autosave state", &programState->autosave);
+        if (programState->autosave)
+            ImGui::DragFloat("Autosave interval (s)", &programState->autosaveInterval, 0.5, 1.0, 600.0);
         ImGui::End();
     }
 
@@ -697,20 +2706,11 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     {
         bloomKeyPressed = false;
     }
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-    {
-        if (exposure > 0.0f)
-            exposure -= 0.1f;
-        else
-            exposure = 0.0f;
-    }
-    else if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-    {
-        exposure += 0.1f;
-    }
 }
 unsigned int loadCubemap(vector<std::string> faces)
 {
+    AllocationScope scope(MEMORY_SKYBOX);
+    size_t bytes = 0;
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
@@ -722,6 +2722,7 @@ unsigned int loadCubemap(vector<std::string> faces)
         if (data)
         {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            bytes += MemoryTracker::textureBytes(GL_RGB, width, height);
             stbi_image_free(data);
         }
         else
@@ -735,6 +2736,7 @@ unsigned int loadCubemap(vector<std::string> faces)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    MemoryTracker::track(MemoryTracker::TEXTURE, textureID, bytes, MEMORY_SKYBOX, "skybox cubemap");
 
     return textureID;
 }